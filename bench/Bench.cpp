@@ -0,0 +1,68 @@
+#include "Bench.h"
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+static volatile uint16_t overflows = 0;
+
+ISR(TIMER1_OVF_vect)
+{
+  overflows++;
+}
+
+void bench_begin()
+{
+  Serial.begin(115200);
+  while (!Serial);
+  Serial.print(F("#BENCH ESTUFA on "));
+  Serial.print(BOARD_TYPE);
+  Serial.print(F(", F_CPU = "));
+  Serial.println(F_CPU);
+
+  // Timer1: normal mode, clk/1
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  TIFR1 = _BV(TOV1);
+  TIMSK1 = _BV(TOIE1);
+  TCCR1B = _BV(CS10);
+}
+
+uint32_t bench_cycles()
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t lo = TCNT1;
+  uint16_t hi = overflows;
+  // Overflow pending but not serviced yet
+  if ((TIFR1 & _BV(TOV1)) && lo < 0x8000)
+    hi++;
+  SREG = sreg;
+  return ((uint32_t)hi << 16) | lo;
+}
+
+void bench_report(const char *name, uint32_t cycles, uint32_t ops, uint32_t bytes_per_op)
+{
+  uint32_t per_op = (cycles + ops / 2) / ops;
+  Serial.print(F("BENCH "));
+  Serial.print(name);
+  Serial.print(F(" cycles="));
+  Serial.print(per_op);
+  Serial.print(F(" us="));
+  Serial.print(per_op / (F_CPU / 1000000.0), 3);
+  if (bytes_per_op) {
+    Serial.print(F(" bytes_per_s="));
+    Serial.print((double)bytes_per_op * ops * F_CPU / cycles, 0);
+  }
+  Serial.println();
+}
+
+void bench_done()
+{
+  Serial.println(F("#BENCH done"));
+  Serial.flush();
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
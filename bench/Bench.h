@@ -0,0 +1,33 @@
+/**
+ * @brief Bench - on-target micro-benchmark harness
+ *
+ *
+ * @notes:
+ * - Cycle counts come from Timer1 running at F_CPU (no prescaler) with
+ * its overflow interrupt extending the count to 32 bits.
+ *
+ * - Results are printed one per line so host scripts can collect them:
+ *   BENCH <name> cycles=<per op> us=<per op> bytes_per_s=<rate>
+ *
+ * - On real hardware read them with the serial monitor; under simavr
+ * (pio run -e uno_bench -t simbench) bench_done() makes simavr exit.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+void bench_begin();
+uint32_t bench_cycles();
+void bench_report(const char *name, uint32_t cycles, uint32_t ops, uint32_t bytes_per_op);
+void bench_done();
+
+// Time `ops` calls of `fn`, returns total cycles
+template <class Fn>
+uint32_t bench_run(uint32_t ops, Fn fn)
+{
+  uint32_t start = bench_cycles();
+  for (uint32_t i = 0; i < ops; i++)
+    fn();
+  return bench_cycles() - start;
+}
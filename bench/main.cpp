@@ -0,0 +1,270 @@
+/**
+ * @brief ESTUFA on-target benchmark suite
+ *
+ *
+ * @notes:
+ * - pio run -e uno_bench -t upload && pio device monitor   (hardware)
+ * - pio run -e uno_bench -t simbench                      (simavr)
+ *
+ */
+#include <Arduino.h>
+
+#include "Bench.h"
+
+#include <RelayDriver.h>
+
+#include <CoreBench.h>
+#include <EstufaCore.h>
+#include <HalAvr.h>
+#include <LinkFrame.h>
+
+#include <IsrSafe.h>
+#include <TxQueues.h>
+#include <WheelBench.h>
+
+#define RELAY_DATA 7
+#define RELAY_CLK 8
+
+
+/**
+ * @brief Relay transfer, one 1-module frame per op, per timing profile
+ *
+ */
+template <class Profile>
+void bench_relay_profile(const char *name)
+{
+  typedef RelayBus<Profile, RELAY_DATA, RELAY_CLK> Bus;
+  Bus::begin();
+  static uint8_t frame[1] = {0x5A};
+  uint32_t cycles = bench_run(32, [] { Bus::write_frame(frame, 1); });
+  bench_report(name, cycles, 32, sizeof(frame));
+}
+
+// Reference: the digitalWrite/delayMicroseconds loop Trigger_relay used to run
+void legacy_frame(uint8_t value)
+{
+  byte mask_reset = 0x80;
+  for (int i = 1; i <= 8; i++) {
+    digitalWrite(RELAY_DATA, (value & mask_reset) ? HIGH : LOW);
+    delayMicroseconds(SERIAL_RELAY_DELAY_DATA);
+    digitalWrite(RELAY_CLK, HIGH);
+    if (i == 8)
+      delayMicroseconds(SERIAL_RELAY_DELAY_LATCH);
+    else
+      delayMicroseconds(SERIAL_RELAY_DELAY_CLOCK_HIGH);
+    digitalWrite(RELAY_CLK, LOW);
+    delayMicroseconds(SERIAL_RELAY_DELAY_CLOCK_LOW);
+    mask_reset >>= 1;
+  }
+  digitalWrite(RELAY_DATA, LOW);
+}
+
+void bench_relay()
+{
+  pinMode(RELAY_DATA, OUTPUT);
+  pinMode(RELAY_CLK, OUTPUT);
+  uint32_t cycles = bench_run(32, [] { legacy_frame(0x5A); });
+  bench_report("relay_frame_legacy", cycles, 32, 1);
+  bench_relay_profile<RelayTimingConservative>("relay_frame_conservative");
+  bench_relay_profile<RelayTimingFast>("relay_frame_fast");
+}
+
+/**
+ * @brief Full-chain refresh time versus chain length
+ *
+ * One op = one whole frame of `len` modules, latch included, through any
+ * relay driver (RelayDriver.h).
+ */
+template <class Driver>
+void bench_relay_chain(const char *driver)
+{
+  static RelayDriverFrame<Driver, 128> chain;
+  static uint16_t len;
+  static const uint16_t lengths[] = {1, 8, 16, 32, 64, 128};
+  char name[40];
+
+  Driver::begin();
+  for (uint16_t c = 0; c < chain.channels; c += 3)
+    chain.set_channel(c, true);
+  for (uint8_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    len = lengths[i];
+    // the last `len` bytes are modules 1..len
+    uint32_t cycles = bench_run(4, [] { Driver::write_frame(chain.bytes() + chain.size() - len, len); });
+    snprintf(name, sizeof(name), "relay_chain_%s_%u", driver, len);
+    bench_report(name, cycles, 4, len);
+  }
+}
+
+// The longest interrupts-masked window does not grow with the chain
+template <class Profile>
+void report_irq_off(const char *profile)
+{
+  Serial.print(F("#BENCH relay_chain_"));
+  Serial.print(profile);
+  Serial.print(F(" irq_off_cycles="));
+  Serial.println(RelayCycles<Profile>::clock_high + 4);
+}
+
+
+/**
+ * @brief Portable core cases (lib/EstufaCore/CoreBench.h), as on the
+ * native and STM32 ports
+ *
+ */
+void bench_core()
+{
+  typedef RelayBus<RelayTimingFast, RELAY_DATA, RELAY_CLK> Bus;
+  typedef HalAvr<Bus> Hal;
+  core_bench<EstufaCore<Hal, 1>, Hal>([](const char *name, uint32_t ops, uint32_t us) {
+    // micros() -> cycles
+    bench_report(name, us * (F_CPU / 1000000UL), ops, 0);
+  });
+}
+
+/**
+ * @brief lib/IsrSafe primitives, one operation per op
+ *
+ * Run from loop context with interrupts on, as the sketch uses them;
+ * the ring is filled then drained so push and pop never hit full/empty.
+ */
+void bench_isr_safe()
+{
+  static SpscRing<uint8_t, 128> ring;
+  static SeqLock<uint32_t> seq;
+  static FlagSet<16> flags;
+  static uint8_t b;
+  static uint32_t w;
+  uint32_t cycles;
+
+  cycles = bench_run(128, [] { ring.push(b++); });
+  bench_report("isr_ring_push", cycles, 128, 1);
+  cycles = bench_run(128, [] { ring.pop(b); });
+  bench_report("isr_ring_pop", cycles, 128, 1);
+  cycles = bench_run(128, [] { ring.pop(b); });
+  bench_report("isr_ring_pop_empty", cycles, 128, 0);
+
+  cycles = bench_run(128, [] { seq.write(w++); });
+  bench_report("isr_seqlock_write", cycles, 128, sizeof(w));
+  cycles = bench_run(128, [] { w += seq.read(); });
+  bench_report("isr_seqlock_read", cycles, 128, sizeof(w));
+
+  cycles = bench_run(128, [] { flags.set(b++ & 15); });
+  bench_report("isr_flags_set", cycles, 128, 0);
+  cycles = bench_run(128, [] { w += flags.take(b++ & 15); });
+  bench_report("isr_flags_take", cycles, 128, 0);
+  cycles = bench_run(128, [] { w += flags.any(); });
+  bench_report("isr_flags_any", cycles, 128, 0);
+
+  static BlockPool<uint32_t, 32> pool;
+  static uint32_t *blocks[32];
+  cycles = bench_run(32, [] { blocks[b++ & 31] = pool.alloc(); });
+  bench_report("isr_pool_alloc", cycles, 32, sizeof(uint32_t));
+  cycles = bench_run(32, [] { pool.free(blocks[b++ & 31]); });
+  bench_report("isr_pool_free", cycles, 32, sizeof(uint32_t));
+}
+
+/**
+ * @brief TimerWheel with WHEEL_BENCH_TIMERS armed timers
+ * (lib/TimerWheel/WheelBench.h): 48 on the UNO, 256 on the MEGA
+ *
+ */
+void bench_wheel()
+{
+  typedef HalAvr<RelayBus<RelayTimingFast, RELAY_DATA, RELAY_CLK> > Hal;
+  uint16_t errors = wheel_bench<TimerWheel<>, Hal>([](const char *name, uint32_t ops, uint32_t us) {
+    bench_report(name, us * (F_CPU / 1000000UL), ops, 0);
+  });
+  Serial.print(F("#BENCH wheel_timers="));
+  Serial.print(WHEEL_BENCH_TIMERS);
+  Serial.print(F(" wrong_tick="));
+  Serial.println(errors);
+}
+
+/**
+ * @brief SerialLink transmit scheduling (lib/SerialLink/TxQueues.h)
+ *
+ * Queueing a 16-byte frame, and the per-byte work of the UDRE interrupt
+ * with bulk frames waiting behind every other priority.
+ */
+void bench_tx_queues()
+{
+  static TxQueues<64> q;
+  static uint8_t frame[16];
+  static uint16_t stamp;
+  uint32_t cycles;
+
+  cycles = bench_run(3, [] { q.push(TX_QUEUE_PRIORITIES - 1, frame, sizeof(frame), stamp); });
+  bench_report("tx_queue_push", cycles, 3, sizeof(frame));
+  for (uint8_t p = 0; p < TX_QUEUE_PRIORITIES - 1; p++)
+    q.push(p, frame, sizeof(frame), stamp);
+  cycles = bench_run(4 * 16, [] { stamp += q.next([] { return stamp; }); });
+  bench_report("tx_queue_next", cycles, 4 * 16, 1);
+}
+
+/**
+ * @brief LinkFrame COBS + CRC-16 (lib/EstufaCore/LinkFrame.h), one frame per op
+ *
+ * Encode, then decode in place: in a linear buffer, and where the receive
+ * ring holds it (FrameRing, wrapping round its end). Only the decode is
+ * timed, the body is restored before each. frames/s = F_CPU / cycles,
+ * cycles per byte = cycles / LEN.
+ */
+template <uint8_t LEN>
+void bench_link_frames(const char *encode, const char *decode, const char *ring_decode)
+{
+  static uint8_t payload[LEN], frame[LEN + LINK_FRAME_OVERHEAD], body[LEN + LINK_FRAME_OVERHEAD];
+  static FrameRing<128> rx;
+  for (uint8_t i = 0; i < LEN; i++)
+    payload[i] = i % 7 ? uint8_t(i * 37) : 0;
+  uint32_t cycles = bench_run(16, [] { link_frame(payload, LEN, frame); });
+  bench_report(encode, cycles, 16, LEN);
+
+  const uint8_t n = link_frame(payload, LEN, frame) - 2;
+  cycles = 0;
+  for (uint8_t k = 0; k < 16; k++) {
+    memcpy(body, frame + 1, n);
+    const uint32_t start = bench_cycles();
+    link_decode(body, n);
+    cycles += bench_cycles() - start;
+  }
+  bench_report(decode, cycles, 16, LEN);
+
+  RingSpan f;
+  cycles = 0;
+  for (uint8_t k = 0; k < 16; k++) {
+    rx.release();
+    for (uint8_t i = 0; i < n + 2; i++)
+      rx.put(frame[i]);
+    rx.frame(f);
+    const uint32_t start = bench_cycles();
+    link_decode(f, f.len);
+    cycles += bench_cycles() - start;
+  }
+  rx.release();
+  bench_report(ring_decode, cycles, 16, LEN);
+}
+
+
+void setup()
+{
+  bench_begin();
+  bench_relay();
+  bench_relay_chain<RelayBus<RelayTimingConservative, RELAY_DATA, RELAY_CLK> >("conservative");
+  report_irq_off<RelayTimingConservative>("conservative");
+  bench_relay_chain<RelayBus<RelayTimingFast, RELAY_DATA, RELAY_CLK> >("fast");
+  report_irq_off<RelayTimingFast>("fast");
+  // 74HC595 on SPI, latch on D10 (nothing masked)
+  bench_relay_chain<ShiftRegisterBus<10> >("hc595");
+  bench_core();
+  bench_isr_safe();
+  bench_wheel();
+  bench_tx_queues();
+  bench_link_frames<8>("link_encode_8", "link_decode_8", "link_ring_decode_8");
+  bench_link_frames<32>("link_encode_32", "link_decode_32", "link_ring_decode_32");
+  bench_link_frames<56>("link_encode_56", "link_decode_56", "link_ring_decode_56");
+  bench_done();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,201 @@
+/**
+ * @brief coresim - run the firmware core (lib/EstufaCore) on the host
+ *
+ *
+ * @notes:
+ * - The exact EstufaCore the controllers run, on the native HAL
+ * (host/lib/HalNative): relay frames are recorded instead of shifted out.
+ *
+ * - coresim run [--hours H] [--eeprom FILE.hex]
+ *   Boots the core (schedule image from FILE, as written by
+ *   host/optimizer --eeprom, else the compiled table), ticks it H hours
+ *   and checks every recorded frame against a plain LightSchedule model.
+ *   An image the core rejects (other zone count, bad CRC...) is reported
+ *   with the reason and fails the run instead of falling back silently.
+ *
+ * - coresim bench
+ *   CoreBench cases (lib/EstufaCore/CoreBench.h) for 1 and 64 modules,
+ *   same cases as the STM32 port under QEMU, then the TimerWheel cases
+ *   (lib/TimerWheel/WheelBench.h).
+ *
+ */
+#include <CoreBench.h>
+#include <EstufaCore.h>
+#include <HalNative.h>
+#include <WheelBench.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef EstufaCore<HalNative, 1> Core1;
+typedef EstufaCore<HalNative, 64> Core64;
+
+// Intel HEX data records into the native storage
+bool load_hex(const char *path)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.size() < 11 || line[0] != ':')
+      continue;
+    unsigned len = std::stoul(line.substr(1, 2), nullptr, 16);
+    unsigned addr = std::stoul(line.substr(3, 4), nullptr, 16);
+    unsigned type = std::stoul(line.substr(7, 2), nullptr, 16);
+    if (type != 0)
+      continue;
+    for (unsigned i = 0; i < len; i++)
+      if (addr + i < HalNative::storage().size())
+        HalNative::storage()[addr + i] =
+          uint8_t(std::stoul(line.substr(9 + 2 * i, 2), nullptr, 16));
+  }
+  return true;
+}
+
+int run(unsigned hours, bool want_image)
+{
+  ScheduleImageHeader hdr;
+  std::memcpy(&hdr, HalNative::storage().data() + SCHEDULE_EEPROM_ADDR, sizeof(hdr));
+  const ScheduleImageStatus status = Core1::load_schedules();
+  Core1::begin();
+  std::printf("schedules from %s, %u zones\n",
+              status == SCHEDULE_IMAGE_OK ? "EEPROM image" : "compiled table",
+              unsigned(SCHEDULE_ZONES));
+  switch (status) {
+    case SCHEDULE_IMAGE_ABSENT:
+      if (want_image)
+        std::printf("EEPROM image rejected: no 'E' 'S' header at %u\n",
+                    unsigned(SCHEDULE_EEPROM_ADDR));
+      break;
+    case SCHEDULE_IMAGE_OTHER_VERSION:
+      std::printf("EEPROM image rejected: version %u, firmware reads %u\n",
+                  unsigned(hdr.version), unsigned(SCHEDULE_IMAGE_VERSION));
+      break;
+    case SCHEDULE_IMAGE_ZONE_COUNT:
+      std::printf("EEPROM image rejected: %u zones, firmware built for %u "
+                  "(use the header from the same optimizer run)\n",
+                  unsigned(hdr.count), unsigned(SCHEDULE_ZONES));
+      break;
+    case SCHEDULE_IMAGE_CRC:
+      std::printf("EEPROM image rejected: bad CRC\n");
+      break;
+    case SCHEDULE_IMAGE_ENTRY:
+      std::printf("EEPROM image rejected: invalid entry\n");
+      break;
+    default:
+      break;
+  }
+  if (want_image && status != SCHEDULE_IMAGE_OK)
+    return 1;
+
+  // Reference model: the same entries straight through LightSchedule
+  LightSchedule model[SCHEDULE_ZONES];
+  for (uint8_t z = 0; z < SCHEDULE_ZONES; z++)
+    model[z] = Core1::schedule(z);
+
+  std::vector<uint8_t> expected;
+  auto mask = [&]() {
+    uint8_t m = 0;
+    for (uint8_t z = 0; z < SCHEDULE_ZONES; z++)
+      m |= uint8_t(model[z].is_on() << z);
+    return m;
+  };
+  expected.push_back(0);       // all OFF
+  expected.push_back(mask());  // initial states
+
+  unsigned failures = 0;
+  for (unsigned h = 1; h <= hours; h++) {
+    uint8_t model_toggled = 0;
+    for (uint8_t z = 0; z < SCHEDULE_ZONES; z++)
+      if (model[z].tick())
+        model_toggled |= uint8_t(1 << z);
+    if (model_toggled)
+      expected.push_back(mask());
+
+    // Every toggled zone reported once, with its new state
+    uint8_t toggled = 0;
+    bool states_ok = true;
+    Core1::tick([&](uint8_t zone, bool on) {
+      toggled |= uint8_t(1 << zone);
+      states_ok &= on == model[zone].is_on();
+    });
+    if ((toggled != model_toggled || !states_ok) && failures++ < 20)
+      std::printf("FAIL hour %u: zones 0x%02X toggled, model 0x%02X\n", h, toggled, model_toggled);
+    if (Core1::refresh_pending())
+      Core1::send_relays();
+  }
+
+  const auto &frames = HalNative::Relay::frames();
+  if (frames.size() != expected.size()) {
+    std::printf("FAIL count: %zu frames, model has %zu\n", frames.size(), expected.size());
+    failures++;
+  }
+  for (size_t i = 0; i < frames.size() && i < expected.size(); i++)
+    if (frames[i].back() != expected[i] && failures++ < 20)
+      std::printf("FAIL frame %zu: 0x%02X, model 0x%02X\n", i, frames[i].back(), expected[i]);
+
+  std::printf("%s: %zu frames over %u hours, %u mismatch(es)\n",
+              failures ? "FAILED" : "PASSED", frames.size(), hours, failures);
+  return failures ? 1 : 0;
+}
+
+template <class Core>
+void bench(const char *modules)
+{
+  core_bench<Core, HalNative>([&](const char *name, uint32_t ops, uint32_t clocks) {
+    double ns = double(clocks) * 1e9 / HalNative::clock_hz() / ops;
+    std::printf("BENCH %s_%s ns=%.1f ops_per_s=%.0f\n", name, modules, ns, 1e9 / ns);
+  });
+  HalNative::Relay::frames().clear();
+}
+
+int bench_wheel()
+{
+  uint16_t errors = wheel_bench<TimerWheel<>, HalNative>([](const char *name, uint32_t ops, uint32_t clocks) {
+    double ns = double(clocks) * 1e9 / HalNative::clock_hz() / ops;
+    std::printf("BENCH %s_%u ns=%.1f ops_per_s=%.0f\n", name, WHEEL_BENCH_TIMERS, ns, 1e9 / ns);
+  });
+  if (errors)
+    std::printf("FAIL wheel: %u timer(s) fired on the wrong tick\n", errors);
+  return errors ? 1 : 0;
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  if (argc < 2 || (std::strcmp(argv[1], "run") && std::strcmp(argv[1], "bench"))) {
+    std::fprintf(stderr, "usage: coresim run [--hours H] [--eeprom FILE.hex]\n"
+                         "       coresim bench\n");
+    return 2;
+  }
+
+  if (!std::strcmp(argv[1], "bench")) {
+    bench<Core1>("m1");
+    bench<Core64>("m64");
+    return bench_wheel();
+  }
+
+  unsigned hours = 24 * 60;
+  bool want_image = false;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (!std::strcmp(argv[i], "--hours"))
+      hours = unsigned(std::atoi(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "--eeprom") && !load_hex(argv[i + 1])) {
+      std::fprintf(stderr, "coresim: cannot read %s\n", argv[i + 1]);
+      return 2;
+    }
+    else if (!std::strcmp(argv[i], "--eeprom"))
+      want_image = true;
+  }
+  return run(hours, want_image);
+}
@@ -0,0 +1,799 @@
+/**
+ * @brief estufalink - the status build's serial link, from the host
+ *
+ *
+ * @notes:
+ * - Talks to the firmware built with FEATURE_STATUS_LOG (src/main.cpp):
+ * status text with LinkFrame binary frames (COBS, CRC-16) in between.
+ *
+ * - estufalink --port DEV [--baud B] COMMAND
+ *   telemetry [--records N]     telemetry snapshots as CSV on stdout, one
+ *                               row per record (FEATURE_TELEMETRY); status
+ *                               lines go to stderr
+ *   interval MS                 sets the telemetry interval, 0 stops the
+ *                               stream (FEATURE_TELEMETRY, through the
+ *                               event log's session: FEATURE_EVENT_LOG)
+ *   dump [--fast B] [--from SEQ] [--page N]
+ *                               the event log as CSV (FEATURE_EVENT_LOG),
+ *                               at B baud if the link can do it (500000,
+ *                               1000000), then back to --baud; N records
+ *                               per page. Cut short, it prints what it got
+ *                               and the SEQ to resume from
+ *
+ * - estufalink selftest [--records N]
+ *   Fuzzes LinkFrame (lib/EstufaCore/LinkFrame.h) with single lost
+ *   bytes and flipped bits: no damaged frame may pass its check.
+ *   Floods SerialLink's transmit queues (lib/SerialLink/TxQueues.h)
+ *   with telemetry and bulk frames at 115200 and checks that responses
+ *   still go out first at the next frame boundary, within one bulk frame.
+ *   Runs the firmware's Telemetry (lib/EstufaCore/Telemetry.h) on a
+ *   stepped clock at the other end of a pty, with status lines, a
+ *   corrupted frame and one that lost its delimiter mixed in, and
+ *   checks every record's min/max/mean against the samples it covers.
+ *   Then runs LinkSession (lib/EstufaCore/LinkSession.h) over a pty
+ *   that paces bytes at the emulated device's rate and garbles them when
+ *   the two ends disagree on it: sets and stops the telemetry interval,
+ *   dumps a 4096-record event log at 115200,
+ *   500k and 1M (records/s for each), resumes a download cut short from
+ *   its cursor, measures the download through line noise (1e-4 to 3e-3
+ *   of the bytes damaged or lost) per page size, and checks the
+ *   fallbacks: an adapter that cannot do 1M, a refused rate, and the
+ *   device's return to 115200 once the host goes quiet.
+ *
+ */
+#include <EventLog.h>
+#include <FrameRing.h>
+#include <LinkClient.h>
+#include <LinkFrame.h>
+#include <LinkPort.h>
+#include <LinkSession.h>
+#include <Telemetry.h>
+#include <TxQueues.h>
+
+#include <termios.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Device clock advanced by the emulation, 1 ms per pass
+struct StepHal
+{
+  static uint32_t now_us;
+  static uint32_t clock() { return now_us; }
+  static uint32_t clock_hz() { return 1000000UL; }
+};
+uint32_t StepHal::now_us = 0;
+
+constexpr uint8_t SELFTEST_CHANNELS = 3;
+constexpr uint16_t SELFTEST_INTERVAL_MS = 500;
+constexpr unsigned SELFTEST_PER_RECORD = SELFTEST_INTERVAL_MS / TELEMETRY_SAMPLE_MS;
+
+typedef Telemetry<StepHal, SELFTEST_CHANNELS> DeviceTelemetry;
+
+// Sample k (from 1) of channel c in the selftest
+int16_t selftest_value(unsigned k, uint8_t c)
+{
+  switch (c) {
+    case 0:  return int16_t(int(k % 7) * 100 - 300);
+    case 1:  return int16_t((k * 37) % 1000);
+    default: return int16_t(k % 2 ? -32768 : 32767);
+  }
+}
+
+struct Options
+{
+  std::string port;
+  unsigned baud = 115200;
+  unsigned fast = 0;
+  unsigned records = 0;
+  uint32_t from = 0;
+  unsigned page = estufa::LinkClient::page_records;
+};
+
+
+/**
+ * @brief Split the stream: text to `text`, checked frames to `record`
+ *
+ */
+struct StreamSplitter
+{
+  estufa::LinkReader reader;
+
+  // One read from the port into the reader's buffer, then what is complete
+  template <class Text, class Record>
+  long pump(estufa::LinkPort &port, int timeout_ms, Text text, Record record)
+  {
+    size_t room;
+    uint8_t *buf = reader.space(256, room);
+    const long n = port.read(buf, room, timeout_ms);
+    if (n <= 0)
+      return n;
+    reader.commit(size_t(n));
+    const uint8_t *data;
+    size_t len;
+    estufa::LinkReader::Kind kind;
+    while ((kind = reader.next(data, len)) != estufa::LinkReader::NONE)
+      if (kind == estufa::LinkReader::TEXT)
+        text(std::string(reinterpret_cast<const char *>(data), len));
+      else if (len <= 255)
+        record(data, uint8_t(len));
+    return n;
+  }
+};
+
+
+int telemetry(estufa::LinkPort &port, unsigned records)
+{
+  StreamSplitter split;
+  unsigned seen = 0;
+  bool header = false;
+  while (!records || seen < records) {
+    const long n = split.pump(port, 1000,
+      [](const std::string &line) { std::fputs(line.c_str(), stderr); },
+      [&](const uint8_t *rec, uint8_t len) {
+        uint16_t seq, samples;
+        uint32_t end_ms;
+        TelemetryStat stats[32];
+        uint8_t ch = telemetry_decode(rec, len, seq, end_ms, samples, stats, 32);
+        if (!ch)
+          return;
+        if (!header) {
+          std::printf("seq,end_ms,samples");
+          for (uint8_t c = 0; c < ch; c++)
+            std::printf(",ch%u_min,ch%u_max,ch%u_mean", c, c, c);
+          std::printf("\n");
+          header = true;
+        }
+        std::printf("%u,%u,%u", seq, end_ms, samples);
+        for (uint8_t c = 0; c < ch; c++)
+          std::printf(",%d,%d,%d", stats[c].min, stats[c].max, stats[c].mean);
+        std::printf("\n");
+        std::fflush(stdout);
+        seen++;
+      });
+    if (n < 0) {
+      std::fprintf(stderr, "estufalink: read error\n");
+      return 1;
+    }
+  }
+  if (split.reader.bad_frames())
+    std::fprintf(stderr, "#estufalink: %u bad frame(s)\n", split.reader.bad_frames());
+  return 0;
+}
+
+
+/**
+ * @brief The device end of the pty: Telemetry plus status lines
+ *
+ * The third record is sent with a flipped bit, then again intact: the
+ * host must drop the first copy. The sixth loses its closing delimiter
+ * and runs into the status text after it: the host loses that record
+ * and must be back in step for the seventh.
+ *
+ */
+void emulate_device(estufa::LinkPort &port, unsigned records)
+{
+  DeviceTelemetry::set_interval(SELFTEST_INTERVAL_MS);
+  unsigned k = 0, sent = 0;
+  while (sent < records) {
+    StepHal::now_us += 1000;
+    if (StepHal::now_us % 250000 == 0) {
+      char line[48];
+      int n = std::snprintf(line, sizeof(line), "#EVENT hour=%u zone=0 on=%u\n", StepHal::now_us / 250000, k & 1);
+      port.write(reinterpret_cast<const uint8_t *>(line), size_t(n));
+    }
+    DeviceTelemetry::poll(
+      [&](int16_t *v) {
+        k++;
+        for (uint8_t c = 0; c < SELFTEST_CHANNELS; c++)
+          v[c] = selftest_value(k, c);
+      },
+      [&](const uint8_t *rec, uint8_t len) {
+        uint8_t frame[DeviceTelemetry::record_size + LINK_FRAME_OVERHEAD];
+        uint8_t n = link_frame(rec, len, frame);
+        const uint8_t flip = frame[6] == 0x10 ? 0x20 : 0x10;
+        if (sent == 2) {
+          frame[6] ^= flip;
+          port.write(frame, n);
+          frame[6] ^= flip;
+        }
+        port.write(frame, sent == 5 ? n - 1 : n);
+        sent++;
+      });
+  }
+}
+
+unsigned failures = 0;
+
+void expect(bool cond, const char *what)
+{
+  std::printf("%s %s\n", cond ? "ok  " : "FAIL", what);
+  failures += !cond;
+}
+
+void selftest_telemetry(const Options &opt)
+{
+  int master_fd;
+  std::string slave_path, error;
+  estufa::LinkPort device, host;
+  if (!estufa::open_pty(master_fd, slave_path, error) ||
+      !device.attach(master_fd, opt.baud, error) ||
+      !host.open(slave_path, opt.baud, error)) {
+    std::fprintf(stderr, "estufalink: %s\n", error.c_str());
+    expect(false, "telemetry: pty opened");
+    return;
+  }
+  const unsigned records = opt.records ? opt.records : 20;
+  std::thread dev(emulate_device, std::ref(device), records);
+  std::printf("device emulated on %s, %u records of %u samples\n", slave_path.c_str(), records,
+              SELFTEST_PER_RECORD);
+
+  StreamSplitter split;
+  unsigned lines = 0, got = 0, wrong = 0, out_of_step = 0;
+  std::vector<bool> seen(records);
+  while (!seen[records - 1]) {
+    const long n = split.pump(host, 2000,
+      [&](const std::string &line) { lines += line.compare(0, 7, "#EVENT ") == 0; },
+      [&](const uint8_t *rec, uint8_t len) {
+        uint16_t seq, samples;
+        uint32_t end_ms;
+        TelemetryStat stats[SELFTEST_CHANNELS];
+        if (telemetry_decode(rec, len, seq, end_ms, samples, stats, SELFTEST_CHANNELS) != SELFTEST_CHANNELS) {
+          wrong++;
+          return;
+        }
+        out_of_step += seq >= records || seen[seq] || samples != SELFTEST_PER_RECORD ||
+                       end_ms != (seq + 1u) * SELFTEST_INTERVAL_MS;
+        if (seq < records)
+          seen[seq] = true;
+        for (uint8_t c = 0; c < SELFTEST_CHANNELS; c++) {
+          int32_t lo = 32767, hi = -32768, sum = 0;
+          for (unsigned k = seq * SELFTEST_PER_RECORD + 1; k <= (seq + 1u) * SELFTEST_PER_RECORD; k++) {
+            int16_t v = selftest_value(k, c);
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+            sum += v;
+          }
+          wrong += stats[c].min != lo || stats[c].max != hi ||
+                   stats[c].mean != int16_t(sum / int32_t(SELFTEST_PER_RECORD));
+        }
+        got++;
+      });
+    if (n <= 0)
+      break;
+  }
+  dev.join();
+
+  expect(got == records - 1 && !seen[5], "telemetry: every record but the one that lost its delimiter");
+  expect(!wrong, "telemetry: min/max/mean match the samples of each interval");
+  expect(!out_of_step, "telemetry: sequence, end time and sample count in step");
+  expect(split.reader.bad_frames() == 2, "telemetry: corrupted and unterminated frames dropped");
+  expect(lines >= records * SELFTEST_INTERVAL_MS / 250 - 3, "telemetry: status lines intact between frames");
+}
+
+
+struct SteadyHal
+{
+  static uint32_t clock() { return uint32_t(uint64_t(estufa::steady_us())); }
+  static uint32_t clock_hz() { return 1000000UL; }
+};
+
+/**
+ * @brief SerialLink as seen from a pty
+ *
+ * Frames are written at once, but space() only frees the BULK queue
+ * (SERIAL_LINK_QUEUE bytes) as fast as the wire would drain it at the
+ * emulated rate. A pty has one termios for both ends: the host's rate is
+ * read from it, and bytes cross garbled while the two rates differ or the
+ * device is above broken_above (an adapter that cannot follow).
+ * error_rate adds line noise both ways, from fixed seeds.
+ *
+ */
+struct EmuPort
+{
+  enum Priority { RESPONSE, ALARM, TELEMETRY, BULK };
+  static constexpr uint8_t max_frame = 64 - 3;
+  static constexpr unsigned queue = 64;
+
+  static estufa::LinkPort *port;
+  static uint32_t baud;
+  static uint32_t broken_above;
+  static double busy_until_us;
+  static double error_rate;
+  static std::mt19937 tx_rng, rx_rng;
+  static FrameRing<128> rx;
+
+  static bool garbled()
+  {
+    termios tio;
+    const unsigned line = tcgetattr(port->fd(), &tio) == 0 ? estufa::speed_baud(cfgetospeed(&tio)) : 0;
+    return line != baud || (broken_above && baud > broken_above);
+  }
+
+  static double byte_us() { return 10e6 / baud; }
+
+  // Line noise: each byte has error_rate odds of a flipped bit or of
+  // being lost, half and half; false if lost
+  static bool noise(std::mt19937 &rng, uint8_t &c)
+  {
+    if (!error_rate || std::uniform_real_distribution<double>(0, 1)(rng) >= error_rate)
+      return true;
+    const unsigned r = rng();
+    c ^= uint8_t(1 << (r % 8));
+    return r & 8;
+  }
+
+  static bool send(uint8_t, const void *data, uint8_t len, bool = false)
+  {
+    uint8_t buf[256];
+    const bool bad = garbled();
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < len; i++) {
+      buf[n] = static_cast<const uint8_t *>(data)[i] ^ (bad ? 0x5A : 0);
+      n += noise(tx_rng, buf[n]);
+    }
+    busy_until_us = std::max(estufa::steady_us(), busy_until_us) + len * byte_us();
+    return port->write(buf, n);
+  }
+
+  static uint8_t space(uint8_t)
+  {
+    const double queued = std::max(0.0, busy_until_us - estufa::steady_us()) / byte_us();
+    const double free = queue - queued - 3;
+    return free <= 0 ? 0 : free >= max_frame ? max_frame : uint8_t(free);
+  }
+
+  typedef RingSpan Span;
+
+  // As SerialLink::frame(), the ring fed from the pty instead of the ISR
+  static bool frame(Span &payload)
+  {
+    uint8_t buf[64];
+    const long n = port->read(buf, sizeof(buf), 0);
+    const uint8_t mask = garbled() ? 0x5A : 0;
+    for (long i = 0; i < n; i++) {
+      uint8_t c = buf[i] ^ mask;
+      if (noise(rx_rng, c))
+        rx.put(c);
+    }
+    while (rx.frame(payload)) {
+      const int16_t len = link_decode(payload, payload.len);
+      if (len >= 0) {
+        payload.len = uint8_t(len);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void release() { rx.release(); }
+
+  static bool idle() { return estufa::steady_us() >= busy_until_us; }
+
+  static bool baud_ok(uint32_t b) { return b == 115200 || b == 230400 || b == 500000 || b == 1000000; }
+  static bool set_baud(uint32_t b)
+  {
+    baud = b;
+    return true;
+  }
+};
+
+estufa::LinkPort *EmuPort::port = nullptr;
+uint32_t EmuPort::baud = 115200;
+uint32_t EmuPort::broken_above = 0;
+double EmuPort::busy_until_us = 0;
+double EmuPort::error_rate = 0;
+std::mt19937 EmuPort::tx_rng(75), EmuPort::rx_rng(57);
+FrameRing<128> EmuPort::rx;
+
+constexpr uint16_t SELFTEST_LOG = 4096;
+constexpr uint32_t SELFTEST_LOGGED = SELFTEST_LOG + 100;   // The oldest 100 overwritten
+
+typedef EventLog<SELFTEST_LOG> EmuLog;
+typedef Telemetry<SteadyHal, SELFTEST_CHANNELS> EmuTelemetry;
+typedef LinkSession<EmuPort, SteadyHal, EmuLog, EmuTelemetry> EmuSession;
+
+EventRecord selftest_record(uint32_t seq)
+{
+  EventRecord r;
+  r.hour = seq * 3;
+  r.zone = seq % 128;
+  r.on = (seq >> 7) & 1;     // Both states for every zone
+  r.pool_in_use = uint8_t(seq % 4);
+  r.pool_high = uint8_t(seq % 5);
+  r.pool_failed = uint8_t(seq >> 12);
+  return r;
+}
+
+void emulate_session(estufa::LinkPort &port, std::atomic<bool> &stop)
+{
+  EmuPort::port = &port;
+  EmuSession::begin(115200);
+  while (!stop) {
+    EmuSession::poll();
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+  }
+}
+
+bool dump_intact(const estufa::DumpResult &d)
+{
+  bool ok = d.ok && d.first == SELFTEST_LOGGED - SELFTEST_LOG && d.end == SELFTEST_LOGGED &&
+            !d.missing && d.records.size() == SELFTEST_LOG;
+  for (size_t i = 0; ok && i < d.records.size(); i++) {
+    const EventRecord e = selftest_record(d.first + uint32_t(i));
+    ok = d.seq[i] == d.first + i && !std::memcmp(&d.records[i], &e, sizeof(e));
+  }
+  return ok;
+}
+
+void print_dump(unsigned baud, const estufa::DumpResult &d)
+{
+  std::printf("%8u  %7zu  %7.0f  %7.3f  %9.0f  %8.1f  %5.1f%%\n", baud, d.records.size(), d.bytes,
+              d.seconds, d.records.size() / d.seconds, d.bytes / d.seconds / 1000,
+              100.0 * d.bytes * 10 / baud / d.seconds);
+}
+
+// Cut a 1M download short, then finish it from its cursor with a new client
+void selftest_resume(estufa::LinkPort &host, estufa::LinkClient &link)
+{
+  const estufa::DumpResult cut = link.dump(0, 1500);
+  expect(!cut.ok && cut.records.size() == 1500 && cut.next == cut.first + 1500,
+         "link: download cut short, cursor after the last record");
+  estufa::LinkClient again(host);
+  estufa::DumpResult rest = again.dump(cut.next);
+  rest.seq.insert(rest.seq.begin(), cut.seq.begin(), cut.seq.end());
+  rest.records.insert(rest.records.begin(), cut.records.begin(), cut.records.end());
+  rest.first = cut.first;
+  expect(dump_intact(rest), "link: resumed from the cursor, full log in order");
+}
+
+/**
+ * @brief Full log at 1M through line noise, per page size
+ *
+ * Effective rate (records/s) and wire use against the clean line; every
+ * download must still be intact.
+ */
+void selftest_noise(estufa::LinkClient &link)
+{
+  std::printf("  errors  page  records/s  pages  retries      bytes   wire  intact\n");
+  unsigned broken = 0;
+  double clean = 0, noisy = 0;
+  for (double rate : {0.0, 1e-4, 1e-3, 3e-3}) {
+    for (uint16_t page : {16, 64, 256}) {
+      EmuPort::error_rate = rate;
+      const estufa::DumpResult d = link.dump(0, UINT32_MAX, page);
+      EmuPort::error_rate = 0;
+      const bool intact = dump_intact(d);
+      broken += !intact;
+      std::printf("  %6g  %4u  %9.0f  %5u  %7u  %9.0f  %4.1f%%  %s\n", rate, page, d.records.size() / d.seconds,
+                  d.pages, d.retries, d.bytes, 100.0 * d.bytes * 10 / EmuPort::baud / d.seconds,
+                  intact ? "yes" : "NO");
+      if (page == estufa::LinkClient::page_records && rate == 0)
+        clean = d.records.size() / d.seconds;
+      if (page == estufa::LinkClient::page_records && rate == 1e-3)
+        noisy = d.records.size() / d.seconds;
+    }
+  }
+  expect(!broken, "link: every download through noise intact");
+  expect(noisy > clean / 2, "link: 1 byte in 1000 damaged, more than half the clean rate");
+}
+
+void selftest_link()
+{
+  int master_fd;
+  std::string slave_path, error;
+  estufa::LinkPort device, host;
+  if (!estufa::open_pty(master_fd, slave_path, error) ||
+      !device.attach(master_fd, 115200, error) ||
+      !host.open(slave_path, 115200, error)) {
+    std::fprintf(stderr, "estufalink: %s\n", error.c_str());
+    expect(false, "link: pty opened");
+    return;
+  }
+  for (uint32_t seq = 0; seq < SELFTEST_LOGGED; seq++)
+    EmuLog::append(selftest_record(seq));
+  std::atomic<bool> stop(false);
+  std::thread dev(emulate_session, std::ref(device), std::ref(stop));
+  std::printf("device emulated on %s, event log of %u records\n", slave_path.c_str(), SELFTEST_LOG);
+
+  estufa::LinkClient link(host);
+  expect(link.ping(), "link: probe answered at 115200");
+
+  expect(link.telemetry_interval(250) == 250, "link: telemetry interval set to 250 ms");
+  expect(link.telemetry_interval(0) == 0, "link: telemetry stream stopped");
+  expect(link.telemetry_interval(TELEMETRY_INTERVAL_MS) == TELEMETRY_INTERVAL_MS,
+         "link: telemetry interval back to the default");
+
+  std::printf("    baud  records    bytes        s  records/s      kB/s   wire\n");
+  estufa::DumpResult base = link.dump();
+  print_dump(115200, base);
+  expect(dump_intact(base), "link: full log at 115200, every record in order");
+
+  double rate_1m = 0;
+  for (unsigned baud : {500000U, 1000000U}) {
+    const unsigned got = link.upgrade(baud);
+    char what[64];
+    std::snprintf(what, sizeof(what), "link: upgraded to %u", baud);
+    expect(got == baud && EmuPort::baud == baud, what);
+    estufa::DumpResult d = link.dump();
+    print_dump(baud, d);
+    std::snprintf(what, sizeof(what), "link: full log at %u, every record in order", baud);
+    expect(dump_intact(d), what);
+    if (baud == 1000000)
+      rate_1m = d.records.size() / d.seconds;
+  }
+  expect(rate_1m > 4 * base.records.size() / base.seconds, "link: 1M dumps more than 4x faster than 115200");
+
+  selftest_resume(host, link);
+  selftest_noise(link);
+  expect(link.upgrade(115200) == 115200 && EmuPort::baud == 115200, "link: back to 115200 on request");
+
+  expect(link.upgrade(1234567) == 115200 && EmuPort::baud == 115200, "link: rate the device cannot make refused");
+
+  EmuPort::broken_above = 500000;
+  const double t0 = estufa::steady_us();
+  const unsigned fell = link.upgrade(1000000);
+  std::printf("adapter limited to 500k: upgrade to 1M settled at %u in %.0f ms\n", fell,
+              (estufa::steady_us() - t0) / 1000);
+  expect(fell == 115200 && EmuPort::baud == 115200, "link: no probe at 1M, both ends back at 115200");
+  expect(dump_intact(link.dump()), "link: full log after the fallback");
+  EmuPort::broken_above = 0;
+
+  expect(link.upgrade(1000000) == 1000000, "link: upgraded to 1M again");
+  std::this_thread::sleep_for(std::chrono::milliseconds(LINK_FAST_IDLE_MS + 500));
+  expect(EmuPort::baud == 115200, "link: device back at 115200 after the host went quiet");
+  host.set_baud(115200);
+  expect(link.ping(), "link: probe answered at 115200 again");
+
+  stop = true;
+  dev.join();
+}
+
+/**
+ * @brief LinkFrame against single-byte damage, from a fixed seed
+ *
+ * Every frame must decode intact as sent, and fail its check with any one
+ * byte of the body lost or with one bit flipped (never into 0x00, which
+ * would split the frame instead).
+ */
+void selftest_frames()
+{
+  const unsigned frames = 200000;
+  std::mt19937 rng(74);
+  unsigned wrong = 0, dropped = 0, flipped = 0;
+  for (unsigned t = 0; t < frames; t++) {
+    uint8_t payload[56], frame[56 + LINK_FRAME_OVERHEAD], body[56 + LINK_FRAME_OVERHEAD];
+    const uint8_t len = uint8_t(1 + rng() % sizeof(payload));
+    for (uint8_t i = 0; i < len; i++)
+      payload[i] = rng() % 4 ? uint8_t(rng()) : 0;
+    const uint8_t n = uint8_t(link_frame(payload, len, frame) - 2);
+    const uint8_t *sent = frame + 1;
+
+    std::memcpy(body, sent, n);
+    wrong += link_decode(body, n) != len || std::memcmp(body, payload, len);
+
+    const uint8_t at = uint8_t(rng() % n);
+    std::memcpy(body, sent, at);
+    std::memcpy(body + at, sent + at + 1, n - at - 1u);
+    dropped += link_decode(body, uint16_t(n - 1)) >= 0;
+
+    std::memcpy(body, sent, n);
+    uint8_t bit = uint8_t(1 << (rng() % 8));
+    if (body[at] == bit)
+      bit = bit == 1 ? 2 : 1;
+    body[at] ^= bit;
+    flipped += link_decode(body, n) >= 0;
+  }
+  std::printf("frames: %u, each with one byte lost and with one bit flipped\n", frames);
+  expect(!wrong, "frames: every frame decoded as sent");
+  expect(!dropped, "frames: no frame with a byte lost accepted");
+  expect(!flipped, "frames: no frame with a bit flipped accepted");
+}
+
+/**
+ * @brief TxQueues (lib/SerialLink/TxQueues.h) under a transmit flood
+ *
+ * The transmit interrupt is a loop taking one byte per byte time at
+ * 115200 on a stepped clock. BULK is kept full of max_frame frames,
+ * TELEMETRY gets one every 150 byte times (about 40% of the wire); a
+ * RESPONSE is queued at a random byte time whenever none is waiting. Every byte on the wire must continue the frame in
+ * progress, or start the oldest frame of the most urgent queue that had
+ * one, and no response may wait longer than one bulk frame.
+ */
+void selftest_txqueues()
+{
+  enum { RESPONSE, ALARM, TELEMETRY, BULK };
+  const uint32_t baud = 115200, bytes = 400000;
+  const double byte_us = 10e6 / baud;
+  typedef TxQueues<64> Q;     // SERIAL_LINK_QUEUE
+  static Q q;
+
+  std::mt19937 rng(71);
+  std::vector<std::vector<uint8_t>> queued[Q::priorities];
+  unsigned pushed[Q::priorities] = {}, sent[Q::priorities] = {};
+  uint32_t response_at = 0, worst_wait = 0;
+  unsigned wrong = 0, responses = 0;
+  std::vector<uint8_t> cur;
+  uint8_t cur_pos = 0;
+  double now_us = 0;
+
+  auto push = [&](uint8_t prio, uint8_t len) {
+    std::vector<uint8_t> f(len);
+    f[0] = prio;
+    for (uint8_t i = 1; i < len; i++)
+      f[i] = uint8_t(pushed[prio] * 7 + i);
+    if (!q.push(prio, f.data(), len, uint16_t(now_us)))
+      return false;
+    queued[prio].push_back(f);
+    pushed[prio]++;
+    return true;
+  };
+
+  for (uint32_t t = 0; t < bytes; t++, now_us += byte_us) {
+    while (push(BULK, Q::max_frame)) {
+    }
+    if (t % 150 == 0)
+      push(TELEMETRY, Q::max_frame);
+    if (queued[RESPONSE].empty() && rng() % 64 == 0 && push(RESPONSE, uint8_t(4 + rng() % 13)))
+      response_at = t;
+
+    // The most urgent queue with a frame waiting when the byte is taken
+    uint8_t urgent = 0;
+    while (urgent < Q::priorities && queued[urgent].empty())
+      urgent++;
+
+    const int16_t c = q.next([&] { return uint16_t(now_us); });
+    if (c < 0) {
+      wrong++;
+      continue;
+    }
+    if (cur_pos == cur.size()) {
+      // A frame boundary: the next frame must be the most urgent one
+      if (urgent == Q::priorities || c != urgent) {
+        wrong++;
+        break;
+      }
+      cur = queued[urgent].front();
+      queued[urgent].erase(queued[urgent].begin());
+      cur_pos = 0;
+      sent[urgent]++;
+      if (urgent == RESPONSE) {
+        worst_wait = std::max(worst_wait, t - response_at);
+        responses++;
+      }
+    }
+    wrong += uint8_t(c) != cur[cur_pos++];
+  }
+
+  TxStats rs, bs;
+  q.stats(RESPONSE, rs);
+  q.stats(BULK, bs);
+  const double worst_ms = worst_wait * byte_us / 1000;
+  std::printf("txqueues: %u bytes at %u baud, %u responses, %u telemetry and %u bulk frames; "
+              "worst response wait %.2f ms (%u bytes)\n",
+              bytes, baud, responses, sent[TELEMETRY], sent[BULK], worst_ms, worst_wait);
+  expect(!wrong, "txqueues: whole frames on the wire, the most urgent one first at each boundary");
+  expect(responses > 1000 && sent[TELEMETRY] > 0 && sent[BULK] > 0,
+         "txqueues: responses, telemetry and bulk all went out under the flood");
+  expect(worst_wait <= Q::max_frame, "txqueues: no response waited more than one bulk frame");
+  expect(worst_wait >= Q::max_frame * 3 / 4, "txqueues: some response did wait behind a bulk frame");
+  expect(rs.frames == responses && rs.preempted == responses && rs.dropped == 0,
+         "txqueues: every response preempted the waiting telemetry and bulk");
+  expect(rs.max_wait_us <= Q::max_frame * byte_us + 1, "txqueues: the queue's own worst-wait counter agrees");
+  expect(bs.frames == sent[BULK], "txqueues: bulk frame count agrees");
+}
+
+int selftest(const Options &opt)
+{
+  selftest_frames();
+  selftest_txqueues();
+  selftest_telemetry(opt);
+  selftest_link();
+  std::printf("%s: %u failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 1 : 0;
+}
+
+
+int dump(estufa::LinkPort &port, const Options &opt)
+{
+  const unsigned base = opt.baud, fast = opt.fast;
+  estufa::LinkClient link(port, base);
+  link.on_text([](const std::string &line) { std::fputs(line.c_str(), stderr); });
+  unsigned baud = base;
+  if (fast) {
+    baud = link.upgrade(fast);
+    if (!baud) {
+      std::fprintf(stderr, "estufalink: device lost during the baud upgrade\n");
+      return 1;
+    }
+    if (baud != fast)
+      std::fprintf(stderr, "#estufalink: %u baud refused or failed, dumping at %u\n", fast, baud);
+  }
+  estufa::DumpResult d = link.dump(opt.from, UINT32_MAX, uint16_t(std::max(1U, std::min(opt.page, 65535U))));
+  if (baud != base)
+    link.upgrade(base);
+  if (!opt.from)
+    std::printf("seq,hour,zone,on,pool_in_use,pool_high,pool_failed\n");
+  for (size_t i = 0; i < d.records.size(); i++) {
+    const EventRecord &e = d.records[i];
+    std::printf("%u,%u,%u,%u,%u,%u,%u\n", d.seq[i], e.hour, unsigned(e.zone), unsigned(e.on),
+                e.pool_in_use, e.pool_high, e.pool_failed);
+  }
+  std::fprintf(stderr, "#DUMP records=%zu missing=%u retries=%u next=%u baud=%u seconds=%.3f records_per_s=%.0f\n",
+               d.records.size(), d.missing, d.retries, d.next, baud, d.seconds, d.records.size() / d.seconds);
+  if (!d.ok) {
+    std::fprintf(stderr, "estufalink: dump incomplete, resume with --from %u\n", d.next);
+    return 1;
+  }
+  return 0;
+}
+
+int usage()
+{
+  std::fprintf(stderr,
+               "usage: estufalink --port DEV [--baud B] COMMAND\n"
+               "         telemetry [--records N] | interval MS\n"
+               "         | dump [--fast B] [--from SEQ] [--page N]\n"
+               "       estufalink selftest [--records N]\n");
+  return 2;
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    if (!std::strcmp(argv[i], "--port") && i + 1 < argc)         opt.port = argv[++i];
+    else if (!std::strcmp(argv[i], "--baud") && i + 1 < argc)    opt.baud = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--fast") && i + 1 < argc)    opt.fast = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--records") && i + 1 < argc) opt.records = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--from") && i + 1 < argc)    opt.from = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+    else if (!std::strcmp(argv[i], "--page") && i + 1 < argc)    opt.page = unsigned(std::atoi(argv[++i]));
+    else args.push_back(argv[i]);
+  }
+  if (args.empty())
+    return usage();
+  if (args[0] == "selftest")
+    return selftest(opt);
+  if (opt.port.empty())
+    return usage();
+
+  estufa::LinkPort port;
+  std::string error;
+  if (!port.open(opt.port, opt.baud, error)) {
+    std::fprintf(stderr, "estufalink: %s\n", error.c_str());
+    return 2;
+  }
+  if (args[0] == "telemetry")
+    return telemetry(port, opt.records);
+  if (args[0] == "interval" && args.size() == 2) {
+    const long want = std::strtol(args[1].c_str(), nullptr, 10);
+    if (want < 0 || want > 65535)
+      return usage();
+    estufa::LinkClient link(port, opt.baud);
+    const int ms = link.telemetry_interval(uint16_t(want));
+    if (ms < 0) {
+      std::fprintf(stderr, "estufalink: no answer, or no telemetry stream on the device\n");
+      return 1;
+    }
+    std::printf("telemetry interval %d ms\n", ms);
+    return 0;
+  }
+  if (args[0] == "dump")
+    return dump(port, opt);
+  return usage();
+}
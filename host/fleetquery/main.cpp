@@ -0,0 +1,344 @@
+/**
+ * @brief fleetquery - light-hours and duty cycle of one relay channel
+ *
+ *
+ * @notes:
+ * - fleetquery <store> <device> <channel> <from_ms> <to_ms> [kernel]
+ * - fleetquery bench [rows] [devices]   SIMD kernels vs scalar baseline
+ * - fleetquery selftest                 every kernel against a naive walk
+ *   of the raw rows, repeated states included, on a store in /tmp
+ *
+ * kernel = auto | scalar | sse4.2 | avx2
+ *
+ */
+#include <FleetQuery.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace fleet;
+
+namespace
+{
+
+Kernel parse_kernel(const char *name)
+{
+  if (!std::strcmp(name, "scalar")) return Kernel::Scalar;
+  if (!std::strcmp(name, "sse4.2")) return Kernel::Sse42;
+  if (!std::strcmp(name, "avx2"))   return Kernel::Avx2;
+  return Kernel::Auto;
+}
+
+int cmd_query(char **argv, int argc)
+{
+  StoreReader store(argv[1]);
+  ChannelQuery q;
+  q.device  = uint16_t(std::strtoul(argv[2], nullptr, 10));
+  q.channel = uint8_t(std::strtoul(argv[3], nullptr, 10));
+  q.from_ms = std::strtoll(argv[4], nullptr, 10);
+  q.to_ms   = std::strtoll(argv[5], nullptr, 10);
+  Kernel k  = argc > 6 ? parse_kernel(argv[6]) : Kernel::Auto;
+
+  ChannelStats r = query_channel(store, q, k);
+  std::printf("device %u channel %u [%" PRId64 ", %" PRId64 ")\n",
+              q.device, q.channel, q.from_ms, q.to_ms);
+  std::printf("on-time:  %.3f h (%" PRId64 " ms)\n", r.on_ms / 3600000.0, r.on_ms);
+  std::printf("switches: %" PRIu64 "\n", r.switches);
+  std::printf("duty:     %.2f %%\n", 100.0 * r.duty_cycle(q));
+  return 0;
+}
+
+
+/**
+ * @brief Synthetic fleet log kept in RAM, shaped like a mapped segment
+ *
+ * Every device toggles each channel on an 18h/6h pattern with a random
+ * phase, rows are interleaved by time as a gateway would ingest them.
+ *
+ */
+struct SyntheticLog
+{
+  std::vector<int64_t>  ts;
+  std::vector<uint16_t> device;
+  std::vector<uint8_t>  channel;
+  std::vector<uint8_t>  state;
+  std::vector<int32_t>  value;
+
+  SyntheticLog(size_t rows, unsigned devices)
+  {
+    const unsigned CHANNELS = 4;
+    const size_t streams = size_t(devices) * CHANNELS;
+    std::vector<int64_t> next(streams);
+    std::vector<uint8_t> on(streams);
+    uint32_t seed = 1;
+    for (size_t k = 0; k < streams; k++) {
+      seed = seed * 1664525u + 1013904223u;
+      next[k] = (seed >> 8) % (24 * 3600000LL);
+      on[k] = seed & 1;
+    }
+    ts.resize(rows); device.resize(rows); channel.resize(rows);
+    state.resize(rows); value.resize(rows);
+    for (size_t i = 0; i < rows; i++) {
+      size_t k = i % streams;
+      on[k] ^= 1;
+      ts[i]      = next[k];
+      device[i]  = uint16_t(k / CHANNELS);
+      channel[i] = uint8_t(k % CHANNELS);
+      state[i]   = on[k];
+      value[i]   = on[k];
+      next[k] += on[k] ? 18 * 3600000LL : 6 * 3600000LL;
+    }
+  }
+
+  SegmentView view() const
+  {
+    SegmentView v;
+    v.rows = ts.size();
+    v.min_ts = 0;
+    v.max_ts = INT64_MAX;
+    v.ts = ts.data(); v.device = device.data(); v.channel = channel.data();
+    v.state = state.data(); v.value = value.data();
+    return v;
+  }
+};
+
+int cmd_bench(size_t rows, unsigned devices)
+{
+  SyntheticLog log(rows, devices);
+  SegmentView v = log.view();
+
+  const int QUERIES = 16;
+  ChannelQuery qs[QUERIES];
+  for (int i = 0; i < QUERIES; i++) {
+    qs[i].device  = uint16_t((i * 37) % devices);
+    qs[i].channel = uint8_t(i % 4);
+    qs[i].from_ms = (i + 1) * 30LL * 24 * 3600000;
+    qs[i].to_ms   = qs[i].from_ms + 30LL * 24 * 3600000;
+  }
+
+  std::printf("%zu rows, %u devices, %d queries of 30 days\n", rows, devices, QUERIES);
+  const Kernel kernels[] = {Kernel::Scalar, Kernel::Sse42, Kernel::Avx2};
+  const Kernel best = best_kernel();
+  ScanPartial ref[QUERIES];
+  double t_scalar = 0;
+  bool mismatch = false;
+  for (Kernel k : kernels) {
+    if (k == Kernel::Avx2 && best != Kernel::Avx2)
+      continue;
+    if (k == Kernel::Sse42 && best == Kernel::Scalar)
+      continue;
+    auto t0 = std::chrono::steady_clock::now();
+    bool same = true;
+    for (int i = 0; i < QUERIES; i++) {
+      ScanPartial p = scan_columns(k, v, 0, v.rows, qs[i]);
+      if (k == Kernel::Scalar)
+        ref[i] = p;
+      else
+        same = same && p.signed_ts == ref[i].signed_ts && p.switches == ref[i].switches &&
+               p.last_before == ref[i].last_before && p.last_inside == ref[i].last_inside;
+    }
+    double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (k == Kernel::Scalar)
+      t_scalar = dt;
+    double rate = double(rows) * QUERIES / dt / 1e6;
+    std::printf("%-7s %8.1f Mrows/s  x%.2f%s\n", kernel_name(k), rate,
+                t_scalar / dt, same ? "" : "  MISMATCH");
+    mismatch = mismatch || !same;
+  }
+  return mismatch ? 1 : 0;
+}
+
+
+/**
+ * @brief Kernels against a naive interval walk
+ *
+ * Raw rows, with repeated states, go through TransitionFilter into a
+ * store of small segments, as fleetstore ingest would put them. The
+ * reference walks each channel's raw rows in time order: the state
+ * holds from one row to the next, a switch is a row that changes it.
+ *
+ */
+unsigned failures = 0;
+
+void expect(bool cond, const char *what)
+{
+  std::printf("%s %s\n", cond ? "ok  " : "FAIL", what);
+  failures += !cond;
+}
+
+struct RawRow
+{
+  int64_t ts;
+  uint8_t state;
+};
+
+ChannelStats naive_walk(const std::vector<RawRow> &rows, int64_t from, int64_t to)
+{
+  ChannelStats r = {0, 0, false, false};
+  bool on = false;
+  int64_t since = from;
+  for (const RawRow &row : rows) {
+    if (row.ts < from) {
+      on = row.state;
+      continue;
+    }
+    if (row.ts >= to)
+      break;
+    if (row.state != on) {
+      if (on)
+        r.on_ms += row.ts - since;
+      on = row.state;
+      since = row.ts;
+      r.switches++;
+    }
+  }
+  if (on)
+    r.on_ms += to - since;
+  return r;
+}
+
+std::vector<Kernel> kernels_here()
+{
+  std::vector<Kernel> ks = {Kernel::Scalar};
+  if (best_kernel() != Kernel::Scalar)
+    ks.push_back(Kernel::Sse42);
+  if (best_kernel() == Kernel::Avx2)
+    ks.push_back(Kernel::Avx2);
+  return ks;
+}
+
+int cmd_selftest()
+{
+  char dir[] = "/tmp/fleetquery-XXXXXX";
+  if (!mkdtemp(dir)) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+
+  // The review case: a repeated ON must not shorten the on-time
+  {
+    const std::string store = std::string(dir) + "/repeat";
+    TransitionFilter f;
+    {
+      StoreWriter w(store);
+      const EventRow rows[] = {{10, 1, 0, 1, 0}, {20, 1, 0, 1, 0}, {50, 1, 0, 0, 0}};
+      for (const EventRow &row : rows)
+        if (f.accept(row))
+          w.append(row);
+      w.commit();
+    }
+    StoreReader r(store);
+    const ChannelQuery q = {1, 0, 0, 100};
+    for (Kernel k : kernels_here()) {
+      const ChannelStats st = query_channel(r, q, k);
+      char what[96];
+      std::snprintf(what, sizeof what, "%s: ON@10 ON@20 OFF@50 in [0,100) is 40 ms on, 2 switches",
+                    kernel_name(k));
+      expect(st.on_ms == 40 && st.switches == 2, what);
+    }
+    expect(f.repeated() == 1, "filter: the repeated ON counted");
+    EventRow old = {5, 1, 0, 1, 0};
+    expect(!f.accept(old) && f.out_of_order() == 1, "filter: a row older than the channel's newest refused");
+  }
+
+  // Random fleet: 8 devices x 4 channels, states drawn at random so about
+  // half the rows repeat, rows of all channels interleaved by time
+  const std::string store = std::string(dir) + "/fleet";
+  const unsigned DEVICES = 8, CHANNELS = 4, ROWS = 40000;
+  std::vector<std::vector<RawRow>> raw(DEVICES * CHANNELS);
+  std::mt19937 rng(52);
+  {
+    TransitionFilter f;
+    StoreWriter w(store, 4096);
+    int64_t ts = 0;
+    for (unsigned i = 0; i < ROWS; i++) {
+      ts += 1 + rng() % 50;
+      const unsigned k = rng() % raw.size();
+      const EventRow row = {ts, uint16_t(k / CHANNELS), uint8_t(k % CHANNELS), uint8_t(rng() & 1),
+                            int32_t(i)};
+      raw[k].push_back({row.ts_ms, row.state});
+      if (f.accept(row))
+        w.append(row);
+    }
+    w.commit();
+    char what[96];
+    std::snprintf(what, sizeof what, "fleet: %u raw rows, %" PRIu64 " repeats dropped at ingest", ROWS,
+                  f.repeated());
+    expect(f.repeated() > ROWS / 4 && f.out_of_order() == 0, what);
+  }
+
+  StoreReader r(store);
+  const int64_t span = int64_t(ROWS) * 25;   // About the last timestamp
+  for (Kernel k : kernels_here()) {
+    unsigned wrong = 0;
+    for (unsigned t = 0; t < 2000; t++) {
+      const unsigned c = rng() % raw.size();
+      ChannelQuery q;
+      q.device  = uint16_t(c / CHANNELS);
+      q.channel = uint8_t(c % CHANNELS);
+      q.from_ms = int64_t(rng() % uint64_t(span)) - 100;
+      q.to_ms   = q.from_ms + 1 + int64_t(rng() % uint64_t(span / 4));
+      const ChannelStats got = query_channel(r, q, k);
+      const ChannelStats want = naive_walk(raw[c], q.from_ms, q.to_ms);
+      wrong += got.on_ms != want.on_ms || got.switches != want.switches;
+    }
+    char what[96];
+    std::snprintf(what, sizeof what, "%s: 2000 random windows match the naive walk", kernel_name(k));
+    expect(!wrong, what);
+  }
+
+  for (const char *name : {"repeat", "fleet"}) {
+    const std::string sub = std::string(dir) + "/" + name;
+    for (unsigned i = 0; ::unlink(segment_path(sub, i).c_str()) == 0; i++) {
+    }
+    ::rmdir(sub.c_str());
+  }
+  ::rmdir(dir);
+
+  std::printf("%s: %u failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 1 : 0;
+}
+
+void usage()
+{
+  std::fprintf(stderr,
+    "usage: fleetquery <store> <device> <channel> <from_ms> <to_ms> [kernel]\n"
+    "       fleetquery bench [rows] [devices]\n"
+    "       fleetquery selftest\n");
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  try {
+    if (argc == 2 && !std::strcmp(argv[1], "selftest"))
+      return cmd_selftest();
+    if (argc >= 2 && !std::strcmp(argv[1], "bench")) {
+      const size_t rows = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 50000000ULL;
+      const unsigned long devices = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1000u;
+      if (devices == 0 || devices > 65536) {
+        std::fprintf(stderr, "fleetquery: devices must be 1..65536\n");
+        return 2;
+      }
+      return cmd_bench(rows, unsigned(devices));
+    }
+    if (argc >= 6)
+      return cmd_query(argv, argc);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "fleetquery: %s\n", e.what());
+    return 1;
+  }
+  usage();
+  return 2;
+}
@@ -0,0 +1,210 @@
+/**
+ * @brief fleetsim - simulate a fleet of ESTUFA controllers on the host
+ *
+ *
+ * @notes:
+ * - Every controller runs the same LightSchedule engine as the firmware
+ * (lib/LightSchedule), one instance per relay channel, ticked once per
+ * virtual hour exactly like the Timer1 ISR does.
+ *
+ * - Controllers are simulated in chunks on a work-stealing pool. Each
+ * chunk records its transitions into its own trace buffer, so workers
+ * never share writable state; traces are aggregated after the run.
+ *
+ * - fleetsim [options]
+ *   --devices N   controllers to simulate         (default 10000)
+ *   --days D      virtual days                    (default 180)
+ *   --threads T   highest thread count to measure (default: all cores)
+ *   --chunk C     controllers per task            (default 64)
+ *   --store DIR   also write the transitions into a FleetStore
+ *
+ */
+#include <FleetStore.h>
+#include <LightSchedule.h>
+#include <WorkPool.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const int64_t HOUR_MS = 3600000;
+const unsigned MAX_CHANNELS = 4;   // Relays on one SerialRelay module
+
+struct Options
+{
+  unsigned    devices = 10000;
+  unsigned    days    = 180;
+  unsigned    threads = std::thread::hardware_concurrency();
+  unsigned    chunk   = 64;
+  std::string store;
+};
+
+// Per-controller configuration, derived from the address so runs are repeatable
+struct DeviceConfig
+{
+  uint8_t channels;
+  uint8_t light_hours[MAX_CHANNELS];
+  uint8_t dark_hours[MAX_CHANNELS];
+  bool    start_on[MAX_CHANNELS];
+};
+
+DeviceConfig device_config(unsigned device)
+{
+  static const uint8_t LIGHT[] = {18, 18, 18, 16, 12, 20};
+  uint32_t h = device * 2654435761u;
+  DeviceConfig c;
+  c.channels = uint8_t(1 + (h >> 28) % MAX_CHANNELS);
+  for (unsigned ch = 0; ch < MAX_CHANNELS; ch++) {
+    h = h * 1664525u + 1013904223u;
+    c.light_hours[ch] = LIGHT[(h >> 24) % sizeof(LIGHT)];
+    c.dark_hours[ch]  = uint8_t(24 - c.light_hours[ch]);
+    c.start_on[ch]    = (h >> 16) & 1;
+  }
+  return c;
+}
+
+struct ChunkResult
+{
+  std::vector<fleet::EventRow> trace;
+  uint64_t on_hours = 0;
+};
+
+void simulate_chunk(unsigned first, unsigned last, unsigned hours, ChunkResult &out)
+{
+  out.trace.clear();
+  out.on_hours = 0;
+  for (unsigned dev = first; dev < last; dev++) {
+    DeviceConfig cfg = device_config(dev);
+    for (unsigned ch = 0; ch < cfg.channels; ch++) {
+      LightSchedule s(cfg.light_hours[ch], cfg.dark_hours[ch], cfg.start_on[ch]);
+      for (unsigned hour = 1; hour <= hours; hour++) {
+        out.on_hours += s.is_on();
+        if (s.tick()) {
+          fleet::EventRow row;
+          row.ts_ms   = int64_t(hour) * HOUR_MS;
+          row.device  = uint16_t(dev);
+          row.channel = uint8_t(ch);
+          row.state   = s.is_on();
+          row.value   = s.is_on() ? 1 : 0;  // Relay frame bit of the channel
+          out.trace.push_back(row);
+        }
+      }
+    }
+  }
+}
+
+struct RunStats
+{
+  double   seconds;
+  uint64_t transitions;
+  uint64_t on_hours;
+  uint64_t steals;
+};
+
+RunStats run(const Options &opt, unsigned threads, std::vector<ChunkResult> &results)
+{
+  const unsigned chunks = (opt.devices + opt.chunk - 1) / opt.chunk;
+  const unsigned hours = opt.days * 24;
+  results.assign(chunks, ChunkResult());
+
+  WorkPool pool(threads);
+  auto t0 = std::chrono::steady_clock::now();
+  for (unsigned c = 0; c < chunks; c++) {
+    unsigned first = c * opt.chunk;
+    unsigned last = first + opt.chunk < opt.devices ? first + opt.chunk : opt.devices;
+    pool.submit([first, last, hours, c, &results] {
+      simulate_chunk(first, last, hours, results[c]);
+    });
+  }
+  pool.wait();
+  RunStats r;
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  r.transitions = 0;
+  r.on_hours = 0;
+  for (const ChunkResult &c : results) {
+    r.transitions += c.trace.size();
+    r.on_hours += c.on_hours;
+  }
+  r.steals = pool.steals();
+  return r;
+}
+
+bool parse_options(int argc, char **argv, Options &opt)
+{
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    if (i + 1 >= argc)
+      return false;
+    const char *v = argv[++i];
+    if (!std::strcmp(a, "--devices"))      opt.devices = unsigned(std::strtoul(v, nullptr, 10));
+    else if (!std::strcmp(a, "--days"))    opt.days    = unsigned(std::strtoul(v, nullptr, 10));
+    else if (!std::strcmp(a, "--threads")) opt.threads = unsigned(std::strtoul(v, nullptr, 10));
+    else if (!std::strcmp(a, "--chunk"))   opt.chunk   = unsigned(std::strtoul(v, nullptr, 10));
+    else if (!std::strcmp(a, "--store"))   opt.store   = v;
+    else return false;
+  }
+  if (opt.threads == 0) opt.threads = 1;
+  if (opt.chunk == 0)   opt.chunk = 1;
+  return opt.devices > 0 && opt.devices <= 65536;
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  if (!parse_options(argc, argv, opt)) {
+    std::fprintf(stderr, "usage: fleetsim [--devices N] [--days D] [--threads T] "
+                         "[--chunk C] [--store DIR]\n");
+    return 2;
+  }
+
+  std::printf("%u controllers, %u days, chunk %u\n", opt.devices, opt.days, opt.chunk);
+  std::printf("threads  seconds  speedup  efficiency  steals  transitions\n");
+
+  std::vector<ChunkResult> results;
+  double t1 = 0;
+  uint64_t ref_transitions = 0, ref_on = 0;
+  std::vector<unsigned> counts;
+  for (unsigned t = 1; t < opt.threads; t *= 2)
+    counts.push_back(t);
+  counts.push_back(opt.threads);
+
+  for (unsigned t : counts) {
+    RunStats r = run(opt, t, results);
+    if (t == 1) {
+      t1 = r.seconds;
+      ref_transitions = r.transitions;
+      ref_on = r.on_hours;
+    }
+    bool same = r.transitions == ref_transitions && r.on_hours == ref_on;
+    std::printf("%7u  %7.3f  %7.2f  %9.1f%%  %6" PRIu64 "  %11" PRIu64 "%s\n",
+                t, r.seconds, t1 / r.seconds, 100.0 * t1 / (r.seconds * t),
+                r.steals, r.transitions, same ? "" : "  MISMATCH");
+  }
+  std::printf("on-hours total: %" PRIu64 "\n", ref_on);
+
+  if (!opt.store.empty()) {
+    try {
+      fleet::StoreWriter w(opt.store);
+      for (const ChunkResult &c : results)
+        w.append(c.trace.data(), c.trace.size());
+      w.commit();
+      std::printf("wrote %" PRIu64 " rows to %s\n", ref_transitions, opt.store.c_str());
+    } catch (const std::exception &e) {
+      std::fprintf(stderr, "fleetsim: %s\n", e.what());
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,277 @@
+/**
+ * @brief fleetstore - ingest and inspect controller event history
+ *
+ *
+ * @notes:
+ * - fleetstore ingest <store> [log...]   append decoded device logs
+ *   (stdin when no file is given); only transitions are kept
+ *   (TransitionFilter), the rest is counted on stderr
+ * - fleetstore stat <store>              rows, segments, time range
+ * - fleetstore bench <store> [rows]      synthetic ingest + scan rate
+ * - fleetstore selftest                  log row parser: good rows, and
+ *   rows that must be counted bad (fields out of range, junk, overflow).
+ *   Meant to run under -fsanitize=undefined as well: [env:fleetstore_ubsan]
+ *
+ */
+#include <FleetStore.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using fleet::EventRow;
+
+namespace
+{
+
+double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+uint64_t bad_rows = 0;
+fleet::TransitionFilter transitions;
+
+// Parse a whole buffer in batches so the writer copies column-wise
+uint64_t ingest_buffer(fleet::StoreWriter &w, const char *p, const char *end)
+{
+  const size_t BATCH = 4096;
+  std::vector<EventRow> batch;
+  batch.reserve(BATCH);
+  uint64_t n = 0;
+  while (p < end) {
+    EventRow row;
+    bool ok, bad;
+    p = fleet::parse_log_line(p, end, row, ok, &bad);
+    bad_rows += bad;
+    if (!ok || !transitions.accept(row))
+      continue;
+    batch.push_back(row);
+    if (batch.size() == BATCH) {
+      w.append(batch.data(), batch.size());
+      n += batch.size();
+      batch.clear();
+    }
+  }
+  w.append(batch.data(), batch.size());
+  n += batch.size();
+  return n;
+}
+
+uint64_t ingest_file(fleet::StoreWriter &w, const char *path)
+{
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    std::perror(path);
+    return 0;
+  }
+  struct stat st;
+  ::fstat(fd, &st);
+  if (st.st_size == 0) {
+    ::close(fd);
+    return 0;
+  }
+  void *addr = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    std::perror(path);
+    return 0;
+  }
+  ::madvise(addr, size_t(st.st_size), MADV_SEQUENTIAL);
+  const char *p = static_cast<const char *>(addr);
+  uint64_t n = ingest_buffer(w, p, p + st.st_size);
+  ::munmap(addr, size_t(st.st_size));
+  return n;
+}
+
+uint64_t ingest_stdin(fleet::StoreWriter &w)
+{
+  std::string buf;
+  char chunk[1 << 16];
+  size_t got;
+  while ((got = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+    buf.append(chunk, got);
+  return ingest_buffer(w, buf.data(), buf.data() + buf.size());
+}
+
+int cmd_ingest(int argc, char **argv)
+{
+  transitions.seed(fleet::StoreReader(argv[2]));
+  fleet::StoreWriter w(argv[2]);
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t n = 0;
+  if (argc == 3)
+    n = ingest_stdin(w);
+  for (int i = 3; i < argc; i++)
+    n += ingest_file(w, argv[i]);
+  w.commit();
+  double dt = seconds_since(t0);
+  std::printf("ingested %" PRIu64 " rows in %.3f s (%.2f Mrows/s), store has %" PRIu64 "\n",
+              n, dt, dt > 0 ? n / dt / 1e6 : 0.0, w.total_rows());
+  if (bad_rows)
+    std::fprintf(stderr, "fleetstore: %" PRIu64 " bad row(s) skipped\n", bad_rows);
+  if (transitions.repeated() || transitions.out_of_order())
+    std::fprintf(stderr, "fleetstore: %" PRIu64 " row(s) repeating their channel's state and %" PRIu64
+                 " older than its newest row skipped\n", transitions.repeated(), transitions.out_of_order());
+  return 0;
+}
+
+int cmd_stat(const char *dir)
+{
+  fleet::StoreReader r(dir);
+  int64_t lo = INT64_MAX, hi = INT64_MIN;
+  for (const auto &s : r.segments()) {
+    if (s.rows == 0)
+      continue;
+    if (s.min_ts < lo) lo = s.min_ts;
+    if (s.max_ts > hi) hi = s.max_ts;
+  }
+  std::printf("segments: %zu\nrows: %" PRIu64 "\n", r.segments().size(), r.total_rows());
+  if (r.total_rows())
+    std::printf("ts range: %" PRId64 " .. %" PRId64 " ms\n", lo, hi);
+  return 0;
+}
+
+int cmd_bench(const char *dir, uint64_t rows)
+{
+  // Synthetic fleet: 1000 controllers x 4 channels toggling every ~hour
+  const unsigned DEVICES = 1000;
+  std::vector<EventRow> batch(1 << 14);
+  auto t0 = std::chrono::steady_clock::now();
+  {
+    fleet::StoreWriter w(dir);
+    uint64_t done = 0;
+    uint32_t seed = 12345;
+    while (done < rows) {
+      size_t n = batch.size();
+      if (n > rows - done)
+        n = size_t(rows - done);
+      for (size_t i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        uint64_t k = done + i;
+        batch[i].ts_ms   = int64_t(k / DEVICES) * 3600000 + (seed >> 12) % 1000;
+        batch[i].device  = uint16_t(k % DEVICES);
+        batch[i].channel = uint8_t(seed >> 30);
+        batch[i].state   = uint8_t((k / DEVICES) & 1);
+        batch[i].value   = int32_t(seed & 0xff);
+      }
+      w.append(batch.data(), n);
+      done += n;
+    }
+    w.commit();
+  }
+  double t_write = seconds_since(t0);
+
+  t0 = std::chrono::steady_clock::now();
+  fleet::StoreReader r(dir);
+  uint64_t on = 0, sum = 0, scanned = 0;
+  for (const auto &s : r.segments()) {
+    for (size_t i = 0; i < s.rows; i++) {
+      on  += s.state[i];
+      sum += uint64_t(s.ts[i]) ^ s.device[i];
+    }
+    scanned += s.rows;
+  }
+  double t_scan = seconds_since(t0);
+
+  std::printf("write: %" PRIu64 " rows in %.3f s (%.2f Mrows/s)\n",
+              rows, t_write, rows / t_write / 1e6);
+  std::printf("scan:  %" PRIu64 " rows in %.3f s (%.2f Mrows/s) [on=%" PRIu64 " chk=%" PRIx64 "]\n",
+              scanned, t_scan, scanned / t_scan / 1e6, on, sum);
+  return 0;
+}
+
+struct ParseCase
+{
+  const char *line;
+  bool ok, bad;
+  EventRow row;
+};
+
+int cmd_selftest()
+{
+  const ParseCase cases[] = {
+    {"100 7 3 1 42",                          true,  false, {100, 7, 3, 1, 42}},
+    {"  -5\t65535 255 0 -2147483648\r",      true,  false, {-5, 65535, 255, 0, INT32_MIN}},
+    {"9223372036854775807 0 0 1 2147483647 ", true,  false, {INT64_MAX, 0, 0, 1, INT32_MAX}},
+    {"# banner",                              false, false, {}},
+    {"   ",                                   false, false, {}},
+    {"100 70000 300 1 5000000000",            false, true,  {}},
+    {"100 65536 0 1 0",                       false, true,  {}},
+    {"100 -1 0 1 0",                          false, true,  {}},
+    {"100 1 256 1 0",                         false, true,  {}},
+    {"100 1 -1 1 0",                          false, true,  {}},
+    {"100 1 0 2 0",                           false, true,  {}},
+    {"100 1 0 -1 0",                          false, true,  {}},
+    {"100 1 0 1 2147483648",                  false, true,  {}},
+    {"100 1 0 1 -2147483649",                 false, true,  {}},
+    {"100 1 0 1 0 junk",                      false, true,  {}},
+    {"100 1 0 1 0 7",                         false, true,  {}},
+    {"100 1 0 1 0x",                          false, true,  {}},
+    {"100 1 0 1-0 5",                         false, true,  {}},
+    {"100 1 0 1",                             false, true,  {}},
+    {"9223372036854775808 1 0 1 0",           false, true,  {}},
+    {"12345678901234567890123 1 0 1 0",       false, true,  {}},
+  };
+
+  unsigned failures = 0;
+  for (const ParseCase &c : cases) {
+    const std::string text = std::string(c.line) + "\n";
+    EventRow row = {};
+    bool ok, bad;
+    const char *end = fleet::parse_log_line(text.data(), text.data() + text.size(), row, ok, &bad);
+    bool pass = ok == c.ok && bad == c.bad && end == text.data() + text.size();
+    if (pass && ok)
+      pass = row.ts_ms == c.row.ts_ms && row.device == c.row.device && row.channel == c.row.channel &&
+             row.state == c.row.state && row.value == c.row.value;
+    std::printf("%s \"%s\" -> %s\n", pass ? "ok  " : "FAIL", c.line, ok ? "row" : bad ? "bad" : "skipped");
+    failures += !pass;
+  }
+  std::printf("%s: %u failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 1 : 0;
+}
+
+void usage()
+{
+  std::fprintf(stderr,
+    "usage: fleetstore ingest <store> [log...]\n"
+    "       fleetstore stat <store>\n"
+    "       fleetstore bench <store> [rows]\n"
+    "       fleetstore selftest\n");
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  if (argc == 2 && !std::strcmp(argv[1], "selftest"))
+    return cmd_selftest();
+  if (argc < 3) {
+    usage();
+    return 2;
+  }
+  try {
+    if (!std::strcmp(argv[1], "ingest"))
+      return cmd_ingest(argc, argv);
+    if (!std::strcmp(argv[1], "stat"))
+      return cmd_stat(argv[2]);
+    if (!std::strcmp(argv[1], "bench"))
+      return cmd_bench(argv[2], argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20000000ULL);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "fleetstore: %s\n", e.what());
+    return 1;
+  }
+  usage();
+  return 2;
+}
@@ -0,0 +1,241 @@
+/**
+ * @brief isrcheck - host check of the ISR-safe primitives in lib/IsrSafe
+ *
+ *
+ * @notes:
+ * - On the host IsrAtomic.h maps to the __atomic builtins, so a second
+ * thread stands in for the ISR: it runs concurrently with the main
+ * thread, which is a harder schedule than an ISR that runs to completion.
+ *
+ * - Checked:
+ *   - SpscRing: full/empty at the capacity with no spare slot, head/tail
+ *     wrapping past 255, and a producer thread pushing a counter that a
+ *     consumer thread must pop in order, none lost or repeated;
+ *   - SeqLock: a writer thread publishing records whose words all carry
+ *     the same count, a reader that must never see a mix of two writes,
+ *     with its retries counted;
+ *   - FlagSet: set, test, clear and take across a byte boundary.
+ *
+ * - isrcheck [--items N] [--writes W]
+ *   N values through the ring (default 1000000), W seqlock writes
+ *   (default 5000; the writer yields often, so this is the slow part on
+ *   a single CPU)
+ *
+ */
+#include <FlagSet.h>
+#include <SeqLock.h>
+#include <SpscRing.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+unsigned failures = 0;
+
+void expect(bool cond, const char *what)
+{
+  std::printf("%s %s\n", cond ? "ok  " : "FAIL", what);
+  failures += !cond;
+}
+
+void check_ring_bounds()
+{
+  SpscRing<uint16_t, 128> ring;
+  uint16_t v = 0;
+
+  expect(ring.empty() && ring.size() == 0 && ring.space() == 128 && !ring.pop(v) && !ring.peek(),
+         "ring: starts empty, pop and peek fail");
+
+  bool all = true;
+  for (uint16_t i = 0; i < 128; ++i)
+    all &= ring.push(i);
+  expect(all && ring.size() == 128 && ring.space() == 0 && !ring.push(999),
+         "ring: holds exactly 128 at capacity 128, the 129th push fails");
+
+  bool order = true;
+  for (uint16_t i = 0; i < 128; ++i)
+    order &= ring.pop(v) && v == i;
+  expect(order && ring.empty() && !ring.pop(v), "ring: drains in order, then empty");
+
+  // 1000 rounds of 100 move head_/tail_ around the uint8_t range many times,
+  // with the ring partly full at every wrap
+  bool wrap = true;
+  uint16_t next_in = 0, next_out = 0;
+  for (int round = 0; round < 1000 && wrap; ++round)
+  {
+    for (int i = 0; i < 100; ++i)
+      wrap &= ring.push(next_in++);
+    wrap &= ring.size() == 100 && ring.peek() && *ring.peek() == next_out;
+    for (int i = 0; i < 100; ++i)
+      wrap &= ring.pop(v) && v == next_out++;
+    wrap &= ring.empty();
+  }
+  expect(wrap, "ring: 100000 values through the wrap of head/tail, in order");
+
+  SpscRing<uint8_t, 2> tiny;
+  uint8_t b = 0;
+  bool small = true;
+  for (int i = 0; i < 600 && small; ++i)
+  {
+    small &= tiny.push(uint8_t(i)) && tiny.push(uint8_t(i + 1)) && !tiny.push(0);
+    small &= tiny.pop(b) && b == uint8_t(i) && tiny.pop(b) && b == uint8_t(i + 1) && !tiny.pop(b);
+  }
+  expect(small, "ring: capacity 2 full/empty through the wrap");
+}
+
+void check_ring_threads(unsigned items)
+{
+  static SpscRing<uint32_t, 16> ring;
+  unsigned full = 0;
+
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < items;)
+    {
+      if (ring.push(i))
+        ++i;
+      else
+      {
+        ++full;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expected = 0, v = 0;
+  bool order = true;
+  while (expected < items)
+  {
+    if (!ring.pop(v))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    if (v != expected)
+    {
+      order = false;
+      break;
+    }
+    ++expected;
+  }
+  producer.join();
+
+  char what[96];
+  std::snprintf(what, sizeof what, "ring: %u values producer thread -> consumer thread, in order (%u full)",
+                items, full);
+  expect(order && expected == items && ring.empty(), what);
+}
+
+struct Record
+{
+  uint32_t word[16];
+};
+
+void check_seqlock_threads(unsigned writes)
+{
+  static SeqLock<Record> lock;
+  std::atomic<bool> done(false);
+
+  // The writer yields every 4th write: on a single CPU a reader preempted
+  // mid-copy could otherwise see 128 writes go by and be fooled by the
+  // 8-bit sequence, a case SeqLock.h rules out for ISR writers. The reader
+  // spins, so it runs while the writer is preempted halfway through
+  std::thread writer([&] {
+    Record r;
+    for (uint32_t n = 1; n <= writes; ++n)
+    {
+      for (uint32_t &w : r.word)
+        w = n;
+      lock.write(r);
+      if ((n & 3) == 0)
+        std::this_thread::yield();
+    }
+    done.store(true);
+  });
+
+  unsigned long long reads = 0, retries = 0, torn = 0, backwards = 0;
+  uint32_t last = 0;
+  while (!done.load())
+  {
+    Record r;
+    if (!lock.try_read(r))
+    {
+      ++retries;
+      continue;
+    }
+    ++reads;
+    for (uint32_t w : r.word)
+      torn += w != r.word[0];
+    backwards += r.word[0] < last;
+    last = r.word[0];
+  }
+  writer.join();
+
+  const Record final = lock.read();
+  char what[128];
+  std::snprintf(what, sizeof what, "seqlock: %llu reads against %u writes, none torn or going back", reads, writes);
+  expect(reads > 0 && torn == 0 && backwards == 0, what);
+  std::snprintf(what, sizeof what, "seqlock: reader retried while a write was in progress (%llu retries)", retries);
+  expect(retries > 0, what);
+  expect(final.word[0] == writes && final.word[15] == writes && lock.sequence() == uint8_t(2 * writes),
+         "seqlock: last write read back, sequence even");
+}
+
+void check_flags()
+{
+  FlagSet<12> f;
+
+  expect(!f.any() && !f.test(0) && !f.test(11), "flags: start clear");
+
+  f.set(3);
+  f.set(9);
+  expect(f.any() && f.test(3) && f.test(9) && !f.test(2) && !f.test(8) && !f.test(11),
+         "flags: set 3 and 9, only those test true");
+
+  f.clear(3);
+  expect(!f.test(3) && f.test(9) && f.any(), "flags: clear 3 leaves 9");
+
+  expect(f.take(9) && !f.test(9) && !f.take(9) && !f.any(), "flags: take 9 once, then clear");
+
+  for (uint8_t i = 0; i < 12; ++i)
+    f.set(i);
+  bool each = true;
+  for (uint8_t i = 0; i < 12; ++i)
+    each &= f.take(i);
+  expect(each && !f.any(), "flags: all 12 across two bytes set and taken");
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned items = 1000000, writes = 5000;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!std::strcmp(argv[i], "--items") && i + 1 < argc)
+      items = unsigned(std::strtoul(argv[++i], nullptr, 10));
+    else if (!std::strcmp(argv[i], "--writes") && i + 1 < argc)
+      writes = unsigned(std::strtoul(argv[++i], nullptr, 10));
+    else
+    {
+      std::fprintf(stderr, "usage: isrcheck [--items N] [--writes W]\n");
+      return 2;
+    }
+  }
+  if (items == 0 || writes == 0)
+  {
+    std::fprintf(stderr, "isrcheck: --items and --writes must be > 0\n");
+    return 2;
+  }
+
+  check_ring_bounds();
+  check_ring_threads(items);
+  check_seqlock_threads(writes);
+  check_flags();
+
+  std::printf("%s: %u failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+#include "LinkClient.h"
+
+#include <LinkSession.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace estufa
+{
+
+namespace
+{
+
+void put32(std::vector<uint8_t> &v, uint32_t x)
+{
+  for (int i = 0; i < 4; i++)
+    v.push_back(uint8_t(x >> (8 * i)));
+}
+
+} // namespace
+
+
+bool LinkClient::send(const std::vector<uint8_t> &payload)
+{
+  uint8_t frame[LINK_FRAME_MAX + LINK_FRAME_OVERHEAD];
+  if (payload.size() > LINK_FRAME_MAX)
+    return false;
+  return port_.write(frame, link_frame(payload.data(), uint8_t(payload.size()), frame));
+}
+
+bool LinkClient::next_frame(Frame &f, int timeout_ms)
+{
+  const double deadline = steady_us() + timeout_ms * 1000.0;
+  for (;;) {
+    const uint8_t *data;
+    size_t len;
+    LinkReader::Kind kind;
+    while ((kind = reader_.next(data, len)) != LinkReader::NONE) {
+      if (kind == LinkReader::FRAME) {
+        f.data = data;
+        f.len = len;
+        return true;
+      }
+      if (text_)
+        text_(std::string(reinterpret_cast<const char *>(data), len));
+    }
+    const double left_us = deadline - steady_us();
+    if (left_us <= 0)
+      return false;
+    size_t room;
+    uint8_t *buf = reader_.space(512, room);
+    long n = port_.read(buf, room, int(left_us / 1000) + 1);
+    if (n < 0)
+      return false;
+    reader_.commit(size_t(n));
+    received_ += unsigned(n);
+  }
+}
+
+bool LinkClient::expect(uint8_t type, Frame &f, int timeout_ms)
+{
+  const double deadline = steady_us() + timeout_ms * 1000.0;
+  for (;;) {
+    const double left_ms = (deadline - steady_us()) / 1000;
+    if (left_ms <= 0 || !next_frame(f, int(left_ms) + 1))
+      return false;
+    if (f.len && f.data[0] == type)
+      return true;
+  }
+}
+
+bool LinkClient::ping(int timeout_ms)
+{
+  const uint8_t nonce = ++nonce_;
+  Frame reply;
+  if (!send({LINK_CMD_PROBE, nonce}))
+    return false;
+  const double deadline = steady_us() + timeout_ms * 1000.0;
+  while (expect(LINK_CMD_PROBE, reply, int((deadline - steady_us()) / 1000) + 1))
+    if (reply.len == 6 && reply.data[1] == nonce)
+      return true;
+  return false;
+}
+
+unsigned LinkClient::upgrade(unsigned baud)
+{
+  std::vector<uint8_t> cmd = {LINK_CMD_BAUD};
+  Frame reply;
+  put32(cmd, baud);
+  if (!send(cmd) || !expect(LINK_CMD_BAUD, reply, 500) || reply.len != 6 || link_get32(reply.data, 2) != baud)
+    return ping() ? port_.baud() : 0;
+  if (!reply.data[1])
+    return port_.baud();
+
+  // The device switches once its answer is out
+  port_.set_baud(baud);
+  for (int i = 0; i < 3; i++)
+    if (ping())
+      return baud;
+
+  // Not at that rate: back to the base rate, where the device falls back too
+  port_.set_baud(base_);
+  const double deadline = steady_us() + (LINK_PROBE_MS + 1000) * 1000.0;
+  while (steady_us() < deadline)
+    if (ping())
+      return base_;
+  return 0;
+}
+
+int LinkClient::telemetry_interval(uint16_t ms)
+{
+  Frame reply;
+  if (!send({LINK_CMD_INTERVAL, uint8_t(ms), uint8_t(ms >> 8)}) ||
+      !expect(LINK_CMD_INTERVAL, reply, 500) || reply.len != 4 || !reply.data[1])
+    return -1;
+  return reply.data[2] | reply.data[3] << 8;
+}
+
+DumpResult LinkClient::dump(uint32_t from, uint32_t limit, uint16_t page, int quiet_ms)
+{
+  DumpResult r;
+  const unsigned long before = received_;
+  const double t0 = steady_us();
+  uint32_t cursor = from, last_start = UINT32_MAX;
+  bool range = false;     // An empty page first, for the range in the log
+  unsigned failed = 0;
+  while (failed <= page_retries) {
+    const uint32_t left = limit - uint32_t(r.records.size());
+    const uint16_t want = !range ? 0 : left < page ? uint16_t(left) : page;
+    const uint8_t tag = ++nonce_;
+    std::vector<uint8_t> cmd = {LINK_CMD_PAGE, tag};
+    put32(cmd, cursor);
+    cmd.push_back(uint8_t(want));
+    cmd.push_back(uint8_t(want >> 8));
+    if (!send(cmd))
+      break;
+    r.pages += range;
+
+    const uint32_t start = cursor;
+    bool closed = false, ended = false;
+    double quiet = steady_us() + quiet_ms * 1000.0;
+    Frame f;
+    while (!closed && next_frame(f, std::max(1, int((quiet - steady_us()) / 1000)))) {
+      const uint8_t *p = f.data;
+      if (f.len >= 7 && p[0] == LINK_RECORDS && f.len == 7 + p[6] * sizeof(EventRecord)) {
+        // Only what follows on from the cursor: not past a lost chunk,
+        // nor again what an earlier page already brought
+        const uint32_t seq = link_get32(p, 2);
+        for (uint8_t i = 0; i < p[6] && r.records.size() < limit; i++)
+          if (seq + i == cursor) {
+            r.seq.push_back(cursor++);
+            r.records.push_back(event_record_unpack(p + 7 + i * sizeof(EventRecord)));
+          }
+        if (p[1] == tag) {
+          // All in, or a chunk of this page lost: ask for the next one
+          // now. Once per cursor: a gap there again may be records
+          // overwritten, which only 'N' tells
+          closed = cursor == start + want || (seq > cursor && start != last_start);
+          quiet = steady_us() + quiet_ms * 1000.0;
+        }
+      } else if (f.len == 14 && p[0] == LINK_PAGE_END && p[1] == tag) {
+        const uint32_t first = link_get32(p, 6);
+        r.end = link_get32(p, 10);
+        if (!range) {
+          r.first = first;
+          cursor = cursor > r.end ? first : link_get32(p, 2);
+          range = true;
+        } else if (cursor < first) {
+          r.missing += first - cursor;
+          cursor = first;
+        }
+        closed = ended = true;
+      }
+    }
+
+    if (ended && cursor >= r.end)
+      break;
+    if (range && r.records.size() >= limit)
+      break;
+    if (want && cursor < start + want)
+      r.retries++;
+    failed = cursor == start && !(ended && !want) ? failed + 1 : 0;
+    last_start = start;
+  }
+  r.ok = range && cursor >= r.end;
+  r.next = cursor;
+  r.seconds = (steady_us() - t0) / 1e6;
+  r.bytes = double(received_ - before);
+  return r;
+}
+
+} // namespace estufa
@@ -0,0 +1,112 @@
+/**
+ * @brief LinkClient - host end of LinkSession (lib/EstufaCore/LinkSession.h)
+ *
+ *
+ * @notes:
+ * - Commands go out as LinkFrames; whatever comes back is split by a
+ * LinkReader into status lines (to the text handler) and answers, read
+ * where they were decoded.
+ *
+ * - upgrade(): 'B' at the current rate, then probes at the new one. If
+ * no probe is answered the host goes back to the base rate and waits for
+ * the device's own fallback (LINK_PROBE_MS), probing until it answers.
+ *
+ * - telemetry_interval(): sets the device's telemetry interval ('I').
+ *
+ * - dump(): the event log from a cursor on, page by page. Each page is
+ * asked for from the last record received intact, so a lost or damaged
+ * chunk costs the rest of its page and a round trip, never the download.
+ * The result's `next` is where to resume once the link is back; a cursor
+ * past the end of the log (the device restarted) starts from the oldest
+ * record. Small pages lose less to each error, large ones fewer round
+ * trips: `estufalink selftest` measures both.
+ *
+ */
+#pragma once
+
+#include "LinkPort.h"
+#include "LinkReader.h"
+
+#include <EventLog.h>
+#include <LinkFrame.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace estufa
+{
+
+struct DumpResult
+{
+  bool ok = false;                    // Caught up with the end of the log
+  std::vector<uint32_t> seq;          // Sequence number of each record
+  std::vector<EventRecord> records;
+  uint32_t first = 0, end = 0;        // Range in the log when the dump began
+  uint32_t next = 0;                  // Cursor: resume from here
+  uint32_t missing = 0;               // Overwritten before they were sent
+  unsigned pages = 0;                 // Asked for, retries included
+  unsigned retries = 0;               // Asked for again after a loss
+  double seconds = 0;
+  double bytes = 0;                   // Received during the dump, all of it
+};
+
+class LinkClient
+{
+public:
+  explicit LinkClient(LinkPort &port, unsigned base = 115200) : port_(port), base_(base) {}
+
+  void on_text(std::function<void(const std::string &)> handler) { text_ = handler; }
+
+  struct Frame
+  {
+    const uint8_t *data;      // In the receive buffer, until the next read
+    size_t len;
+  };
+
+  bool send(const std::vector<uint8_t> &payload);
+  // Next frame starting with `type`; others are dropped
+  bool expect(uint8_t type, Frame &f, int timeout_ms);
+
+  // Probe at the current rate
+  bool ping(int timeout_ms = 200);
+
+  /**
+   * @brief Negotiate `baud`
+   *
+   * @return the rate both ends use afterwards, 0 if the device is lost
+   */
+  unsigned upgrade(unsigned baud);
+
+  // Telemetry interval in ms, 0 stops it: the one the device now uses, or
+  // -1 without an answer or without a telemetry stream
+  int telemetry_interval(uint16_t ms);
+
+  static constexpr uint16_t page_records = 64;
+  static constexpr unsigned page_retries = 8;   // In a row, without progress
+
+  /**
+   * @brief Records from `from` on, at most `limit` of them
+   *
+   * @param quiet_ms silence that counts as the page lost
+   */
+  DumpResult dump(uint32_t from = 0, uint32_t limit = UINT32_MAX, uint16_t page = page_records,
+                  int quiet_ms = 50);
+
+  unsigned bad_frames() const { return reader_.bad_frames(); }
+  unsigned long received() const { return received_; }
+
+private:
+  // Next checked frame, text and bad frames handled on the way
+  bool next_frame(Frame &f, int timeout_ms);
+
+  LinkPort &port_;
+  unsigned base_;
+  LinkReader reader_;
+  std::function<void(const std::string &)> text_;
+  unsigned long received_ = 0;
+  uint8_t nonce_ = 0;
+};
+
+} // namespace estufa
@@ -0,0 +1,21 @@
+/**
+ * @brief LinkPort - the status build's serial stream (host side)
+ *
+ *
+ * @notes:
+ * - A raw serial port (host/lib/HostSerial) carrying what SerialLink
+ * sends: status text with LinkFrame binary frames in between
+ * (lib/EstufaCore/LinkFrame.h). read() returns whatever arrived; the
+ * caller splits it with a LinkReader.
+ *
+ */
+#pragma once
+
+#include <HostSerial.h>
+
+namespace estufa
+{
+
+typedef SerialPort LinkPort;
+
+} // namespace estufa
@@ -0,0 +1,90 @@
+#include "LinkReader.h"
+
+#include <LinkFrame.h>
+
+#include <cstring>
+
+namespace estufa
+{
+
+uint8_t *LinkReader::space(size_t min, size_t &len)
+{
+  if (buf_.size() - end_ < min && begin_) {
+    std::memmove(buf_.data(), buf_.data() + begin_, end_ - begin_);
+    scan_ -= begin_;
+    end_ -= begin_;
+    begin_ = 0;
+  }
+  // An unfinished line or frame filling the whole buffer: make room
+  if (buf_.size() - end_ < min)
+    buf_.resize(end_ + min);
+  len = buf_.size() - end_;
+  return buf_.data() + end_;
+}
+
+LinkReader::Kind LinkReader::next(const uint8_t *&data, size_t &len)
+{
+  for (;;) {
+    const uint8_t *zero = static_cast<const uint8_t *>(std::memchr(buf_.data() + scan_, 0, end_ - scan_));
+    if (!in_frame_) {
+      const uint8_t *nl = static_cast<const uint8_t *>(std::memchr(buf_.data() + scan_, '\n', end_ - scan_));
+      if (nl && (!zero || nl < zero)) {
+        data = buf_.data() + begin_;
+        len = size_t(nl + 1 - data);
+        begin_ = scan_ = begin_ + len;
+        return TEXT;
+      }
+      if (!zero) {
+        scan_ = end_;
+        return NONE;
+      }
+      const size_t at = size_t(zero - buf_.data());
+      in_frame_ = true;
+      if (at > begin_) {
+        // Text cut short by a frame
+        data = buf_.data() + begin_;
+        len = at - begin_;
+        begin_ = scan_ = at + 1;
+        return TEXT;
+      }
+      begin_ = scan_ = at + 1;
+      continue;
+    }
+
+    if (!zero) {
+      scan_ = end_;
+      return NONE;
+    }
+    const size_t at = size_t(zero - buf_.data());
+    const size_t n = at - begin_;
+    uint8_t *body = buf_.data() + begin_;
+    if (!n) {
+      begin_ = scan_ = at + 1;
+      continue;
+    }
+    if (resync_) {
+      resync_ = false;
+      scratch_.assign(body, body + n);
+      if (link_decode(scratch_.data(), uint16_t(n)) < 0) {
+        // Text: the 0x00 after it opens the next frame
+        data = body;
+        len = n;
+        begin_ = scan_ = at + 1;
+        return TEXT;
+      }
+    }
+    const int16_t l = n <= 0xFFFF ? link_decode(body, uint16_t(n)) : -1;
+    begin_ = scan_ = at + 1;
+    if (l < 0) {
+      bad_frames_++;
+      resync_ = true;
+      continue;
+    }
+    in_frame_ = false;
+    data = body;
+    len = size_t(l);
+    return FRAME;
+  }
+}
+
+} // namespace estufa
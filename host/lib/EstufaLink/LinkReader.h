@@ -0,0 +1,61 @@
+/**
+ * @brief LinkReader - the gateway's receive buffer, split into text and frames
+ *
+ *
+ * @notes:
+ * - The port reads straight into the buffer (space(), then commit());
+ * next() walks it: status lines come out as text, frames are COBS-decoded
+ * in place (link_decode(), lib/EstufaCore/LinkFrame.h) and handed out as
+ * a pointer into the buffer, valid until the next call. Only an
+ * unfinished line or frame is ever moved, to the front, when space runs
+ * out.
+ *
+ * - Text is whatever lies outside a frame. After a frame that fails its
+ * check the reader cannot tell whether it was in step: a lost delimiter
+ * makes text look like a frame and the next frame look like text. So
+ * the bytes up to the following 0x00 are checked on a scratch copy: a
+ * valid frame is decoded as usual, anything else is text and the 0x00
+ * after it opens a frame. Back in step within one frame either way.
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace estufa
+{
+
+class LinkReader
+{
+public:
+  enum Kind { NONE, TEXT, FRAME };
+
+  explicit LinkReader(size_t size = 4096) : buf_(size) {}
+
+  // Room to read into, at least `min` bytes
+  uint8_t *space(size_t min, size_t &len);
+  void commit(size_t n) { end_ += n; }
+
+  /**
+   * @brief Next line (with its '\n') or frame payload
+   *
+   * @return NONE when the buffer holds nothing complete
+   */
+  Kind next(const uint8_t *&data, size_t &len);
+
+  unsigned bad_frames() const { return bad_frames_; }
+
+private:
+  std::vector<uint8_t> buf_;
+  size_t begin_ = 0;        // First byte not handed out
+  size_t scan_ = 0;         // Searched up to here for the current item
+  size_t end_ = 0;          // Bytes read
+  bool in_frame_ = false;   // begin_ is inside a frame body
+  bool resync_ = false;     // The last frame failed: frame or text?
+  std::vector<uint8_t> scratch_;
+  unsigned bad_frames_ = 0;
+};
+
+} // namespace estufa
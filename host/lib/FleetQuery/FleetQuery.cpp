@@ -0,0 +1,285 @@
+#include "FleetQuery.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <immintrin.h>
+
+namespace fleet
+{
+
+namespace
+{
+
+const int64_t NO_ROW = std::numeric_limits<int64_t>::min();
+
+inline int64_t encode(int64_t ts, uint8_t state)
+{
+  return int64_t(uint64_t(ts) << 1) | (state & 1);
+}
+
+
+/**
+ * @brief Scalar reference kernel
+ *
+ * Straight row-at-a-time loop, used as the baseline and for the tails
+ * of the vector kernels.
+ *
+ */
+ScanPartial scan_scalar(const SegmentView &s, size_t i, size_t end, const ChannelQuery &q)
+{
+  ScanPartial p = {0, 0, NO_ROW, NO_ROW};
+  for (; i < end; i++) {
+    if (s.device[i] != q.device || s.channel[i] != q.channel)
+      continue;
+    const int64_t ts = s.ts[i];
+    const int64_t key = encode(ts, s.state[i]);
+    if (ts < q.from_ms) {
+      if (key > p.last_before)
+        p.last_before = key;
+    } else if (ts < q.to_ms) {
+      p.signed_ts += s.state[i] ? -ts : ts;
+      p.switches++;
+      if (key > p.last_inside)
+        p.last_inside = key;
+    }
+  }
+  return p;
+}
+
+
+/**
+ * @brief SSE4.2 kernel, 16 rows per step
+ *
+ * Device/channel/state of 16 rows are compared as bytes and reduced to
+ * 16-bit masks; timestamps are then handled two lanes at a time.
+ *
+ */
+__attribute__((target("sse4.2")))
+ScanPartial scan_sse42(const SegmentView &s, size_t begin, size_t end, const ChannelQuery &q)
+{
+  const __m128i vdev = _mm_set1_epi16(int16_t(q.device));
+  const __m128i vch  = _mm_set1_epi8(int8_t(q.channel));
+  const __m128i vzero = _mm_setzero_si128();
+  const __m128i vlo  = _mm_set1_epi64x(q.from_ms - 1);
+  const __m128i vhi  = _mm_set1_epi64x(q.to_ms);
+
+  __m128i acc  = _mm_setzero_si128();
+  __m128i maxb = _mm_set1_epi64x(NO_ROW);
+  __m128i maxi = _mm_set1_epi64x(NO_ROW);
+  uint64_t switches = 0;
+
+  size_t i = begin;
+  for (; i + 16 <= end; i += 16) {
+    __m128i d0 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(s.device + i)), vdev);
+    __m128i d1 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(s.device + i + 8)), vdev);
+    __m128i key = _mm_and_si128(_mm_packs_epi16(d0, d1),
+                   _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(s.channel + i)), vch));
+    unsigned kmask = unsigned(_mm_movemask_epi8(key));
+    if (!kmask)
+      continue;
+
+    for (unsigned g = 0; g < 8; g++) {
+      unsigned bits = (kmask >> (2 * g)) & 3;
+      if (!bits)
+        continue;
+      const size_t r = i + 2 * g;
+      __m128i m  = _mm_set_epi64x(-int64_t(bits >> 1), -int64_t(bits & 1));
+      __m128i ts = _mm_loadu_si128((const __m128i *)(s.ts + r));
+      __m128i st = _mm_set_epi64x(s.state[r + 1] & 1, s.state[r] & 1);
+      __m128i on = _mm_sub_epi64(vzero, st);  // all ones when ON
+      __m128i enc = _mm_or_si128(_mm_slli_epi64(ts, 1), st);
+
+      __m128i ge = _mm_cmpgt_epi64(ts, vlo);
+      __m128i lt = _mm_cmpgt_epi64(vhi, ts);
+      __m128i in = _mm_and_si128(m, _mm_and_si128(ge, lt));
+      __m128i before = _mm_andnot_si128(ge, m);
+
+      // ON rows contribute -ts, OFF rows +ts
+      __m128i val = _mm_sub_epi64(_mm_xor_si128(ts, on), on);
+      acc = _mm_add_epi64(acc, _mm_and_si128(val, in));
+
+      __m128i upd = _mm_and_si128(in, _mm_cmpgt_epi64(enc, maxi));
+      maxi = _mm_blendv_epi8(maxi, enc, upd);
+      upd = _mm_and_si128(before, _mm_cmpgt_epi64(enc, maxb));
+      maxb = _mm_blendv_epi8(maxb, enc, upd);
+
+      switches += unsigned(__builtin_popcount(unsigned(_mm_movemask_pd(_mm_castsi128_pd(in)))));
+    }
+  }
+
+  ScanPartial p;
+  int64_t a[2], b[2], c[2];
+  _mm_storeu_si128((__m128i *)a, acc);
+  _mm_storeu_si128((__m128i *)b, maxb);
+  _mm_storeu_si128((__m128i *)c, maxi);
+  p.signed_ts   = a[0] + a[1];
+  p.switches    = switches;
+  p.last_before = std::max(b[0], b[1]);
+  p.last_inside = std::max(c[0], c[1]);
+  p.merge(scan_scalar(s, i, end, q));
+  return p;
+}
+
+
+/**
+ * @brief AVX2 kernel, 32 rows per step
+ *
+ * Same scheme as the SSE4.2 kernel with 4 timestamp lanes; lane masks
+ * are expanded from the 4-bit row masks through a small table.
+ *
+ */
+struct LaneTable
+{
+  alignas(32) int64_t lanes[16][4];
+  LaneTable()
+  {
+    for (int m = 0; m < 16; m++)
+      for (int l = 0; l < 4; l++)
+        lanes[m][l] = (m >> l) & 1 ? -1 : 0;
+  }
+};
+const LaneTable lane_table;
+
+__attribute__((target("avx2")))
+ScanPartial scan_avx2(const SegmentView &s, size_t begin, size_t end, const ChannelQuery &q)
+{
+  const __m256i vdev = _mm256_set1_epi16(int16_t(q.device));
+  const __m256i vch  = _mm256_set1_epi8(int8_t(q.channel));
+  const __m256i vst  = _mm256_setzero_si256();
+  const __m256i vlo  = _mm256_set1_epi64x(q.from_ms - 1);
+  const __m256i vhi  = _mm256_set1_epi64x(q.to_ms);
+
+  __m256i acc  = _mm256_setzero_si256();
+  __m256i maxb = _mm256_set1_epi64x(NO_ROW);
+  __m256i maxi = _mm256_set1_epi64x(NO_ROW);
+  uint64_t switches = 0;
+
+  size_t i = begin;
+  for (; i + 32 <= end; i += 32) {
+    __m256i d0 = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(s.device + i)), vdev);
+    __m256i d1 = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(s.device + i + 16)), vdev);
+    // packs works per 128-bit lane, fix the row order back up
+    __m256i dm = _mm256_permute4x64_epi64(_mm256_packs_epi16(d0, d1), 0xD8);
+    __m256i key = _mm256_and_si256(dm,
+                   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(s.channel + i)), vch));
+    uint32_t kmask = uint32_t(_mm256_movemask_epi8(key));
+    if (!kmask)
+      continue;
+    uint32_t smask = ~uint32_t(_mm256_movemask_epi8(
+                       _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(s.state + i)), vst)));
+
+    for (unsigned g = 0; g < 8; g++) {
+      unsigned bits = (kmask >> (4 * g)) & 0xF;
+      if (!bits)
+        continue;
+      const size_t r = i + 4 * g;
+      __m256i m  = _mm256_load_si256((const __m256i *)lane_table.lanes[bits]);
+      __m256i on = _mm256_load_si256((const __m256i *)lane_table.lanes[(smask >> (4 * g)) & 0xF]);
+      __m256i ts = _mm256_loadu_si256((const __m256i *)(s.ts + r));
+      __m256i enc = _mm256_sub_epi64(_mm256_slli_epi64(ts, 1), on);  // | state
+
+      __m256i ge = _mm256_cmpgt_epi64(ts, vlo);
+      __m256i lt = _mm256_cmpgt_epi64(vhi, ts);
+      __m256i in = _mm256_and_si256(m, _mm256_and_si256(ge, lt));
+      __m256i before = _mm256_andnot_si256(ge, m);
+
+      __m256i val = _mm256_sub_epi64(_mm256_xor_si256(ts, on), on);
+      acc = _mm256_add_epi64(acc, _mm256_and_si256(val, in));
+
+      __m256i upd = _mm256_and_si256(in, _mm256_cmpgt_epi64(enc, maxi));
+      maxi = _mm256_blendv_epi8(maxi, enc, upd);
+      upd = _mm256_and_si256(before, _mm256_cmpgt_epi64(enc, maxb));
+      maxb = _mm256_blendv_epi8(maxb, enc, upd);
+
+      switches += unsigned(__builtin_popcount(unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(in)))));
+    }
+  }
+
+  ScanPartial p;
+  alignas(32) int64_t a[4], b[4], c[4];
+  _mm256_store_si256((__m256i *)a, acc);
+  _mm256_store_si256((__m256i *)b, maxb);
+  _mm256_store_si256((__m256i *)c, maxi);
+  p.signed_ts   = a[0] + a[1] + a[2] + a[3];
+  p.switches    = switches;
+  p.last_before = std::max(std::max(b[0], b[1]), std::max(b[2], b[3]));
+  p.last_inside = std::max(std::max(c[0], c[1]), std::max(c[2], c[3]));
+  p.merge(scan_scalar(s, i, end, q));
+  return p;
+}
+
+} // namespace
+
+
+void ScanPartial::merge(const ScanPartial &o)
+{
+  signed_ts += o.signed_ts;
+  switches  += o.switches;
+  if (o.last_before > last_before) last_before = o.last_before;
+  if (o.last_inside > last_inside) last_inside = o.last_inside;
+}
+
+Kernel best_kernel()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return Kernel::Avx2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return Kernel::Sse42;
+  return Kernel::Scalar;
+}
+
+const char *kernel_name(Kernel k)
+{
+  switch (k) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::Sse42:  return "sse4.2";
+    case Kernel::Avx2:   return "avx2";
+    default:             return "auto";
+  }
+}
+
+ScanPartial scan_columns(Kernel k, const SegmentView &seg, size_t begin, size_t end,
+                         const ChannelQuery &q)
+{
+  if (k == Kernel::Auto)
+    k = best_kernel();
+  switch (k) {
+    case Kernel::Avx2:  return scan_avx2(seg, begin, end, q);
+    case Kernel::Sse42: return scan_sse42(seg, begin, end, q);
+    default:            return scan_scalar(seg, begin, end, q);
+  }
+}
+
+ChannelStats query_channel(const StoreReader &store, const ChannelQuery &q, Kernel k)
+{
+  if (k == Kernel::Auto)
+    k = best_kernel();
+
+  // Newest segments first, so the state at window start is usually known
+  // before reaching segments that lie entirely in the past
+  std::vector<const SegmentView *> order;
+  for (const SegmentView &s : store.segments())
+    if (s.rows && s.min_ts < q.to_ms)
+      order.push_back(&s);
+  std::sort(order.begin(), order.end(),
+            [](const SegmentView *a, const SegmentView *b) { return a->max_ts > b->max_ts; });
+
+  ScanPartial p = {0, 0, NO_ROW, NO_ROW};
+  for (const SegmentView *s : order) {
+    if (s->max_ts < q.from_ms && p.last_before >= encode(s->max_ts, 0))
+      break;
+    p.merge(scan_columns(k, *s, 0, s->rows, q));
+  }
+
+  ChannelStats r;
+  r.on_at_start = p.last_before != NO_ROW && (p.last_before & 1);
+  r.on_at_end   = p.last_inside != NO_ROW ? (p.last_inside & 1) != 0 : r.on_at_start;
+  r.switches    = p.switches;
+  r.on_ms       = p.signed_ts - (r.on_at_start ? q.from_ms : 0) + (r.on_at_end ? q.to_ms : 0);
+  return r;
+}
+
+} // namespace fleet
@@ -0,0 +1,89 @@
+/**
+ * @brief FleetQuery - on-time / switch-count / duty-cycle queries
+ *
+ *
+ * @notes:
+ * - Works directly on the mapped columns of a FleetStore, nothing is
+ * copied. Segments starting after the window are never read, and older
+ * segments are skipped once the state at window start is known.
+ *
+ * - The store holds transitions: a channel's rows alternate ON and OFF
+ * (fleetstore ingest drops repeats, TransitionFilter in FleetStore.h).
+ * So for one channel the ON time inside a window [t0, t1) is
+ *      sum(ts of OFF rows) - sum(ts of ON rows)
+ *      - t0 (if ON when the window opens) + t1 (if ON when it closes)
+ * which is a masked sum over the columns and maps well onto SIMD lanes.
+ * The state at t0 / t1 is the one of the newest matching row, found with
+ * a masked max over (ts << 1 | state) in the same pass, so rows do not
+ * have to be sorted.
+ *
+ * - Kernels: scalar (reference), SSE4.2 and AVX2, picked at run time.
+ *
+ */
+#pragma once
+
+#include <FleetStore.h>
+
+#include <cstdint>
+
+namespace fleet
+{
+
+enum class Kernel
+{
+  Auto,
+  Scalar,
+  Sse42,
+  Avx2
+};
+
+struct ChannelQuery
+{
+  uint16_t device;
+  uint8_t  channel;
+  int64_t  from_ms;  // Window start (inclusive)
+  int64_t  to_ms;    // Window end (exclusive)
+};
+
+struct ChannelStats
+{
+  int64_t  on_ms;      // Time spent ON inside the window
+  uint64_t switches;   // Transitions inside the window
+  bool     on_at_start;
+  bool     on_at_end;
+
+  double duty_cycle(const ChannelQuery &q) const
+  {
+    return q.to_ms > q.from_ms ? double(on_ms) / double(q.to_ms - q.from_ms) : 0.0;
+  }
+};
+
+/**
+ * @brief Partial result of one kernel pass over a column range
+ *
+ * Partials of several segments/threads are combined with merge().
+ *
+ */
+struct ScanPartial
+{
+  int64_t  signed_ts;    // sum(OFF ts) - sum(ON ts), in window
+  uint64_t switches;
+  int64_t  last_before;  // max(ts << 1 | state) of rows before the window
+  int64_t  last_inside;  // same, rows inside the window
+
+  void merge(const ScanPartial &o);
+};
+
+// Best kernel the running CPU supports
+Kernel best_kernel();
+const char *kernel_name(Kernel k);
+
+// Scan one column range with a given kernel (Kernel::Auto = best_kernel())
+ScanPartial scan_columns(Kernel k, const SegmentView &seg, size_t begin, size_t end,
+                         const ChannelQuery &q);
+
+// Full query over every segment of a store
+ChannelStats query_channel(const StoreReader &store, const ChannelQuery &q,
+                           Kernel k = Kernel::Auto);
+
+} // namespace fleet
@@ -0,0 +1,387 @@
+#include "FleetStore.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fleet
+{
+
+namespace
+{
+
+const uint64_t COLUMN_ALIGN = 64;
+
+uint64_t align_up(uint64_t v)
+{
+  return (v + COLUMN_ALIGN - 1) & ~(COLUMN_ALIGN - 1);
+}
+
+void fail(const std::string &what)
+{
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// Fill in column offsets for a segment of `capacity` rows, return file size
+uint64_t layout(SegmentHeader &h, uint32_t capacity)
+{
+  uint64_t off = sizeof(SegmentHeader);
+  h.off_ts      = off = align_up(off);  off += uint64_t(capacity) * sizeof(int64_t);
+  h.off_device  = off = align_up(off);  off += uint64_t(capacity) * sizeof(uint16_t);
+  h.off_channel = off = align_up(off);  off += uint64_t(capacity) * sizeof(uint8_t);
+  h.off_state   = off = align_up(off);  off += uint64_t(capacity) * sizeof(uint8_t);
+  h.off_value   = off = align_up(off);  off += uint64_t(capacity) * sizeof(int32_t);
+  return align_up(off);
+}
+
+bool file_exists(const std::string &path)
+{
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0;
+}
+
+// Fast unsigned/signed decimal parse, no locale, no allocation; a value
+// beyond int64_t, or one not followed by whitespace or the end, clears
+// `ok`, its digits are still skipped
+const char *parse_int(const char *p, const char *end, int64_t &out, bool &ok)
+{
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = (*p++ == '-');
+  const char *start = p;
+  const int64_t max = std::numeric_limits<int64_t>::max();
+  int64_t v = 0;
+  bool range = true;
+  while (p < end && *p >= '0' && *p <= '9') {
+    const int digit = *p++ - '0';
+    if (v > (max - digit) / 10)
+      range = false;
+    else
+      v = v * 10 + digit;
+  }
+  const bool delimited = p == end || *p == ' ' || *p == '\t' || *p == '\r';
+  ok = ok && (p != start) && range && delimited;
+  out = neg ? -v : v;
+  return p;
+}
+
+} // namespace
+
+
+std::string segment_path(const std::string &dir, unsigned index)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "/seg-%06u.est", index);
+  return dir + name;
+}
+
+
+/**
+ * @brief StoreWriter
+ *
+ */
+StoreWriter::StoreWriter(const std::string &dir, uint32_t segment_rows)
+  : dir_(dir), seg_rows_(segment_rows)
+{
+  if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+    fail("mkdir " + dir);
+
+  // Continue the last segment of an existing store
+  unsigned last = 0;
+  bool found = false;
+  while (file_exists(segment_path(dir_, last))) {
+    found = true;
+    last++;
+  }
+  if (found) {
+    // Count rows of the full segments in front of the one we reopen
+    StoreReader existing(dir_);
+    for (size_t i = 0; i + 1 < existing.segments().size(); i++)
+      total_ += existing.segments()[i].rows;
+    open_segment(last - 1, false);
+    total_ += rows_;
+  } else {
+    open_segment(0, true);
+  }
+}
+
+StoreWriter::~StoreWriter()
+{
+  close_segment();
+}
+
+void StoreWriter::open_segment(unsigned index, bool create)
+{
+  const std::string path = segment_path(dir_, index);
+  SegmentHeader h;
+  std::memset(&h, 0, sizeof(h));
+
+  fd_ = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0644);
+  if (fd_ < 0)
+    fail("open " + path);
+
+  if (create) {
+    h.magic    = SEGMENT_MAGIC;
+    h.version  = SEGMENT_VERSION;
+    h.capacity = seg_rows_;
+    h.min_ts   = std::numeric_limits<int64_t>::max();
+    h.max_ts   = std::numeric_limits<int64_t>::min();
+    map_len_   = layout(h, seg_rows_);
+    // Sparse file: pages are only allocated once rows land on them
+    if (::ftruncate(fd_, off_t(map_len_)) != 0)
+      fail("ftruncate " + path);
+  } else {
+    if (::pread(fd_, &h, sizeof(h), 0) != ssize_t(sizeof(h)) || h.magic != SEGMENT_MAGIC)
+      throw std::runtime_error("bad segment header: " + path);
+    map_len_ = layout(h, h.capacity);
+  }
+
+  map_ = ::mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map_ == MAP_FAILED)
+    fail("mmap " + path);
+  // Appends are strictly sequential
+  ::madvise(map_, map_len_, MADV_SEQUENTIAL);
+
+  uint8_t *base = static_cast<uint8_t *>(map_);
+  hdr_ = reinterpret_cast<SegmentHeader *>(base);
+  if (create)
+    *hdr_ = h;
+  ts_       = reinterpret_cast<int64_t *>(base + hdr_->off_ts);
+  device_   = reinterpret_cast<uint16_t *>(base + hdr_->off_device);
+  channel_  = base + hdr_->off_channel;
+  state_    = base + hdr_->off_state;
+  value_    = reinterpret_cast<int32_t *>(base + hdr_->off_value);
+  capacity_ = hdr_->capacity;
+  rows_     = hdr_->rows;
+  min_ts_   = hdr_->min_ts;
+  max_ts_   = hdr_->max_ts;
+  seg_index_ = index;
+}
+
+void StoreWriter::close_segment()
+{
+  if (!map_)
+    return;
+  commit();
+  ::munmap(map_, map_len_);
+  ::close(fd_);
+  map_ = nullptr;
+  fd_ = -1;
+}
+
+void StoreWriter::roll()
+{
+  close_segment();
+  open_segment(seg_index_ + 1, true);
+}
+
+void StoreWriter::append(const EventRow *rows, size_t count)
+{
+  while (count) {
+    if (rows_ == capacity_)
+      roll();
+    size_t n = capacity_ - rows_;
+    if (n > count)
+      n = count;
+    // Column-wise copy keeps each store stream sequential
+    for (size_t i = 0; i < n; i++) ts_[rows_ + i] = rows[i].ts_ms;
+    for (size_t i = 0; i < n; i++) device_[rows_ + i] = rows[i].device;
+    for (size_t i = 0; i < n; i++) channel_[rows_ + i] = rows[i].channel;
+    for (size_t i = 0; i < n; i++) state_[rows_ + i] = rows[i].state;
+    for (size_t i = 0; i < n; i++) value_[rows_ + i] = rows[i].value;
+    for (size_t i = 0; i < n; i++) {
+      if (rows[i].ts_ms < min_ts_) min_ts_ = rows[i].ts_ms;
+      if (rows[i].ts_ms > max_ts_) max_ts_ = rows[i].ts_ms;
+    }
+    total_ += n;
+    rows_  += n;
+    rows   += n;
+    count  -= n;
+  }
+}
+
+void StoreWriter::commit()
+{
+  if (!hdr_)
+    return;
+  uint64_t added = rows_ - hdr_->rows;
+  if (added == 0)
+    return;
+  // Column data must reach the mapping before the row count that exposes it
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  hdr_->min_ts = min_ts_;
+  hdr_->max_ts = max_ts_;
+  __atomic_store_n(&hdr_->rows, rows_, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief StoreReader
+ *
+ */
+StoreReader::StoreReader(const std::string &dir)
+{
+  for (unsigned i = 0;; i++) {
+    const std::string path = segment_path(dir, i);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      if (errno == ENOENT)
+        break;
+      fail("open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      fail("fstat " + path);
+    }
+    size_t len = size_t(st.st_size);
+    void *addr = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+      fail("mmap " + path);
+    maps_.push_back({addr, len});
+
+    const uint8_t *base = static_cast<const uint8_t *>(addr);
+    const SegmentHeader *h = reinterpret_cast<const SegmentHeader *>(base);
+    if (len < sizeof(SegmentHeader) || h->magic != SEGMENT_MAGIC ||
+        h->version != SEGMENT_VERSION || h->off_value >= len)
+      throw std::runtime_error("bad segment header: " + path);
+    ::madvise(addr, len, MADV_SEQUENTIAL);
+
+    SegmentView v;
+    v.rows    = size_t(__atomic_load_n(&h->rows, __ATOMIC_ACQUIRE));
+    v.min_ts  = h->min_ts;
+    v.max_ts  = h->max_ts;
+    v.ts      = reinterpret_cast<const int64_t *>(base + h->off_ts);
+    v.device  = reinterpret_cast<const uint16_t *>(base + h->off_device);
+    v.channel = base + h->off_channel;
+    v.state   = base + h->off_state;
+    v.value   = reinterpret_cast<const int32_t *>(base + h->off_value);
+    views_.push_back(v);
+  }
+}
+
+StoreReader::~StoreReader()
+{
+  for (const Mapping &m : maps_)
+    ::munmap(m.addr, m.len);
+}
+
+uint64_t StoreReader::total_rows() const
+{
+  uint64_t n = 0;
+  for (const SegmentView &v : views_)
+    n += v.rows;
+  return n;
+}
+
+
+/**
+ * @brief TransitionFilter
+ *
+ */
+namespace
+{
+
+const int64_t NO_ROW = std::numeric_limits<int64_t>::min();
+
+inline int64_t encode(int64_t ts, uint8_t state)
+{
+  return int64_t(uint64_t(ts) << 1) | (state & 1);
+}
+
+} // namespace
+
+int64_t &TransitionFilter::newest(uint16_t device, uint8_t channel)
+{
+  if (device >= newest_.size())
+    newest_.resize(size_t(device) + 1);
+  std::vector<int64_t> &d = newest_[device];
+  if (d.empty())
+    d.assign(256, NO_ROW);
+  return d[channel];
+}
+
+void TransitionFilter::seed(const StoreReader &store)
+{
+  for (const SegmentView &s : store.segments())
+    for (size_t i = 0; i < s.rows; i++) {
+      int64_t &n = newest(s.device[i], s.channel[i]);
+      const int64_t key = encode(s.ts[i], s.state[i]);
+      if (key > n)
+        n = key;
+    }
+}
+
+bool TransitionFilter::accept(const EventRow &row)
+{
+  int64_t &n = newest(row.device, row.channel);
+  if (n != NO_ROW && row.ts_ms < (n >> 1)) {
+    out_of_order_++;
+    return false;
+  }
+  // A channel is OFF until its first row
+  if (row.state == (n != NO_ROW ? (n & 1) : 0)) {
+    repeated_++;
+    return false;
+  }
+  n = encode(row.ts_ms, row.state);
+  return true;
+}
+
+
+/**
+ * @brief Decoded device log parser
+ *
+ */
+const char *parse_log_line(const char *p, const char *end, EventRow &row, bool &ok, bool *bad)
+{
+  const char *eol = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+  if (!eol)
+    eol = end;
+
+  ok = false;
+  if (bad)
+    *bad = false;
+  const char *q = p;
+  while (q < eol && (*q == ' ' || *q == '\t' || *q == '\r'))
+    q++;
+  if (q == eol || *q == '#')
+    return eol < end ? eol + 1 : end;
+
+  int64_t ts, dev, ch, st, val;
+  ok = true;
+  q = parse_int(q, eol, ts, ok);
+  q = parse_int(q, eol, dev, ok);
+  q = parse_int(q, eol, ch, ok);
+  q = parse_int(q, eol, st, ok);
+  q = parse_int(q, eol, val, ok);
+  while (q < eol && (*q == ' ' || *q == '\t' || *q == '\r'))
+    q++;
+  ok = ok && q == eol &&
+       dev >= 0 && dev <= UINT16_MAX &&
+       ch >= 0 && ch <= UINT8_MAX &&
+       (st == 0 || st == 1) &&
+       val >= INT32_MIN && val <= INT32_MAX;
+  if (ok) {
+    row.ts_ms   = ts;
+    row.device  = uint16_t(dev);
+    row.channel = uint8_t(ch);
+    row.state   = uint8_t(st);
+    row.value   = int32_t(val);
+  } else if (bad) {
+    *bad = true;
+  }
+  return eol < end ? eol + 1 : end;
+}
+
+} // namespace fleet
@@ -0,0 +1,228 @@
+/**
+ * @brief FleetStore - append-only columnar event store (host side)
+ *
+ *
+ * @notes:
+ * - Events pulled from the controllers are kept as columns (timestamp,
+ * device, channel, state, value) inside fixed-capacity segment files.
+ * Each segment is memory-mapped, so the writer appends straight into
+ * the page cache and the reader scans the columns in place, without
+ * copying them into the process.
+ *
+ * - A store is a directory holding seg-000000.est, seg-000001.est, ...
+ * Only the last segment is ever written; full segments are immutable.
+ *
+ * - Segment layout (all columns 64-byte aligned):
+ *   SegmentHeader | ts[capacity] | device[capacity] | channel[capacity] |
+ *   state[capacity] | value[capacity]
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fleet
+{
+
+// One decoded controller event
+struct EventRow
+{
+  int64_t  ts_ms;    // Fleet time, milliseconds
+  uint16_t device;   // Controller address
+  uint8_t  channel;  // Relay channel (0 based)
+  uint8_t  state;    // 1 = ON, 0 = OFF
+  int32_t  value;    // Free payload (raw frame, sensor reading, ...)
+};
+
+const uint64_t SEGMENT_MAGIC      = 0x3147455346545345ULL; // "ESTFSEG1"
+const uint32_t SEGMENT_VERSION    = 1;
+const uint32_t DEFAULT_SEG_ROWS   = 1u << 22; // ~4M rows, ~64 MB per file
+
+struct SegmentHeader
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t capacity;   // Rows the segment can hold
+  uint64_t rows;       // Rows committed (readers never look past this)
+  int64_t  min_ts;
+  int64_t  max_ts;
+  uint64_t off_ts;     // Byte offsets of each column inside the file
+  uint64_t off_device;
+  uint64_t off_channel;
+  uint64_t off_state;
+  uint64_t off_value;
+  uint8_t  reserved[48];
+};
+static_assert(sizeof(SegmentHeader) == 128, "SegmentHeader must stay 128 bytes");
+
+
+/**
+ * @brief Read-only view of one mapped segment
+ *
+ * Column pointers stay valid while the owning StoreReader is alive.
+ *
+ */
+struct SegmentView
+{
+  size_t          rows;
+  int64_t         min_ts;
+  int64_t         max_ts;
+  const int64_t  *ts;
+  const uint16_t *device;
+  const uint8_t  *channel;
+  const uint8_t  *state;
+  const int32_t  *value;
+};
+
+
+/**
+ * @brief Appends rows to the last segment of a store
+ *
+ *
+ * @notes:
+ * - Rows are copied once, from the caller straight into the mapping.
+ * - rows/min_ts/max_ts in the header are published by commit(); a crash
+ * between commits loses at most the uncommitted tail.
+ *
+ */
+class StoreWriter
+{
+public:
+  explicit StoreWriter(const std::string &dir,
+                       uint32_t segment_rows = DEFAULT_SEG_ROWS);
+  ~StoreWriter();
+
+  StoreWriter(const StoreWriter &) = delete;
+  StoreWriter &operator=(const StoreWriter &) = delete;
+
+  void append(const EventRow &row)
+  {
+    if (rows_ == capacity_)
+      roll();
+    ts_[rows_]      = row.ts_ms;
+    device_[rows_]  = row.device;
+    channel_[rows_] = row.channel;
+    state_[rows_]   = row.state;
+    value_[rows_]   = row.value;
+    if (row.ts_ms < min_ts_) min_ts_ = row.ts_ms;
+    if (row.ts_ms > max_ts_) max_ts_ = row.ts_ms;
+    rows_++;
+    total_++;
+  }
+
+  void append(const EventRow *rows, size_t count);
+
+  // Publish appended rows to readers
+  void commit();
+
+  uint64_t total_rows() const { return total_; }
+
+private:
+  void open_segment(unsigned index, bool create);
+  void close_segment();
+  void roll();
+
+  std::string dir_;
+  uint32_t    seg_rows_;
+  unsigned    seg_index_ = 0;
+  int         fd_ = -1;
+  void       *map_ = nullptr;
+  size_t      map_len_ = 0;
+
+  SegmentHeader *hdr_ = nullptr;
+  int64_t   *ts_ = nullptr;
+  uint16_t  *device_ = nullptr;
+  uint8_t   *channel_ = nullptr;
+  uint8_t   *state_ = nullptr;
+  int32_t   *value_ = nullptr;
+  uint32_t   capacity_ = 0;
+  uint64_t   rows_ = 0;
+  int64_t    min_ts_;
+  int64_t    max_ts_;
+  uint64_t   total_ = 0;
+};
+
+
+/**
+ * @brief Maps every segment of a store read-only
+ *
+ */
+class StoreReader
+{
+public:
+  explicit StoreReader(const std::string &dir);
+  ~StoreReader();
+
+  StoreReader(const StoreReader &) = delete;
+  StoreReader &operator=(const StoreReader &) = delete;
+
+  const std::vector<SegmentView> &segments() const { return views_; }
+  uint64_t total_rows() const;
+
+private:
+  struct Mapping { void *addr; size_t len; };
+  std::vector<Mapping>     maps_;
+  std::vector<SegmentView> views_;
+};
+
+
+/**
+ * @brief Keeps the rows of a log that are transitions
+ *
+ *
+ * @notes:
+ * - FleetQuery's on-time sum needs each channel's rows to alternate ON
+ * and OFF. A controller log can repeat a state (ON@10, ON@20, OFF@50),
+ * so ingest drops every row that repeats its channel's newest state (OFF
+ * before its first row, as FleetQuery assumes), and
+ * every row older than that newest one, where alternation can no longer
+ * be checked. Both are counted.
+ *
+ * - StoreWriter itself takes rows as they come; whoever appends log rows
+ * filters them through this first.
+ *
+ */
+class TransitionFilter
+{
+public:
+  // Continue from the newest row of each channel already in a store
+  void seed(const StoreReader &store);
+
+  // True if the row changes its channel's state; otherwise counted
+  bool accept(const EventRow &row);
+
+  uint64_t repeated() const { return repeated_; }
+  uint64_t out_of_order() const { return out_of_order_; }
+
+private:
+  int64_t &newest(uint16_t device, uint8_t channel);
+
+  // Per device, 256 channels of (ts << 1 | state), allocated on first use
+  std::vector<std::vector<int64_t>> newest_;
+  uint64_t repeated_ = 0;
+  uint64_t out_of_order_ = 0;
+};
+
+
+/**
+ * @brief Parse one decoded device log line
+ *
+ * Format: "<ts_ms> <device> <channel> <state> <value>", whitespace
+ * separated. Lines starting with '#' (firmware banners/warnings) and
+ * blank lines are skipped.
+ *
+ * @return pointer past the consumed line; `ok` tells if `row` was filled,
+ * `bad` (if given) if the line was neither a row nor skippable: missing
+ * fields, a number out of its field's range (device 0..65535, channel
+ * 0..255, state 0 or 1, value int32_t, timestamp int64_t), or anything
+ * but whitespace after the value
+ */
+const char *parse_log_line(const char *p, const char *end, EventRow &row, bool &ok, bool *bad = nullptr);
+
+// Path of segment `index` inside `dir`
+std::string segment_path(const std::string &dir, unsigned index);
+
+} // namespace fleet
@@ -0,0 +1,106 @@
+/**
+ * @brief HalNative - EstufaCore backend for the host (Linux, macOS)
+ *
+ *
+ * @notes:
+ * - Relay frames are recorded in memory instead of being shifted out:
+ * HalNative::Relay::frames() holds every frame, oldest first.
+ * - Storage is a byte vector, erased (0xFF) by default; load an EEPROM
+ * image into storage() to test the image path.
+ * - Critical is a mutex, for a tick driven from another thread; the
+ * single-threaded simulator (host/coresim) calls tick() directly.
+ * - clock() is steady_clock nanoseconds, truncated to 32 bits.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <StorageStats.h>
+
+struct HalNative
+{
+  struct Relay
+  {
+    static constexpr uint8_t relays_per_module = 4;
+
+    static std::vector<std::vector<uint8_t>> &frames()
+    {
+      static std::vector<std::vector<uint8_t>> f;
+      return f;
+    }
+
+    static void begin() {}
+
+    static void write_frame(const uint8_t *bytes, uint16_t len)
+    {
+      frames().emplace_back(bytes, bytes + len);
+    }
+  };
+
+  class Critical
+  {
+  public:
+    Critical() : lock_(mutex()) {}
+
+  private:
+    static std::mutex &mutex()
+    {
+      static std::mutex m;
+      return m;
+    }
+    std::lock_guard<std::mutex> lock_;
+  };
+
+  static std::vector<uint8_t> &storage()
+  {
+    static std::vector<uint8_t> s(4096, 0xFF);
+    return s;
+  }
+
+  static void storage_read(uint16_t addr, void *dst, uint16_t len)
+  {
+    uint8_t *out = static_cast<uint8_t *>(dst);
+    for (uint16_t i = 0; i < len; i++)
+      out[i] = size_t(addr) + i < storage().size() ? storage()[addr + i] : 0xFF;
+  }
+
+  // Immediate, counted like the AVR's EepromWriter
+  static bool storage_write(uint16_t addr, const void *src, uint16_t len)
+  {
+    const uint8_t *in = static_cast<const uint8_t *>(src);
+    if (size_t(addr) + len > storage().size())
+      return false;
+    for (uint16_t i = 0; i < len; i++) {
+      if (storage()[addr + i] == in[i]) {
+        stats().skipped++;
+      } else {
+        storage()[addr + i] = in[i];
+        stats().written++;
+      }
+    }
+    stats().done++;
+    return true;
+  }
+
+  static bool storage_busy() { return false; }
+  static void storage_stats(StorageStats &s) { s = stats(); }
+
+  static StorageStats &stats()
+  {
+    static StorageStats s = {0, 0, 0, 0, 0};
+    return s;
+  }
+
+  static uint32_t clock()
+  {
+    using namespace std::chrono;
+    return uint32_t(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+  }
+
+  static uint32_t clock_hz() { return 1000000000UL; }
+};
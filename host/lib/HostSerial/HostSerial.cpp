@@ -0,0 +1,161 @@
+#include "HostSerial.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <unistd.h>
+
+namespace estufa
+{
+
+speed_t baud_constant(unsigned baud)
+{
+  switch (baud) {
+    case 9600:    return B9600;
+    case 19200:   return B19200;
+    case 38400:   return B38400;
+    case 57600:   return B57600;
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 500000:  return B500000;
+    case 1000000: return B1000000;
+    default:      return 0;
+  }
+}
+
+unsigned speed_baud(speed_t speed)
+{
+  switch (speed) {
+    case B9600:    return 9600;
+    case B19200:   return 19200;
+    case B38400:   return 38400;
+    case B57600:   return 57600;
+    case B115200:  return 115200;
+    case B230400:  return 230400;
+    case B500000:  return 500000;
+    case B1000000: return 1000000;
+    default:       return 0;
+  }
+}
+
+
+double steady_us()
+{
+  using namespace std::chrono;
+  return duration_cast<duration<double, std::micro>>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+SerialPort::~SerialPort()
+{
+  close();
+}
+
+bool SerialPort::open(const std::string &path, unsigned baud, std::string &error)
+{
+  int fd = ::open(path.c_str(), O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  return attach(fd, baud, error);
+}
+
+bool SerialPort::attach(int fd, unsigned baud, std::string &error)
+{
+  close();
+  speed_t speed = baud_constant(baud);
+  if (!speed) {
+    ::close(fd);
+    error = "unsupported baud rate " + std::to_string(baud);
+    return false;
+  }
+  termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  tcflush(fd, TCIOFLUSH);
+  fd_ = fd;
+  baud_ = baud;
+  return true;
+}
+
+void SerialPort::close()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+}
+
+bool SerialPort::set_baud(unsigned baud)
+{
+  speed_t speed = baud_constant(baud);
+  termios tio;
+  if (!speed || tcgetattr(fd_, &tio) != 0)
+    return false;
+  tcdrain(fd_);
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  if (tcsetattr(fd_, TCSANOW, &tio) != 0)
+    return false;
+  baud_ = baud;
+  return true;
+}
+
+bool SerialPort::write(const uint8_t *data, size_t len)
+{
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = ::write(fd_, data + done, len - done);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      return false;
+    }
+    done += size_t(n);
+  }
+  return true;
+}
+
+long SerialPort::read(uint8_t *buf, size_t len, int timeout_ms)
+{
+  pollfd p = {fd_, POLLIN, 0};
+  int ready = poll(&p, 1, timeout_ms);
+  if (ready < 0)
+    return errno == EINTR ? 0 : -1;
+  if (ready == 0)
+    return 0;
+  ssize_t n = ::read(fd_, buf, len);
+  if (n < 0)
+    return errno == EINTR || errno == EAGAIN ? 0 : -1;
+  return long(n);
+}
+
+
+bool open_pty(int &master_fd, std::string &slave_path, std::string &error)
+{
+  int slave_fd;
+  char name[128];
+  if (openpty(&master_fd, &slave_fd, name, nullptr, nullptr) < 0) {
+    error = std::string("openpty: ") + std::strerror(errno);
+    return false;
+  }
+  // Raw on the slave side too, or the line discipline rewrites bytes
+  termios tio;
+  tcgetattr(slave_fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave_fd, TCSANOW, &tio);
+  ::close(slave_fd);
+  slave_path = name;
+  return true;
+}
+
+} // namespace estufa
@@ -0,0 +1,71 @@
+/**
+ * @brief HostSerial - raw serial ports and pty pairs for the host tools
+ *
+ *
+ * @notes:
+ * - SerialPort: termios port (USB adapter, RS-485 dongle or pty) in raw
+ * 8N1, no line discipline, reads that return whatever arrived. The
+ * protocol clients build on it: LinkPort (host/lib/EstufaLink) is one,
+ * modbus::Port (host/lib/ModbusRtu) adds RTU framing.
+ *
+ * - open_pty() is what the selftests run the firmware's code against:
+ * one end for the emulated device, the other opened like a real port.
+ *
+ * - Rates: the ones the firmware uses, 9600 to 1000000 (baud_constant()).
+ *
+ */
+#pragma once
+
+#include <termios.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace estufa
+{
+
+class SerialPort
+{
+public:
+  SerialPort() = default;
+  ~SerialPort();
+  SerialPort(const SerialPort &) = delete;
+  SerialPort &operator=(const SerialPort &) = delete;
+
+  // Serial device (or pty) in raw 8N1 at `baud`
+  bool open(const std::string &path, unsigned baud, std::string &error);
+  // Already open descriptor (pty end), raw mode applied; takes ownership
+  bool attach(int fd, unsigned baud, std::string &error);
+  void close();
+  // Wait for the output to drain, then switch rates
+  bool set_baud(unsigned baud);
+
+  bool write(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Read what is there, waiting up to timeout_ms for the first byte
+   *
+   * @return bytes read, 0 on timeout, -1 on error
+   */
+  long read(uint8_t *buf, size_t len, int timeout_ms);
+
+  unsigned baud() const { return baud_; }
+  int fd() const { return fd_; }
+
+private:
+  int fd_ = -1;
+  unsigned baud_ = 0;
+};
+
+// termios speed for a rate, 0 if not supported, and back (0 if unknown)
+speed_t baud_constant(unsigned baud);
+unsigned speed_baud(speed_t speed);
+
+// Monotonic host clock, us
+double steady_us();
+
+// A pty pair: master fd for one end, path of the slave end for the other
+bool open_pty(int &master_fd, std::string &slave_path, std::string &error);
+
+} // namespace estufa
@@ -0,0 +1,112 @@
+#include "ClockSync.h"
+
+#include <TimeSync.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace modbus
+{
+
+namespace
+{
+
+uint64_t u64(const std::vector<uint16_t> &r, size_t i)
+{
+  return uint64_t(r[i]) << 48 | uint64_t(r[i + 1]) << 32 | uint64_t(r[i + 2]) << 16 | r[i + 3];
+}
+
+int32_t i32(const std::vector<uint16_t> &r, size_t i)
+{
+  return int32_t(uint32_t(r[i]) << 16 | r[i + 1]);
+}
+
+} // namespace
+
+
+int64_t ClockSync::fleet_us(double steady)
+{
+  using namespace std::chrono;
+  static const double offset =
+      double(duration_cast<microseconds>(system_clock::now().time_since_epoch()).count()) -
+      estufa::steady_us();
+  return int64_t(std::llround(steady + offset));
+}
+
+ClockSync::Round ClockSync::round(unsigned burst)
+{
+  Round out;
+  struct Exchange
+  {
+    uint64_t t2 = 0;
+    int64_t t1 = 0, t4 = 0;
+    bool valid = false;
+  } prev;
+  int32_t pending_us = 0;
+
+  // burst reads give burst - 1 samples
+  for (unsigned i = 0; i <= burst; i++) {
+    Result r = master_.read_registers(address_, MODBUS_REG_TIME, MODBUS_TIME_REGS);
+    std::vector<uint16_t> regs = Master::registers(r);
+    if (regs.size() != MODBUS_TIME_REGS) {
+      prev.valid = false;
+      continue;
+    }
+    const uint64_t t2 = u64(regs, 0), prev_t2 = u64(regs, 4), prev_t3 = u64(regs, 8);
+    if (prev.valid && prev_t2 == prev.t2) {
+      const double offset = ((double(int64_t(prev.t2) - prev.t1)) + double(int64_t(prev_t3) - prev.t4)) / 2;
+      const double delay = double(prev.t4 - prev.t1) - double(int64_t(prev_t3 - prev.t2));
+      if (!out.samples || delay < out.delay_us) {
+        out.offset_us = offset;
+        out.delay_us = delay;
+        pending_us = i32(regs, 14);
+      }
+      out.samples++;
+    }
+    prev.t2 = t2;
+    prev.t1 = fleet_us(r.sent_us);
+    prev.t4 = fleet_us(r.received_us);
+    prev.valid = true;
+  }
+  if (!out.samples)
+    return out;
+
+  const int64_t now = fleet_now_us();
+  // Offset once everything already requested is slewed in
+  const double target = out.offset_us + pending_us;
+  if (synced_ && now > last_us_) {
+    out.residual_ppb = target / double(now - last_us_) * 1e9;
+    rate_ppb_ -= int32_t(std::lround(rate_estimated_ ? out.residual_ppb / 2 : out.residual_ppb));
+    rate_estimated_ = true;
+  }
+  const int64_t correction = -std::llround(target);
+  const bool stepped = correction > TIME_SYNC_STEP_US || correction < -TIME_SYNC_STEP_US;
+  out.correction_us = correction;
+  out.stepped = stepped;
+  out.rate_ppb = rate_ppb_;
+
+  const uint32_t rate = uint32_t(rate_ppb_);
+  Result w;
+  if (stepped) {
+    // Rate and step in one write (+2..+7)
+    const uint64_t c = uint64_t(correction);
+    w = master_.write_registers(address_, MODBUS_REG_TIME_CORRECT + 2,
+                                {uint16_t(rate >> 16), uint16_t(rate), uint16_t(c >> 48),
+                                 uint16_t(c >> 32), uint16_t(c >> 16), uint16_t(c)});
+  } else {
+    const uint32_t c = uint32_t(int32_t(correction));
+    w = master_.write_registers(address_, MODBUS_REG_TIME_CORRECT,
+                                {uint16_t(c >> 16), uint16_t(c), uint16_t(rate >> 16), uint16_t(rate)});
+  }
+  out.ok = w.ok && !w.exception;
+  if (out.ok) {
+    // A step leaves nothing to estimate drift from
+    synced_ = !stepped;
+    last_us_ = now;
+  }
+  return out;
+}
+
+} // namespace modbus
@@ -0,0 +1,64 @@
+/**
+ * @brief ClockSync - host side of the device time sync (TimeSync.h)
+ *
+ *
+ * @notes:
+ * - Fleet time is the host's wall clock in us, sampled once against the
+ * monotonic clock at startup so a host clock adjustment during a run
+ * does not show up as device drift.
+ *
+ * - One round per device: a burst of time-register reads. Each read
+ * returns the device stamps (t2, t3) of the previous read, which the
+ * host pairs with its own send/receive times (t1, t4) of that read:
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2    device minus fleet time
+ *   delay  = (t4 - t1) - (t3 - t2)          round trip minus device time
+ * The sample with the smallest delay is the least disturbed one.
+ *
+ * - Skew: after a round the device is told to remove offset plus what
+ * it still has to slew, so at the next round that sum would be 0 without
+ * drift; what is left, over the elapsed time, is the residual frequency
+ * error, folded into the rate (half of it after the first estimate).
+ *
+ */
+#pragma once
+
+#include "ModbusRtu.h"
+
+#include <cstdint>
+
+namespace modbus
+{
+
+class ClockSync
+{
+public:
+  ClockSync(Master &master, uint8_t address) : master_(master), address_(address) {}
+
+  struct Round
+  {
+    bool ok = false;
+    unsigned samples = 0;
+    double offset_us = 0;     // device - fleet, before this round's correction
+    double delay_us = 0;
+    double residual_ppb = 0;  // frequency error seen since the last round
+    int32_t rate_ppb = 0;     // rate written to the device
+    int64_t correction_us = 0;  // written: slewed in, or stepped
+    bool stepped = false;
+  };
+
+  Round round(unsigned burst = 5);
+
+  // Fleet time, us
+  static int64_t fleet_us(double steady);
+  static int64_t fleet_now_us() { return fleet_us(estufa::steady_us()); }
+
+private:
+  Master &master_;
+  uint8_t address_;
+  bool synced_ = false;
+  bool rate_estimated_ = false;
+  int32_t rate_ppb_ = 0;
+  int64_t last_us_ = 0;
+};
+
+} // namespace modbus
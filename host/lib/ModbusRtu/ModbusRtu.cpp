@@ -0,0 +1,140 @@
+#include "ModbusRtu.h"
+
+#include <chrono>
+#include <poll.h>
+#include <thread>
+#include <unistd.h>
+
+namespace modbus
+{
+
+bool Port::write_frame(const std::vector<uint8_t> &frame)
+{
+  return write(frame.data(), frame.size());
+}
+
+bool Port::read_frame(std::vector<uint8_t> &frame, int first_byte_ms)
+{
+  frame.clear();
+  pollfd p = {fd(), POLLIN, 0};
+  if (poll(&p, 1, first_byte_ms) <= 0)
+    return false;
+  first_byte_us_ = estufa::steady_us();
+
+  uint8_t buf[256];
+  for (;;) {
+    ssize_t n = ::read(fd(), buf, sizeof(buf));
+    if (n > 0)
+      frame.insert(frame.end(), buf, buf + n);
+    // t3.5 of silence ends the frame
+    timespec t35 = {0, long(t35_us()) * 1000};
+    if (ppoll(&p, 1, &t35, nullptr) <= 0)
+      return !frame.empty();
+  }
+}
+
+std::vector<uint8_t> make_frame(uint8_t address, const std::vector<uint8_t> &pdu)
+{
+  std::vector<uint8_t> f;
+  f.reserve(pdu.size() + 3);
+  f.push_back(address);
+  f.insert(f.end(), pdu.begin(), pdu.end());
+  uint16_t crc = modbus_crc16(f.data(), uint16_t(f.size()));
+  f.push_back(crc & 0xFF);
+  f.push_back(crc >> 8);
+  return f;
+}
+
+bool check_crc(const std::vector<uint8_t> &frame)
+{
+  if (frame.size() < 4)
+    return false;
+  uint16_t crc = modbus_crc16(frame.data(), uint16_t(frame.size() - 2));
+  return frame[frame.size() - 2] == (crc & 0xFF) && frame[frame.size() - 1] == (crc >> 8);
+}
+
+
+Result Master::transact(uint8_t address, const std::vector<uint8_t> &pdu)
+{
+  Result r;
+  std::vector<uint8_t> req = make_frame(address, pdu), resp;
+  double t0 = estufa::steady_us();
+  if (!port_.write_frame(req))
+    return r;
+  if (address == MODBUS_BROADCAST) {
+    // No answer; leave the slaves a turnaround delay
+    std::this_thread::sleep_for(std::chrono::microseconds(port_.t35_us() * 2));
+    r.ok = true;
+    return r;
+  }
+  if (!port_.read_frame(resp, timeout_ms_))
+    return r;
+  r.rtt_us = estufa::steady_us() - t0;
+  r.sent_us = t0;
+  r.received_us = port_.first_byte_us();
+  if (!check_crc(resp) || resp[0] != address || resp.size() < 5)
+    return r;
+  r.ok = true;
+  r.pdu.assign(resp.begin() + 1, resp.end() - 2);
+  if (r.pdu[0] & 0x80)
+    r.exception = r.pdu[1];
+  return r;
+}
+
+Result Master::read_coils(uint8_t address, uint16_t start, uint16_t count)
+{
+  return transact(address, {MODBUS_READ_COILS, uint8_t(start >> 8), uint8_t(start),
+                            uint8_t(count >> 8), uint8_t(count)});
+}
+
+Result Master::read_registers(uint8_t address, uint16_t start, uint16_t count)
+{
+  return transact(address, {MODBUS_READ_HOLDING, uint8_t(start >> 8), uint8_t(start),
+                            uint8_t(count >> 8), uint8_t(count)});
+}
+
+Result Master::write_coil(uint8_t address, uint16_t coil, bool on)
+{
+  return transact(address, {MODBUS_WRITE_COIL, uint8_t(coil >> 8), uint8_t(coil),
+                            uint8_t(on ? 0xFF : 0x00), 0x00});
+}
+
+Result Master::write_register(uint8_t address, uint16_t reg, uint16_t value)
+{
+  return transact(address, {MODBUS_WRITE_REGISTER, uint8_t(reg >> 8), uint8_t(reg),
+                            uint8_t(value >> 8), uint8_t(value)});
+}
+
+Result Master::write_registers(uint8_t address, uint16_t start, const std::vector<uint16_t> &values)
+{
+  std::vector<uint8_t> pdu = {MODBUS_WRITE_REGISTERS, uint8_t(start >> 8), uint8_t(start),
+                              uint8_t(values.size() >> 8), uint8_t(values.size()),
+                              uint8_t(values.size() * 2)};
+  for (uint16_t v : values) {
+    pdu.push_back(uint8_t(v >> 8));
+    pdu.push_back(uint8_t(v));
+  }
+  return transact(address, pdu);
+}
+
+std::vector<uint8_t> Master::coil_bits(const Result &r, uint16_t count)
+{
+  std::vector<uint8_t> bits;
+  if (!r.ok || r.exception || r.pdu.size() < 2)
+    return bits;
+  for (uint16_t i = 0; i < count && 2U + i / 8 < r.pdu.size(); i++)
+    bits.push_back((r.pdu[2 + i / 8] >> (i % 8)) & 1);
+  return bits;
+}
+
+std::vector<uint16_t> Master::registers(const Result &r)
+{
+  std::vector<uint16_t> regs;
+  if (!r.ok || r.exception || r.pdu.size() < 2)
+    return regs;
+  for (size_t i = 2; i + 1 < r.pdu.size(); i += 2)
+    regs.push_back(uint16_t(r.pdu[i] << 8 | r.pdu[i + 1]));
+  return regs;
+}
+
+} // namespace modbus
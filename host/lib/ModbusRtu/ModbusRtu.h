@@ -0,0 +1,93 @@
+/**
+ * @brief ModbusRtu - Modbus RTU over a serial line (host side)
+ *
+ *
+ * @notes:
+ * - Port: raw serial port (host/lib/HostSerial: USB adapter, RS-485
+ * dongle or pty), frames delimited by t3.5 of silence exactly like the
+ * firmware's RtuSerial, with poll() timeouts instead of a hardware timer.
+ *
+ * - Master: one request/response transaction at a time, measuring the
+ * round trip from the first request byte written to the last response
+ * byte read (plus the t3.5 that proves the response is complete).
+ * On an RS-485 bus it is the only master: with USB adapters that switch
+ * DE in hardware, polling many slaves is a loop over addresses with a
+ * short timeout for the ones that do not answer.
+ *
+ * - CRC and function codes come from lib/EstufaCore/ModbusSlave.h, so
+ * both ends share one definition.
+ *
+ */
+#pragma once
+
+#include <HostSerial.h>
+#include <ModbusSlave.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace modbus
+{
+
+class Port : public estufa::SerialPort
+{
+public:
+  bool write_frame(const std::vector<uint8_t> &frame);
+
+  /**
+   * @brief Read one frame
+   *
+   * Waits up to first_byte_ms for the first byte, then reads until t3.5
+   * of silence.
+   *
+   * @return false on timeout (no byte at all)
+   */
+  bool read_frame(std::vector<uint8_t> &frame, int first_byte_ms);
+
+  // Same rule as the firmware: fixed 1750 us above 19200 baud
+  unsigned t35_us() const { return baud() > 19200 || !baud() ? 1750 : 38500000U / baud(); }
+  // steady_us() when the first byte of the last frame read arrived
+  double first_byte_us() const { return first_byte_us_; }
+
+private:
+  double first_byte_us_ = 0;
+};
+
+// Frame = address, pdu, CRC
+std::vector<uint8_t> make_frame(uint8_t address, const std::vector<uint8_t> &pdu);
+bool check_crc(const std::vector<uint8_t> &frame);
+
+struct Result
+{
+  bool ok = false;              // Response received with a valid CRC
+  uint8_t exception = 0;        // Modbus exception code, 0 if none
+  std::vector<uint8_t> pdu;     // Response PDU (function code first)
+  double rtt_us = 0;
+  double sent_us = 0;           // estufa::steady_us(): request written
+  double received_us = 0;       // estufa::steady_us(): first response byte
+};
+
+class Master
+{
+public:
+  explicit Master(Port &port, int timeout_ms = 100) : port_(port), timeout_ms_(timeout_ms) {}
+
+  Result transact(uint8_t address, const std::vector<uint8_t> &pdu);
+
+  Result read_coils(uint8_t address, uint16_t start, uint16_t count);
+  Result read_registers(uint8_t address, uint16_t start, uint16_t count);
+  Result write_coil(uint8_t address, uint16_t coil, bool on);
+  Result write_register(uint8_t address, uint16_t reg, uint16_t value);
+  Result write_registers(uint8_t address, uint16_t start, const std::vector<uint16_t> &values);
+
+  // Payload bytes of a read response
+  static std::vector<uint8_t> coil_bits(const Result &r, uint16_t count);
+  static std::vector<uint16_t> registers(const Result &r);
+
+private:
+  Port &port_;
+  int timeout_ms_;
+};
+
+} // namespace modbus
@@ -0,0 +1,182 @@
+#include "PinTrace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace pintrace
+{
+
+namespace
+{
+
+// VCD timescale ("1ns", "100 ps", "1 us", ...) in picoseconds
+uint64_t timescale_ps(const std::string &text)
+{
+  std::string t;
+  for (char c : text)
+    if (c != ' ' && c != '\t' && c != '\n')
+      t += c;
+  size_t i = 0;
+  while (i < t.size() && t[i] >= '0' && t[i] <= '9')
+    i++;
+  uint64_t mul = i ? std::strtoull(t.substr(0, i).c_str(), nullptr, 10) : 1;
+  std::string unit = t.substr(i);
+  if (unit == "fs") return mul / 1000 ? mul / 1000 : 1;
+  if (unit == "ps") return mul;
+  if (unit == "ns") return mul * 1000ULL;
+  if (unit == "us") return mul * 1000000ULL;
+  if (unit == "ms") return mul * 1000000000ULL;
+  if (unit == "s")  return mul * 1000000000000ULL;
+  return 1000;  // simavr default: ns
+}
+
+} // namespace
+
+
+bool load_vcd(const std::string &path, const std::string &data_name,
+              const std::string &clk_name, Trace &out, std::string &error)
+{
+  std::ifstream in(path);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  std::map<std::string, uint8_t> ids;   // VCD identifier -> Pin
+  uint64_t scale_ps = 1000;
+  uint64_t now = 0;
+  std::string tok;
+  bool header = true;
+
+  while (in >> tok) {
+    if (header) {
+      if (tok == "$timescale") {
+        std::string text, w;
+        while (in >> w && w != "$end")
+          text += w;
+        scale_ps = timescale_ps(text);
+      } else if (tok == "$var") {
+        // $var wire 1 <id> <name> [range] $end
+        std::string type, width, id, name, w;
+        in >> type >> width >> id >> name;
+        while (in >> w && w != "$end") {}
+        if (name == data_name) ids[id] = DATA;
+        if (name == clk_name)  ids[id] = CLK;
+      } else if (tok == "$enddefinitions") {
+        std::string w;
+        while (in >> w && w != "$end") {}
+        header = false;
+        if (ids.size() != 2) {
+          error = "signals " + data_name + "/" + clk_name + " not found in " + path;
+          return false;
+        }
+      } else if (tok[0] == '$') {
+        std::string w;
+        while (tok != "$end" && in >> w && w != "$end") {}
+      }
+      continue;
+    }
+
+    if (tok[0] == '#') {
+      now = std::strtoull(tok.c_str() + 1, nullptr, 10) * scale_ps / 1000;
+      if (now > out.end_ns)
+        out.end_ns = now;
+    } else if (tok[0] == '0' || tok[0] == '1' || tok[0] == 'x' || tok[0] == 'z') {
+      auto it = ids.find(tok.substr(1));
+      if (it != ids.end())
+        out.edges.push_back({now, it->second, uint8_t(tok[0] == '1')});
+    } else if (tok[0] == 'b' || tok[0] == 'B') {
+      // Vector value: "b101 <id>", keep the lowest bit
+      std::string id;
+      in >> id;
+      auto it = ids.find(id);
+      if (it != ids.end())
+        out.edges.push_back({now, it->second, uint8_t(tok.back() == '1')});
+    }
+  }
+  std::stable_sort(out.edges.begin(), out.edges.end(),
+                   [](const Edge &a, const Edge &b) { return a.t_ns < b.t_ns; });
+  return true;
+}
+
+bool load_text(const std::string &path, Trace &out, std::string &error)
+{
+  std::ifstream in(path);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream ss(line);
+    uint64_t t;
+    std::string pin;
+    unsigned level;
+    if (!(ss >> t >> pin >> level)) {
+      error = "bad trace line: " + line;
+      return false;
+    }
+    uint8_t p = (pin == "CLK" || pin == "1") ? CLK : DATA;
+    out.edges.push_back({t, p, uint8_t(level != 0)});
+    if (t > out.end_ns)
+      out.end_ns = t;
+  }
+  std::stable_sort(out.edges.begin(), out.edges.end(),
+                   [](const Edge &a, const Edge &b) { return a.t_ns < b.t_ns; });
+  return true;
+}
+
+bool load_trace(const std::string &path, Trace &out, std::string &error)
+{
+  if (path.size() > 4 && path.compare(path.size() - 4, 4, ".vcd") == 0)
+    return load_vcd(path, "RELAY_DATA", "RELAY_CLK", out, error);
+  return load_text(path, out, error);
+}
+
+std::vector<Frame> decode_frames(const Trace &trace, unsigned bits)
+{
+  std::vector<Frame> frames;
+  uint8_t data = 0, clk = 0;
+  unsigned nbits = 0;
+  uint64_t t_rise = 0;
+  Frame cur;
+  uint8_t byte = 0;
+
+  for (const Edge &e : trace.edges) {
+    if (e.pin == DATA) {
+      data = e.level;
+      continue;
+    }
+    if (e.level == clk)
+      continue;
+    clk = e.level;
+    if (clk) {
+      // Rising edge: the board shifts DATA in
+      if (nbits == 0) {
+        cur = Frame();
+        cur.t_first_ns = e.t_ns;
+      }
+      byte = uint8_t((byte << 1) | data);
+      nbits++;
+      if (nbits % 8 == 0) {
+        cur.bytes.push_back(byte);
+        byte = 0;
+      }
+      t_rise = e.t_ns;
+    } else if (nbits == bits) {
+      // Falling edge after the last bit ends the latch pulse
+      cur.t_latch_ns = e.t_ns;
+      cur.latch_high_ns = e.t_ns - t_rise;
+      frames.push_back(cur);
+      nbits = 0;
+    }
+  }
+  return frames;
+}
+
+} // namespace pintrace
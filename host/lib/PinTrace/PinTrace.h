@@ -0,0 +1,71 @@
+/**
+ * @brief PinTrace - pin-level traces of the relay bus (host side)
+ *
+ *
+ * @notes:
+ * - Loads the level changes of RELAY_DATA / RELAY_CLK from a VCD file
+ * (simavr) or from a plain text trace ("<t_ns> <pin> <0|1>" per line,
+ * '#' comments), and decodes them into the frames the relay board
+ * latched.
+ *
+ * - A frame is 8 bits per module, MSB first, data sampled on the rising
+ * clock edge. The last bit of a frame is followed by the long clock-high
+ * latch pulse, so frames are delimited by bit count and the latch pulse
+ * is reported separately for timing checks.
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pintrace
+{
+
+enum Pin : uint8_t
+{
+  DATA = 0,
+  CLK  = 1
+};
+
+struct Edge
+{
+  uint64_t t_ns;
+  uint8_t  pin;    // Pin
+  uint8_t  level;
+};
+
+struct Frame
+{
+  uint64_t t_first_ns;  // Rising clock edge of the first bit
+  uint64_t t_latch_ns;  // Falling clock edge ending the latch pulse
+  uint64_t latch_high_ns;
+  std::vector<uint8_t> bytes;   // As shifted out: first byte = first sent
+};
+
+struct Trace
+{
+  std::vector<Edge> edges;      // Sorted by time
+  uint64_t end_ns = 0;          // Last timestamp seen
+};
+
+/**
+ * @brief Load a VCD file
+ *
+ * @param data_name, clk_name: $var reference names of the two signals
+ * @return false (and `error` set) if the file or a signal is missing
+ */
+bool load_vcd(const std::string &path, const std::string &data_name,
+              const std::string &clk_name, Trace &out, std::string &error);
+
+// Load a text trace, pins named DATA/CLK (or 0/1)
+bool load_text(const std::string &path, Trace &out, std::string &error);
+
+// Pick the loader from the file extension (.vcd or anything else)
+bool load_trace(const std::string &path, Trace &out, std::string &error);
+
+// Decode frames of `bits` bits each
+std::vector<Frame> decode_frames(const Trace &trace, unsigned bits);
+
+} // namespace pintrace
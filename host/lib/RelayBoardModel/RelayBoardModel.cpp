@@ -0,0 +1,177 @@
+#include "RelayBoardModel.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace relayboard
+{
+
+namespace
+{
+
+std::string fmt(const char *f, double a, double b = 0)
+{
+  char buf[128];
+  std::snprintf(buf, sizeof(buf), f, a, b);
+  return buf;
+}
+
+void minimum(uint64_t &slot, uint64_t v)
+{
+  if (v < slot)
+    slot = v;
+}
+
+} // namespace
+
+
+double shift_peak(const Params &p, double high_ns, double low_ns, unsigned pulses)
+{
+  const double a = std::exp(-high_ns / p.tau_charge_ns);
+  const double b = std::exp(-low_ns / p.tau_discharge_ns);
+  double v = 0;
+  for (unsigned i = 0; i < pulses; i++) {
+    v = 1 - (1 - v) * a;   // High
+    if (i + 1 < pulses)
+      v *= b;              // Low
+  }
+  return v;
+}
+
+Result simulate(const pintrace::Trace &trace, const Params &p)
+{
+  Result r;
+  const unsigned bits = 8 * p.modules;
+  std::vector<uint8_t> shift(p.modules, 0);
+
+  uint8_t data = 0, clk = 0;
+  uint64_t t_data = 0, t_clk = 0, t_prev = 0;
+  bool have_data = false, have_clk = false;
+  bool pending_hold = false;
+  uint64_t t_rise = 0;
+  double v = 0;
+  bool armed = true, latched_this_pulse = false;
+  unsigned nbits = 0;
+
+  // Integrate the RC up to `t`, latching if the threshold is crossed
+  auto advance = [&](uint64_t t) {
+    double dt = double(t - t_prev);
+    if (dt <= 0)
+      return;
+    if (clk) {
+      double v_end = 1 - (1 - v) * std::exp(-dt / p.tau_charge_ns);
+      if (armed && v < p.threshold && v_end >= p.threshold) {
+        double t_cross = p.tau_charge_ns * std::log((1 - v) / (1 - p.threshold));
+        uint64_t at = t_prev + uint64_t(t_cross);
+        armed = false;
+        latched_this_pulse = true;
+        r.latched.push_back(shift);
+        if (nbits != bits)
+          r.violations.push_back({at, fmt("latch after %.0f of %.0f bits", nbits, bits)});
+        else
+          r.frames++;
+        nbits = 0;
+      }
+      v = v_end;
+    } else {
+      v *= std::exp(-dt / p.tau_discharge_ns);
+      if (v < p.rearm)
+        armed = true;
+    }
+    t_prev = t;
+  };
+
+  for (const pintrace::Edge &e : trace.edges) {
+    advance(e.t_ns);
+    if (e.pin == pintrace::DATA) {
+      if (have_data && e.level == data)
+        continue;
+      if (pending_hold) {
+        uint64_t hold = e.t_ns - t_rise;
+        minimum(r.observed.hold_ns, hold);
+        if (hold < p.hold_ns)
+          r.violations.push_back({e.t_ns, fmt("hold %.0f ns < %.0f ns", double(hold), p.hold_ns)});
+        pending_hold = false;
+      }
+      data = e.level;
+      t_data = e.t_ns;
+      have_data = true;
+      continue;
+    }
+
+    if (have_clk && e.level == clk)
+      continue;
+    uint64_t width = e.t_ns - t_clk;
+    if (e.level) {
+      // Rising: shift DATA in
+      if (have_clk) {
+        minimum(r.observed.low_ns, width);
+        if (width < p.min_low_ns)
+          r.violations.push_back({e.t_ns, fmt("clock low %.0f ns < %.0f ns", double(width), p.min_low_ns)});
+      }
+      uint64_t setup = have_data ? e.t_ns - t_data : UINT64_MAX;
+      minimum(r.observed.setup_ns, setup);
+      if (setup < p.setup_ns)
+        r.violations.push_back({e.t_ns, fmt("setup %.0f ns < %.0f ns", double(setup), p.setup_ns)});
+      for (unsigned m = p.modules; m-- > 0;) {
+        uint8_t carry = m ? shift[m - 1] >> 7 : data;
+        shift[m] = uint8_t((shift[m] << 1) | carry);
+      }
+      nbits++;
+      t_rise = e.t_ns;
+      pending_hold = true;
+      latched_this_pulse = false;
+    } else if (have_clk) {
+      // Falling: classify the pulse
+      if (latched_this_pulse) {
+        minimum(r.observed.latch_ns, width);
+      } else {
+        minimum(r.observed.high_ns, width);
+        if (v > r.observed.peak_shift_v)
+          r.observed.peak_shift_v = v;
+        if (nbits == bits) {
+          r.violations.push_back({e.t_ns, fmt("missed latch, pulse %.0f ns (RC at %.2f)", double(width), v)});
+          nbits = 0;
+        }
+      }
+      if (width < p.min_high_ns)
+        r.violations.push_back({e.t_ns, fmt("clock high %.0f ns < %.0f ns", double(width), p.min_high_ns)});
+    }
+    clk = e.level;
+    t_clk = e.t_ns;
+    have_clk = true;
+  }
+  return r;
+}
+
+SafeDelays minimum_delays(const Params &p, double safety)
+{
+  const unsigned bits = 8 * p.modules;
+  SafeDelays d;
+  d.data_ns = p.setup_ns * safety;
+  // Hold is covered by the clock pulse itself as long as DATA only moves
+  // after the falling edge, which is what the transfer loop does
+  double high = std::fmax(p.min_high_ns, p.hold_ns) * safety;
+
+  // Shortest gap that keeps the RC clear of the threshold over a frame;
+  // the peak only falls as the gap grows, so the first fit is the best
+  const double limit = p.threshold / safety;
+  const double longest = 100 * p.tau_discharge_ns;
+  double low = p.min_low_ns * safety;
+  while (low < longest && shift_peak(p, high, low, bits - 1) >= limit)
+    low *= 1.02;
+  if (low > longest)
+    low = longest;
+  d.clock_high_ns = high;
+  d.clock_low_ns  = low;
+  d.bit_ns        = d.data_ns + high + low;
+
+  // Latch pulse starts from the residual charge of the shift pulses, the
+  // worst case is a completely discharged RC
+  double v0 = 0;
+  d.latch_ns = safety * p.tau_charge_ns * std::log((1 - v0) / (1 - p.threshold));
+  d.frame_ns = (bits - 1) * d.bit_ns + d.data_ns + d.latch_ns + d.clock_low_ns;
+  return d;
+}
+
+} // namespace relayboard
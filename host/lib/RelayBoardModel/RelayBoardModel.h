@@ -0,0 +1,100 @@
+/**
+ * @brief RelayBoardModel - timing model of the SerialRelay board
+ *
+ *
+ * @notes:
+ * - The board has only DATA and CLOCK. CLOCK drives the shift register
+ * directly and, through an RC network and a Schmitt input, the output
+ * latch: short clock pulses shift, a long one charges the RC past the
+ * threshold and latches. That is why Trigger_relay holds the last
+ * clock pulse for SERIAL_RELAY_DELAY_LATCH.
+ *
+ * - The model replays a pin trace (PinTrace) edge by edge:
+ *   - shift register clocked on rising CLOCK, DATA setup/hold checked;
+ *   - RC voltage integrated exactly between edges (charges while CLOCK
+ *     is high, discharges while low); crossing `threshold` latches,
+ *     dropping under `rearm` re-arms the latch;
+ *   - every latch is checked against the frame length, so RC charge
+ *     left over by too short CLOCK_LOW gaps shows up as a spurious latch.
+ *
+ * - Parameters default to the values used by host/relaymodel; calibrate
+ * tau_* against the R/C of the board in use.
+ *
+ */
+#pragma once
+
+#include <PinTrace.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace relayboard
+{
+
+struct Params
+{
+  double setup_ns    = 100;     // DATA stable before rising CLOCK
+  double hold_ns     = 100;     // DATA stable after rising CLOCK
+  double min_high_ns = 500;     // Shortest clock pulse the shift register sees
+  double min_low_ns  = 500;
+  double tau_charge_ns    = 100000;   // RC charge time constant (CLOCK high)
+  double tau_discharge_ns = 10000;    // RC discharge time constant (CLOCK low)
+  double threshold   = 0.5;     // Latch when RC voltage / VCC crosses this
+  double rearm       = 0.25;    // Latch re-armed below this
+  unsigned modules   = 1;
+};
+
+struct Violation
+{
+  uint64_t    t_ns;
+  std::string what;
+};
+
+struct Observed
+{
+  // Smallest values seen in the trace (ns), UINT64_MAX if never seen
+  uint64_t setup_ns    = UINT64_MAX;
+  uint64_t hold_ns     = UINT64_MAX;
+  uint64_t high_ns     = UINT64_MAX;  // Shift pulses only
+  uint64_t low_ns      = UINT64_MAX;
+  uint64_t latch_ns    = UINT64_MAX;  // Latch pulses
+  double   peak_shift_v = 0;          // Highest RC voltage reached while shifting
+};
+
+struct Result
+{
+  std::vector<Violation> violations;
+  std::vector<std::vector<uint8_t>> latched;  // Output register at every latch
+  Observed observed;
+  unsigned frames = 0;
+};
+
+// Replay a trace through the board model
+Result simulate(const pintrace::Trace &trace, const Params &p);
+
+
+/**
+ * @brief Minimum safe delays for the Trigger_relay transfer loop
+ *
+ * Values in ns, already multiplied by the safety factor. clock_low is
+ * chosen to minimize the time per bit while the RC, pumped by a whole
+ * frame of shift pulses, stays below threshold / safety.
+ *
+ */
+struct SafeDelays
+{
+  double data_ns;
+  double clock_high_ns;
+  double clock_low_ns;
+  double latch_ns;
+  double bit_ns;        // data + clock_high + clock_low
+  double frame_ns;      // Whole frame including the latch
+};
+
+SafeDelays minimum_delays(const Params &p, double safety = 2.0);
+
+// RC voltage at the end of the n-th shift pulse of a frame, from 0 V
+double shift_peak(const Params &p, double high_ns, double low_ns, unsigned pulses);
+
+} // namespace relayboard
@@ -0,0 +1,128 @@
+#include "WorkPool.h"
+
+namespace
+{
+// The pool the calling thread works for, and its index there
+thread_local const WorkPool *tls_pool = nullptr;
+thread_local int tls_worker = -1;
+}
+
+WorkPool::WorkPool(unsigned threads)
+{
+  if (threads == 0)
+    threads = 1;
+  for (unsigned i = 0; i < threads; i++)
+    workers_.emplace_back(new Worker);
+  for (unsigned i = 0; i < threads; i++)
+    workers_[i]->thread = std::thread(&WorkPool::run, this, i);
+}
+
+WorkPool::~WorkPool()
+{
+  {
+    std::lock_guard<std::mutex> g(idle_lock_);
+    stop_ = true;
+  }
+  idle_cv_.notify_all();
+  for (auto &w : workers_)
+    w->thread.join();
+}
+
+int WorkPool::current_worker() const
+{
+  return tls_pool == this ? tls_worker : -1;
+}
+
+void WorkPool::submit(Task task)
+{
+  unsigned n = size();
+  const int self = current_worker();
+  unsigned target = self >= 0 ? unsigned(self) : next_.fetch_add(1, std::memory_order_relaxed) % n;
+  {
+    // Counted before the push so a fast thief can never drive them negative
+    std::lock_guard<std::mutex> g(idle_lock_);
+    pending_++;
+    queued_++;
+  }
+  {
+    std::lock_guard<std::mutex> g(workers_[target]->lock);
+    workers_[target]->tasks.push_back(std::move(task));
+  }
+  idle_cv_.notify_one();
+}
+
+void WorkPool::wait()
+{
+  std::unique_lock<std::mutex> g(idle_lock_);
+  done_cv_.wait(g, [this] { return pending_ == 0; });
+}
+
+bool WorkPool::pop_local(unsigned index, Task &task)
+{
+  Worker &w = *workers_[index];
+  std::lock_guard<std::mutex> g(w.lock);
+  if (w.tasks.empty())
+    return false;
+  task = std::move(w.tasks.back());
+  w.tasks.pop_back();
+  return true;
+}
+
+// With block false, deques locked by someone else are passed over
+bool WorkPool::steal(unsigned thief, Task &task, bool block)
+{
+  unsigned n = size();
+  for (unsigned k = 1; k < n; k++) {
+    Worker &victim = *workers_[(thief + k) % n];
+    std::unique_lock<std::mutex> g(victim.lock, std::defer_lock);
+    if (block)
+      g.lock();
+    else if (!g.try_lock())
+      continue;
+    if (victim.tasks.empty())
+      continue;
+    task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    steals_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void WorkPool::run(unsigned index)
+{
+  tls_pool = this;
+  tls_worker = int(index);
+  for (;;) {
+    Task task;
+    if (pop_local(index, task) || steal(index, task, false) || steal(index, task, true)) {
+      {
+        std::lock_guard<std::mutex> g(idle_lock_);
+        queued_--;
+      }
+      task();
+      bool last;
+      {
+        std::lock_guard<std::mutex> g(idle_lock_);
+        last = (--pending_ == 0);
+      }
+      if (last)
+        done_cv_.notify_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> g(idle_lock_);
+    if (stop_)
+      return;
+    if (queued_ > 0) {
+      // Counted by submit() but not in its deque yet, or just taken and
+      // not uncounted yet: give that thread the CPU rather than spin
+      g.unlock();
+      std::this_thread::yield();
+      continue;
+    }
+    idle_cv_.wait(g, [this] { return queued_ > 0 || stop_; });
+    if (stop_ && queued_ == 0)
+      return;
+  }
+}
@@ -0,0 +1,76 @@
+/**
+ * @brief WorkPool - work-stealing thread pool (host side)
+ *
+ *
+ * @notes:
+ * - Every worker owns a deque. It pushes/pops its own tasks at the back
+ * (LIFO, cache friendly) and, when it runs dry, steals from the front of
+ * the other workers' deques (FIFO, oldest and usually largest tasks).
+ *
+ * - Tasks submitted from outside the pool are dealt round-robin; tasks
+ * submitted from inside a task go to the calling worker's own deque, so
+ * recursive splitting stays local until someone steals it. A worker of
+ * another pool counts as outside.
+ *
+ * - An idle worker never spins: a steal pass that only found busy deques
+ * is repeated with blocking locks, and a task counted but not pushed yet
+ * is waited for with a yield, then the worker sleeps until a submit.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool
+{
+public:
+  typedef std::function<void()> Task;
+
+  explicit WorkPool(unsigned threads = std::thread::hardware_concurrency());
+  ~WorkPool();
+
+  WorkPool(const WorkPool &) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+
+  void submit(Task task);
+
+  // Block until every submitted task (and the tasks they spawned) is done
+  void wait();
+
+  unsigned size() const { return unsigned(workers_.size()); }
+  uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+  // Index of the calling worker, -1 outside this pool
+  int current_worker() const;
+
+private:
+  struct Worker
+  {
+    std::mutex       lock;
+    std::deque<Task> tasks;
+    std::thread      thread;
+  };
+
+  void run(unsigned index);
+  bool pop_local(unsigned index, Task &task);
+  bool steal(unsigned thief, Task &task, bool block);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<unsigned> next_{0};
+  std::atomic<uint64_t> steals_{0};
+
+  std::mutex              idle_lock_;
+  std::condition_variable idle_cv_;
+  std::condition_variable done_cv_;
+  uint64_t queued_  = 0;   // Tasks waiting in some deque (guarded by idle_lock_)
+  uint64_t pending_ = 0;   // Tasks submitted and not finished yet
+  bool     stop_    = false;
+};
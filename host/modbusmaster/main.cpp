@@ -0,0 +1,507 @@
+/**
+ * @brief modbusmaster - Modbus RTU master for ESTUFA controllers
+ *
+ *
+ * @notes:
+ * - Talks to the firmware built with FEATURE_MODBUS (src/main.cpp) over a
+ * serial port, or to a device emulated on a pseudo-terminal.
+ *
+ * - modbusmaster --port DEV [--baud B] [--address A] COMMAND
+ *   read-coils START COUNT      relay channels
+ *   write-coil COIL 0|1
+ *   read-regs START COUNT       zone schedules, 4 registers per zone
+ *   write-regs START V...
+ *   set-address NEW             store a new slave address (register 0x0400)
+ *   bench [--requests N]        back-to-back read-regs, RTT statistics
+ *   poll --addresses A-B [--cycles N] [--timeout MS]
+ *                               RS-485 bus: read every slave in turn, RTT per
+ *                               device and time per polling cycle
+ *   sync [--addresses A-B] [--rounds N] [--interval MS]
+ *                               discipline device clocks to this host's wall
+ *                               clock (ClockSync.h), offset/rate per round
+ *
+ * - modbusmaster selftest [--requests N] [--devices N]
+ *   Opens a pty pair and runs the firmware's ModbusSlave and EstufaCore
+ *   (native HAL) on the other end, then checks the register map, the
+ *   exception paths, the silent cases (bad CRC, other address) and the
+ *   address register, and runs the back-to-back bench through the pty.
+ *   Then the pty becomes a multidrop bus of N slaves (default 32) that
+ *   holds every answer back for the time the request and the response
+ *   take on the wire at --baud, and the poll loop must fit 1 s.
+ *   The emulated device clock runs 120 ppm fast from a random start: the
+ *   sync rounds must step it once, then slew it to within 1 ms and find
+ *   its rate, with device time never running backwards.
+ *
+ */
+#include <ClockSync.h>
+#include <EstufaCore.h>
+#include <HalNative.h>
+#include <ModbusRtu.h>
+#include <ModbusSlave.h>
+#include <TimeSync.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// The emulated device's crystal: 120 ppm fast, started at an arbitrary count
+struct DriftHal : HalNative
+{
+  static constexpr double drift_ppm = 120;
+
+  static uint32_t at_steady(double us)
+  {
+    return uint32_t(uint64_t(us * 1000 * (1 + drift_ppm * 1e-6)) + 0x9E3779B9u);
+  }
+  static uint32_t clock() { return at_steady(estufa::steady_us()); }
+};
+
+typedef EstufaCore<HalNative, 1> Core;
+typedef TimeSync<DriftHal> Clock;
+typedef ModbusSlave<Core, HalNative, Clock> Slave;
+
+struct Options
+{
+  std::string port;
+  unsigned baud = 115200;
+  uint8_t address = 1;
+  unsigned requests = 1000;
+  uint8_t first = 1, last = 32;   // poll range
+  unsigned devices = 32;
+  unsigned cycles = 10;
+  int timeout_ms = 100;
+  bool range = false;             // --addresses given
+  unsigned rounds = 12;
+  unsigned interval_ms = 500;
+};
+
+/**
+ * @brief The device end of the pty
+ *
+ * bus_size 0: one controller, the firmware's loop() (one request at a
+ * time, then the relay refresh). bus_size N: slaves 1..N on one bus, all
+ * served by the same core, each answer delayed by its wire time.
+ */
+void emulate_device(modbus::Port &port, std::atomic<bool> &stop, unsigned bus_size, unsigned baud)
+{
+  std::vector<uint8_t> req;
+  uint8_t resp[256];
+  uint32_t tx_stamp = 0;
+  while (!stop) {
+    Clock::poll();
+    Core::Config::poll();
+    if (!port.read_frame(req, 20))
+      continue;
+    // Stamps as the RX/UDRE interrupts take them: first byte in, first byte out
+    const uint32_t rx_stamp = DriftHal::at_steady(port.first_byte_us());
+    if (bus_size) {
+      if (req.empty() || req[0] == MODBUS_BROADCAST || req[0] > bus_size)
+        continue;
+      Slave::set_address(req[0]);
+    }
+    uint16_t n = Slave::handle(req.data(), uint16_t(req.size()), resp, sizeof(resp),
+                               rx_stamp, tx_stamp);
+    if (bus_size && n)
+      // 11 bits per character, request and response
+      std::this_thread::sleep_for(std::chrono::microseconds(
+          uint64_t(req.size() + n) * 11000000ULL / baud));
+    if (n) {
+      tx_stamp = DriftHal::clock();
+      port.write_frame(std::vector<uint8_t>(resp, resp + n));
+    }
+    if (Core::refresh_pending())
+      Core::send_relays();
+  }
+}
+
+int bench(modbus::Master &master, uint8_t address, unsigned requests)
+{
+  std::vector<double> rtt;
+  unsigned lost = 0, bad = 0;
+  for (unsigned i = 0; i < requests; i++) {
+    modbus::Result r = master.read_registers(address, 0, MODBUS_REGS_PER_ZONE);
+    if (!r.ok)
+      lost++;
+    else if (r.exception)
+      bad++;
+    else
+      rtt.push_back(r.rtt_us);
+  }
+  if (rtt.empty()) {
+    std::printf("bench: no answer in %u requests\n", requests);
+    return 1;
+  }
+  std::sort(rtt.begin(), rtt.end());
+  double sum = 0;
+  for (double v : rtt)
+    sum += v;
+  std::printf("bench: %u requests, %zu answered, %u lost, %u exceptions\n",
+              requests, rtt.size(), lost, bad);
+  std::printf("rtt us: min %.0f  avg %.0f  p99 %.0f  max %.0f  -> %.0f requests/s\n",
+              rtt.front(), sum / rtt.size(), rtt[rtt.size() * 99 / 100], rtt.back(),
+              1e6 / (sum / rtt.size()));
+  return lost || bad ? 1 : 0;
+}
+
+/**
+ * @brief Poll slaves first..last in turn, `cycles` times
+ *
+ * One read of zone 0's registers per slave and cycle; a slave that does
+ * not answer costs the master's timeout.
+ *
+ * @return 1 if a slave never answered or a cycle took longer than 1 s
+ */
+int poll(modbus::Master &master, uint8_t first, uint8_t last, unsigned cycles)
+{
+  struct Device
+  {
+    unsigned answered = 0, lost = 0;
+    double min = 1e30, max = 0, sum = 0;
+  };
+  std::vector<Device> dev(last - first + 1);
+  double cycle_max = 0, cycle_sum = 0;
+
+  for (unsigned c = 0; c < cycles; c++) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned a = first; a <= last; a++) {
+      Device &d = dev[a - first];
+      modbus::Result r = master.read_registers(uint8_t(a), 0, MODBUS_REGS_PER_ZONE);
+      if (!r.ok || r.exception) {
+        d.lost++;
+        continue;
+      }
+      d.answered++;
+      d.sum += r.rtt_us;
+      d.min = std::min(d.min, r.rtt_us);
+      d.max = std::max(d.max, r.rtt_us);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    cycle_sum += ms;
+    cycle_max = std::max(cycle_max, ms);
+  }
+
+  bool missing = false;
+  std::printf("addr  answered  lost  rtt_min_us  rtt_avg_us  rtt_max_us\n");
+  for (unsigned a = first; a <= last; a++) {
+    const Device &d = dev[a - first];
+    missing |= d.answered == 0;
+    if (d.answered)
+      std::printf("%4u  %8u  %4u  %10.0f  %10.0f  %10.0f\n", a, d.answered, d.lost,
+                  d.min, d.sum / d.answered, d.max);
+    else
+      std::printf("%4u  %8u  %4u  %10s  %10s  %10s\n", a, 0U, d.lost, "-", "-", "-");
+  }
+  std::printf("poll: %zu slaves, %u cycles, cycle avg %.1f ms max %.1f ms -> %s 1 s\n",
+              dev.size(), cycles, cycle_sum / cycles, cycle_max,
+              cycle_max <= 1000 ? "fits" : "exceeds");
+  return missing || cycle_max > 1000 ? 1 : 0;
+}
+
+/**
+ * @brief `rounds` sync rounds over the given slaves, `interval_ms` apart
+ *
+ * @return last round of the last slave
+ */
+modbus::ClockSync::Round sync(modbus::Master &master, uint8_t first, uint8_t last,
+                              unsigned rounds, unsigned interval_ms)
+{
+  std::vector<modbus::ClockSync> clocks;
+  for (unsigned a = first; a <= last; a++)
+    clocks.emplace_back(master, uint8_t(a));
+  modbus::ClockSync::Round r;
+  std::printf("round  addr  offset_us  delay_us  residual_ppm  rate_ppm  correction\n");
+  for (unsigned k = 0; k < rounds; k++) {
+    if (k)
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    for (unsigned a = first; a <= last; a++) {
+      r = clocks[a - first].round();
+      if (!r.ok) {
+        std::printf("%5u  %4u  no answer\n", k, a);
+        continue;
+      }
+      std::printf("%5u  %4u  %9.0f  %8.0f  %12.3f  %8.3f  %s%lld us\n", k, a, r.offset_us,
+                  r.delay_us, r.residual_ppb / 1000, r.rate_ppb / 1000.0,
+                  r.stepped ? "step " : "slew ", (long long)r.correction_us);
+    }
+  }
+  return r;
+}
+
+unsigned failures = 0;
+
+void expect(bool cond, const char *what)
+{
+  std::printf("%s %s\n", cond ? "ok  " : "FAIL", what);
+  failures += !cond;
+}
+
+int selftest(const Options &opt)
+{
+  int master_fd;
+  std::string slave_path, error;
+  modbus::Port device, host;
+  if (!estufa::open_pty(master_fd, slave_path, error) ||
+      !device.attach(master_fd, opt.baud, error) ||
+      !host.open(slave_path, opt.baud, error)) {
+    std::fprintf(stderr, "modbusmaster: %s\n", error.c_str());
+    return 2;
+  }
+
+  Core::load_schedules();
+  Core::begin();
+  Slave::begin(opt.address);
+  Clock::begin();
+  std::atomic<bool> stop(false);
+  std::thread dev(emulate_device, std::ref(device), std::ref(stop), 0U, opt.baud);
+  std::printf("device emulated on %s, address %u\n", slave_path.c_str(), opt.address);
+
+  modbus::Master m(host);
+  const uint8_t a = opt.address;
+  const ScheduleEntry z0 = schedule_to_entry(schedule_from_entry(SCHEDULE_TABLE[0]));
+
+  modbus::Result r = m.read_coils(a, 0, 4);
+  expect(r.ok && !r.exception && modbus::Master::coil_bits(r, 4)[0] == z0.start_on,
+         "read coils: channel 0 follows zone 0");
+
+  r = m.write_coil(a, 1, true);
+  expect(r.ok && !r.exception && r.pdu.size() == 5, "write coil 1 on: echoed");
+  r = m.read_coils(a, 0, 4);
+  expect(r.ok && modbus::Master::coil_bits(r, 4)[1] == 1, "read coils: channel 1 on by hand");
+
+  r = m.read_registers(a, 0, 4);
+  std::vector<uint16_t> regs = modbus::Master::registers(r);
+  expect(regs.size() == 4 && regs[0] == z0.light_hours && regs[1] == z0.dark_hours &&
+         regs[2] == z0.start_on && regs[3] == z0.start_hours,
+         "read registers: zone 0 schedule");
+
+  r = m.write_registers(a, 0, {12, 12, 0, 3});
+  expect(r.ok && !r.exception, "write registers: zone 0 = 12/12, dark, 3 h in");
+  regs = modbus::Master::registers(m.read_registers(a, 0, 4));
+  expect(regs == std::vector<uint16_t>({12, 12, 0, 3}), "read registers: new schedule");
+
+  r = m.write_registers(a, 0, {0, 12});
+  expect(r.ok && r.exception == MODBUS_ILLEGAL_VALUE, "write registers: 0 light hours rejected");
+  regs = modbus::Master::registers(m.read_registers(a, 0, 4));
+  expect(regs == std::vector<uint16_t>({12, 12, 0, 3}), "read registers: unchanged after reject");
+
+  // Two zone writes inside the hold-off: one write-back of the changed bytes
+  auto storage = [&](uint8_t addr) { return modbus::Master::registers(m.read_registers(addr, MODBUS_REG_STORAGE, 5)); };
+  const auto settle = std::chrono::milliseconds(3 * CONFIG_CACHE_HOLDOFF_MS);
+  std::this_thread::sleep_for(settle);
+  std::vector<uint16_t> s0 = storage(a);
+  m.write_registers(a, 0, {10, 14, 1, 2});
+  m.write_registers(a, 0, {11, 13, 0, 4});
+  std::this_thread::sleep_for(settle);
+  std::vector<uint16_t> s1 = storage(a);
+  expect(s0.size() == 5 && s1.size() == 5 && s1[1] - s0[1] == 1 && s1[3] - s0[3] <= 5,
+         "config cache: two zone writes, one write-back of at most entry + CRC");
+
+  r = m.read_coils(a, Core::channels, 1);
+  expect(r.ok && r.exception == MODBUS_ILLEGAL_ADDRESS, "read coils past the chain: exception 02");
+  r = m.transact(a, {0x2B, 0x0E, 0x01, 0x00, 0x00});
+  expect(r.ok && r.exception == MODBUS_ILLEGAL_FUNCTION, "unknown function: exception 01");
+  r = m.transact(a, {0x07});
+  expect(r.ok && r.exception == MODBUS_ILLEGAL_FUNCTION, "short unsupported 0x07: exception 01");
+  r = m.transact(a, {0x11});
+  expect(r.ok && r.exception == MODBUS_ILLEGAL_FUNCTION, "short unsupported 0x11: exception 01");
+  r = m.transact(a, {MODBUS_READ_HOLDING, 0, 0});
+  expect(r.ok && r.exception == MODBUS_ILLEGAL_VALUE, "short read registers: exception 03");
+
+  r = m.read_registers(uint8_t(a + 1), 0, 1);
+  expect(!r.ok, "other address: no answer");
+  std::vector<uint8_t> corrupt = modbus::make_frame(a, {MODBUS_READ_HOLDING, 0, 0, 0, 1});
+  corrupt.back() ^= 0x55;
+  std::vector<uint8_t> resp;
+  host.write_frame(corrupt);
+  expect(!host.read_frame(resp, 100), "bad CRC: no answer");
+
+  r = m.transact(MODBUS_BROADCAST, {MODBUS_WRITE_COIL, 0, 2, 0xFF, 0});
+  expect(r.ok && modbus::Master::coil_bits(m.read_coils(a, 0, 4), 4)[2] == 1,
+         "broadcast write coil 2: applied, unanswered");
+
+  r = m.write_register(a, MODBUS_REG_ADDRESS, 0);
+  expect(r.ok && r.exception == MODBUS_ILLEGAL_VALUE, "address 0 rejected");
+  r = m.write_register(a, MODBUS_REG_ADDRESS, 17);
+  expect(r.ok && !r.exception && r.pdu.size() == 5, "set address 17: answered from the old one");
+  regs = modbus::Master::registers(m.read_registers(17, MODBUS_REG_ADDRESS, 1));
+  expect(regs == std::vector<uint16_t>({17}), "address register reads 17 at 17");
+  expect(!m.read_registers(a, 0, 1).ok, "old address silent");
+  uint8_t stored;
+  HalNative::storage_read(MODBUS_ADDRESS_STORAGE, &stored, 1);
+  expect(stored == 17, "address stored");
+  regs = modbus::Master::registers(m.read_registers(17, MODBUS_REG_STORAGE, 5));
+  expect(regs.size() == 5 && regs[0] == 0 && regs[1] >= 1 && regs[2] == 0 && regs[3] >= 1,
+         "storage stats: address write done");
+  m.write_register(17, MODBUS_REG_ADDRESS, a);
+
+  int rc = bench(m, a, opt.requests);
+
+  // Time sync against the drifting device clock
+  {
+    std::vector<modbus::ClockSync::Round> rounds;
+    modbus::ClockSync cs(m, a);
+    uint64_t last_t2 = 0;
+    bool monotonic = true;
+    std::printf("round  offset_us  delay_us  residual_ppm  rate_ppm  correction\n");
+    for (unsigned k = 0; k < opt.rounds; k++) {
+      if (k)
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.interval_ms));
+      std::vector<uint16_t> t = modbus::Master::registers(m.read_registers(a, MODBUS_REG_TIME, 4));
+      if (t.size() == 4) {
+        uint64_t t2 = uint64_t(t[0]) << 48 | uint64_t(t[1]) << 32 | uint64_t(t[2]) << 16 | t[3];
+        monotonic &= k < 2 || t2 > last_t2;    // the step is in round 0
+        last_t2 = t2;
+      }
+      rounds.push_back(cs.round());
+      const modbus::ClockSync::Round &r = rounds.back();
+      std::printf("%5u  %9.0f  %8.0f  %12.3f  %8.3f  %s%lld us\n", k, r.offset_us, r.delay_us,
+                  r.residual_ppb / 1000, r.rate_ppb / 1000.0, r.stepped ? "step " : "slew ",
+                  (long long)r.correction_us);
+    }
+    bool all_ok = true, one_step = rounds.size() > 1 && rounds[0].stepped;
+    for (size_t k = 0; k < rounds.size(); k++) {
+      all_ok &= rounds[k].ok;
+      one_step &= k == 0 || !rounds[k].stepped;
+    }
+    const modbus::ClockSync::Round &end = rounds.back();
+    expect(all_ok, "sync: every round answered");
+    expect(one_step, "sync: stepped once, then slewed");
+    expect(monotonic, "sync: device time never ran backwards after the step");
+    expect(std::fabs(end.offset_us) < 1000, "sync: offset within 1 ms");
+    expect(std::fabs(end.rate_ppb / 1000.0 + DriftHal::drift_ppm) < 20,
+           "sync: rate within 20 ppm of the crystal error");
+  }
+
+  stop = true;
+  dev.join();
+
+  // The same pty as a multidrop bus
+  if (opt.devices) {
+    std::printf("bus: %u slaves at %u baud (wire time emulated)\n", opt.devices, opt.baud);
+    stop = false;
+    std::thread bus(emulate_device, std::ref(device), std::ref(stop), opt.devices, opt.baud);
+    modbus::Master pm(host, 20);
+    rc |= poll(pm, 1, uint8_t(opt.devices), opt.cycles);
+    stop = true;
+    bus.join();
+  }
+  expect(Core::load_schedules() == SCHEDULE_IMAGE_OK &&
+         Core::zone(0).light_hours == 11 && Core::zone(0).start_hours == 4,
+         "config cache: image in storage holds the zone writes");
+  std::printf("%s: %u failure(s)\n", failures || rc ? "FAILED" : "PASSED", failures);
+  return failures || rc ? 1 : 0;
+}
+
+int usage()
+{
+  std::fprintf(stderr,
+               "usage: modbusmaster --port DEV [--baud B] [--address A] COMMAND\n"
+               "         read-coils START COUNT | write-coil COIL 0|1 |\n"
+               "         read-regs START COUNT | write-regs START V... | set-address NEW |\n"
+               "         bench [--requests N] | poll --addresses A-B [--cycles N] [--timeout MS]\n"
+               "         sync [--addresses A-B] [--rounds N] [--interval MS]\n"
+               "       modbusmaster selftest [--requests N] [--devices N] [--rounds N] [--interval MS]\n");
+  return 2;
+}
+
+void print_result(const modbus::Result &r)
+{
+  if (!r.ok)
+    std::printf("no answer\n");
+  else if (r.exception)
+    std::printf("exception %02X (%.0f us)\n", r.exception, r.rtt_us);
+  else {
+    for (uint8_t b : r.pdu)
+      std::printf("%02X ", b);
+    std::printf("(%.0f us)\n", r.rtt_us);
+  }
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    if (!std::strcmp(argv[i], "--port") && i + 1 < argc)          opt.port = argv[++i];
+    else if (!std::strcmp(argv[i], "--baud") && i + 1 < argc)     opt.baud = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--address") && i + 1 < argc)  opt.address = uint8_t(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--requests") && i + 1 < argc) opt.requests = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--devices") && i + 1 < argc)  opt.devices = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--cycles") && i + 1 < argc)   opt.cycles = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--timeout") && i + 1 < argc)  opt.timeout_ms = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--rounds") && i + 1 < argc)   opt.rounds = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--interval") && i + 1 < argc) opt.interval_ms = unsigned(std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--addresses") && i + 1 < argc) {
+      unsigned f = 0, l = 0;
+      if (std::sscanf(argv[++i], "%u-%u", &f, &l) != 2 || !f || f > l || l > MODBUS_MAX_ADDRESS)
+        return usage();
+      opt.first = uint8_t(f);
+      opt.last = uint8_t(l);
+      opt.range = true;
+    }
+    else args.push_back(argv[i]);
+  }
+  if (args.empty())
+    return usage();
+  if (args[0] == "selftest")
+    return selftest(opt);
+  if (opt.port.empty())
+    return usage();
+
+  modbus::Port port;
+  std::string error;
+  if (!port.open(opt.port, opt.baud, error)) {
+    std::fprintf(stderr, "modbusmaster: %s\n", error.c_str());
+    return 2;
+  }
+  modbus::Master m(port, opt.timeout_ms);
+  auto num = [&](size_t i) { return i < args.size() ? uint16_t(std::atoi(args[i].c_str())) : 0; };
+
+  if (args[0] == "bench")
+    return bench(m, opt.address, opt.requests);
+  if (args[0] == "poll")
+    return poll(m, opt.first, opt.last, opt.cycles ? opt.cycles : 1);
+  if (args[0] == "sync") {
+    const uint8_t first = opt.range ? opt.first : opt.address, last = opt.range ? opt.last : opt.address;
+    return sync(m, first, last, opt.rounds, opt.interval_ms).ok ? 0 : 1;
+  }
+  if (args[0] == "set-address" && args.size() == 2) {
+    print_result(m.write_register(opt.address, MODBUS_REG_ADDRESS, num(1)));
+    return 0;
+  }
+  if (args[0] == "read-coils" && args.size() == 3) {
+    modbus::Result r = m.read_coils(opt.address, num(1), num(2));
+    for (uint8_t b : modbus::Master::coil_bits(r, num(2)))
+      std::printf("%u", b);
+    std::printf("\n");
+    print_result(r);
+  } else if (args[0] == "write-coil" && args.size() == 3)
+    print_result(m.write_coil(opt.address, num(1), num(2) != 0));
+  else if (args[0] == "read-regs" && args.size() == 3) {
+    modbus::Result r = m.read_registers(opt.address, num(1), num(2));
+    for (uint16_t v : modbus::Master::registers(r))
+      std::printf("%u ", v);
+    std::printf("\n");
+    print_result(r);
+  } else if (args[0] == "write-regs" && args.size() >= 3) {
+    std::vector<uint16_t> values;
+    for (size_t i = 2; i < args.size(); i++)
+      values.push_back(num(i));
+    print_result(m.write_registers(opt.address, num(1), values));
+  } else
+    return usage();
+  return 0;
+}
@@ -0,0 +1,532 @@
+/**
+ * @brief optimizer - cheapest light schedule under a time-of-use tariff
+ *
+ *
+ * @notes:
+ * - Every zone gets one block of `light_hours` per day, repeated daily, so
+ * its dark period is 24 - light_hours and must be >= the minimum dark
+ * hours. The only free variable per zone is the hour the block starts,
+ * and its energy cost is load_kw * (sum of the tariff over that block
+ * for every day of the tariff horizon).
+ *
+ * - Without a site power cap every zone simply takes its cheapest start.
+ * With --cap the zones compete for hours: a greedy pass places the
+ * biggest loads first, then improvement rounds evaluate the best
+ * relocation of every zone in parallel (WorkPool, one task per slice of
+ * zones) and apply the winners in cost order, re-checking the cap.
+ *
+ * - Output is the format the firmware consumes (lib/LightSchedule/
+ * ScheduleTable.h): a constexpr header for include/schedule_table.h and
+ * an Intel HEX EEPROM image for `avrdude -U eeprom:w:<file>:i`.
+ * One controller drives --zones-per-controller N zones, the target's
+ * SCHEDULE_MAX_ZONES: 4 on the UNO (one SerialRelay module), 32 on the
+ * MEGA (env:mega). --controller K picks zones [K*N, K*N+N).
+ *
+ * - The firmware only takes an EEPROM image holding exactly its compiled
+ * SCHEDULE_ZONES entries. A full slice matches a build made with a full
+ * slice header; the last controller's slice can be short, so its image
+ * is only written together with --header, for a build from that header.
+ *
+ * - The firmware counts hours from boot (hour 0 = Timer1 start), not from
+ * midnight: the emitted table places each block for a controller
+ * started at --boot-hour H (local time, default 0 = midnight). Started
+ * at another hour, every block runs shifted by the difference.
+ *
+ * - optimizer --tariff FILE --zones FILE [--min-dark H] [--cap KW]
+ *             [--threads T] [--controller K] [--zones-per-controller N]
+ *             [--boot-hour H] [--header FILE] [--eeprom FILE]
+ *   optimizer bench [zones] [days]
+ *
+ *   tariff: hourly prices, one per line or comma separated, 24*days values
+ *   zones:  "light_hours,load_kw[,min_dark_hours]" per line, '#' comments
+ *
+ */
+#include <ScheduleTable.h>
+#include <WorkPool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const int DAY_HOURS = 24;
+
+struct Zone
+{
+  int    light_hours;
+  double load_kw;
+  int    min_dark;
+};
+
+struct Plan
+{
+  std::vector<int> start;           // Start hour per zone, -1 = infeasible
+  double cost = 0;                  // Over the whole tariff horizon
+  double peak_kw = 0;
+};
+
+struct Problem
+{
+  std::vector<double> price;        // Tariff, per hour of the horizon
+  double daily[DAY_HOURS] = {};     // Sum of the tariff for each hour of day
+  std::vector<Zone> zones;
+  double cap_kw = 0;                // 0 = no site cap
+  int min_dark = 6;
+};
+
+// Cost of `hours` lit hours starting at `start`, summed over the horizon
+double block_price(const Problem &p, int start, int hours)
+{
+  double sum = 0;
+  for (int k = 0; k < hours; k++)
+    sum += p.daily[(start + k) % DAY_HOURS];
+  return sum;
+}
+
+bool zone_feasible(const Zone &z)
+{
+  return z.light_hours > 0 && DAY_HOURS - z.light_hours >= z.min_dark &&
+         DAY_HOURS - z.light_hours > 0;
+}
+
+bool fits(const double *load, const Zone &z, int start, double cap)
+{
+  if (cap <= 0)
+    return true;
+  for (int k = 0; k < z.light_hours; k++)
+    if (load[(start + k) % DAY_HOURS] + z.load_kw > cap + 1e-9)
+      return false;
+  return true;
+}
+
+void add_load(double *load, const Zone &z, int start, double sign)
+{
+  for (int k = 0; k < z.light_hours; k++)
+    load[(start + k) % DAY_HOURS] += sign * z.load_kw;
+}
+
+
+/**
+ * @brief Solve one problem instance
+ *
+ */
+Plan optimize(const Problem &p, WorkPool &pool)
+{
+  const size_t n = p.zones.size();
+  // Window price per (light hours, start) is shared by all zones
+  std::vector<std::vector<double>> window(DAY_HOURS + 1, std::vector<double>(DAY_HOURS));
+  for (int h = 1; h <= DAY_HOURS; h++)
+    for (int s = 0; s < DAY_HOURS; s++)
+      window[h][s] = block_price(p, s, h);
+
+  Plan plan;
+  plan.start.assign(n, -1);
+  double load[DAY_HOURS] = {};
+
+  // Best unconstrained start per zone, computed in parallel slices
+  const size_t slice = std::max<size_t>(1, n / (pool.size() * 8));
+  for (size_t first = 0; first < n; first += slice) {
+    size_t last = std::min(n, first + slice);
+    pool.submit([&, first, last] {
+      for (size_t i = first; i < last; i++) {
+        const Zone &z = p.zones[i];
+        if (!zone_feasible(z))
+          continue;
+        const std::vector<double> &w = window[z.light_hours];
+        plan.start[i] = int(std::min_element(w.begin(), w.end()) - w.begin());
+      }
+    });
+  }
+  pool.wait();
+
+  if (p.cap_kw > 0) {
+    // Greedy: biggest energy first, cheapest start that still fits
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return p.zones[a].load_kw * p.zones[a].light_hours >
+             p.zones[b].load_kw * p.zones[b].light_hours;
+    });
+    for (size_t i : order) {
+      const Zone &z = p.zones[i];
+      plan.start[i] = -1;
+      if (!zone_feasible(z))
+        continue;
+      const std::vector<double> &w = window[z.light_hours];
+      int best = -1;
+      for (int s = 0; s < DAY_HOURS; s++)
+        if (fits(load, z, s, p.cap_kw) && (best < 0 || w[s] < w[best]))
+          best = s;
+      if (best >= 0) {
+        plan.start[i] = best;
+        add_load(load, z, best, 1);
+      }
+    }
+
+    // Improvement rounds: parallel move evaluation, sequential commit
+    struct Move { size_t zone; int start; double gain; };
+    for (int round = 0; round < 32; round++) {
+      std::vector<std::vector<Move>> found(n / slice + 1);
+      for (size_t first = 0, k = 0; first < n; first += slice, k++) {
+        size_t last = std::min(n, first + slice);
+        pool.submit([&, first, last, k] {
+          double local[DAY_HOURS];
+          for (size_t i = first; i < last; i++) {
+            int cur = plan.start[i];
+            if (cur < 0)
+              continue;
+            const Zone &z = p.zones[i];
+            std::copy(load, load + DAY_HOURS, local);
+            add_load(local, z, cur, -1);
+            const std::vector<double> &w = window[z.light_hours];
+            int best = cur;
+            for (int s = 0; s < DAY_HOURS; s++)
+              if (w[s] < w[best] - 1e-12 && fits(local, z, s, p.cap_kw))
+                best = s;
+            if (best != cur)
+              found[k].push_back({i, best, z.load_kw * (w[cur] - w[best])});
+          }
+        });
+      }
+      pool.wait();
+
+      std::vector<Move> moves;
+      for (auto &f : found)
+        moves.insert(moves.end(), f.begin(), f.end());
+      // Relocations may have opened room for zones the greedy pass dropped
+      size_t placed = 0;
+      for (size_t i : order) {
+        const Zone &z = p.zones[i];
+        if (plan.start[i] >= 0 || !zone_feasible(z))
+          continue;
+        const std::vector<double> &w = window[z.light_hours];
+        int best = -1;
+        for (int s = 0; s < DAY_HOURS; s++)
+          if (fits(load, z, s, p.cap_kw) && (best < 0 || w[s] < w[best]))
+            best = s;
+        if (best >= 0) {
+          plan.start[i] = best;
+          add_load(load, z, best, 1);
+          placed++;
+        }
+      }
+      if (moves.empty() && !placed)
+        break;
+      std::sort(moves.begin(), moves.end(),
+                [](const Move &a, const Move &b) { return a.gain > b.gain; });
+      size_t applied = 0;
+      for (const Move &m : moves) {
+        const Zone &z = p.zones[m.zone];
+        add_load(load, z, plan.start[m.zone], -1);
+        if (fits(load, z, m.start, p.cap_kw)) {
+          plan.start[m.zone] = m.start;
+          applied++;
+        }
+        add_load(load, z, plan.start[m.zone], 1);
+      }
+      if (!applied && !placed)
+        break;
+    }
+  }
+
+  std::fill(load, load + DAY_HOURS, 0.0);
+  for (size_t i = 0; i < n; i++) {
+    if (plan.start[i] < 0)
+      continue;
+    const Zone &z = p.zones[i];
+    plan.cost += z.load_kw * window[z.light_hours][plan.start[i]];
+    add_load(load, z, plan.start[i], 1);
+  }
+  plan.peak_kw = *std::max_element(load, load + DAY_HOURS);
+  return plan;
+}
+
+// Where a zone starting its block at `start` is at hour 0 (boot)
+// `start` as an hour of the day; hour 0 of the entry is `boot_hour`
+ScheduleEntry to_entry(const Zone &z, int start, int boot_hour)
+{
+  start = (start - boot_hour + DAY_HOURS) % DAY_HOURS;
+  ScheduleEntry e;
+  e.light_hours = uint8_t(z.light_hours);
+  e.dark_hours  = uint8_t(DAY_HOURS - z.light_hours);
+  if (start == 0) {
+    e.start_on = 1;
+    e.start_hours = 0;
+  } else if (start + z.light_hours > DAY_HOURS) {
+    // Block wraps past midnight: lit at hour 0 since `start` yesterday
+    e.start_on = 1;
+    e.start_hours = uint8_t(DAY_HOURS - start);
+  } else {
+    e.start_on = 0;
+    e.start_hours = uint8_t(DAY_HOURS - start - z.light_hours);
+  }
+  return e;
+}
+
+
+/**
+ * @brief Output writers
+ *
+ */
+bool write_header(const char *path, const std::vector<ScheduleEntry> &entries, double cost, int boot_hour)
+{
+  FILE *f = std::fopen(path, "w");
+  if (!f)
+    return false;
+  std::fprintf(f,
+    "/**\n"
+    " * @brief Zone schedule table\n"
+    " * Generated by host/optimizer, tariff cost %.2f. Do not edit.\n"
+    " * Hour 0 is the controller's boot, assumed at %02d:00.\n"
+    " *\n"
+    " */\n"
+    "#pragma once\n\n"
+    "#include <ScheduleTable.h>\n\n"
+    "#define SCHEDULE_ZONES %zu\n\n"
+    "// {light_hours, dark_hours, start_on, start_hours}\n"
+    "constexpr ScheduleEntry SCHEDULE_TABLE[SCHEDULE_ZONES] = {\n",
+    cost, boot_hour, entries.size());
+  for (size_t i = 0; i < entries.size(); i++)
+    std::fprintf(f, "  {%2u, %2u, %u, %2u}%s\n", entries[i].light_hours, entries[i].dark_hours,
+                 entries[i].start_on, entries[i].start_hours,
+                 i + 1 < entries.size() ? "," : "");
+  std::fprintf(f, "};\n");
+  return std::fclose(f) == 0;
+}
+
+bool write_eeprom_hex(const char *path, const std::vector<ScheduleEntry> &entries)
+{
+  std::vector<uint8_t> image;
+  ScheduleImageHeader hdr = {{'E', 'S'}, SCHEDULE_IMAGE_VERSION, uint8_t(entries.size())};
+  const uint8_t *h = reinterpret_cast<const uint8_t *>(&hdr);
+  image.insert(image.end(), h, h + sizeof(hdr));
+  const uint8_t *e = reinterpret_cast<const uint8_t *>(entries.data());
+  image.insert(image.end(), e, e + entries.size() * sizeof(ScheduleEntry));
+  image.push_back(schedule_crc8(image.data(), uint16_t(image.size())));
+
+  FILE *f = std::fopen(path, "w");
+  if (!f)
+    return false;
+  for (size_t off = 0; off < image.size(); off += 16) {
+    size_t len = std::min<size_t>(16, image.size() - off);
+    uint16_t addr = uint16_t(SCHEDULE_EEPROM_ADDR + off);
+    uint8_t sum = uint8_t(len + (addr >> 8) + (addr & 0xff));
+    std::fprintf(f, ":%02X%04X00", unsigned(len), addr);
+    for (size_t i = 0; i < len; i++) {
+      std::fprintf(f, "%02X", image[off + i]);
+      sum += image[off + i];
+    }
+    std::fprintf(f, "%02X\n", uint8_t(-sum));
+  }
+  std::fprintf(f, ":00000001FF\n");
+  return std::fclose(f) == 0;
+}
+
+
+/**
+ * @brief Input readers
+ *
+ */
+bool read_tariff(const char *path, Problem &p)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string tok;
+  while (std::getline(in, tok)) {
+    if (tok.empty() || tok[0] == '#')
+      continue;
+    std::replace(tok.begin(), tok.end(), ',', ' ');
+    std::istringstream ss(tok);
+    double v;
+    while (ss >> v)
+      p.price.push_back(v);
+  }
+  return !p.price.empty() && p.price.size() % DAY_HOURS == 0;
+}
+
+bool read_zones(const char *path, Problem &p)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream ss(line);
+    Zone z;
+    z.min_dark = p.min_dark;
+    if (!(ss >> z.light_hours >> z.load_kw))
+      return false;
+    ss >> z.min_dark;
+    p.zones.push_back(z);
+  }
+  return !p.zones.empty();
+}
+
+void finish_problem(Problem &p)
+{
+  std::fill(p.daily, p.daily + DAY_HOURS, 0.0);
+  for (size_t t = 0; t < p.price.size(); t++)
+    p.daily[t % DAY_HOURS] += p.price[t];
+}
+
+// Two-peak synthetic tariff (cheap nights, expensive evenings) with noise
+void synthetic(Problem &p, size_t zones, int days)
+{
+  uint32_t seed = 7;
+  auto rnd = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.0; };
+  p.price.resize(size_t(days) * DAY_HOURS);
+  for (size_t t = 0; t < p.price.size(); t++) {
+    int h = int(t % DAY_HOURS);
+    double base = (h >= 17 && h < 21) ? 0.42 : (h >= 7 && h < 17) ? 0.25 : 0.11;
+    p.price[t] = base * (0.9 + 0.2 * rnd());
+  }
+  static const int LIGHT[] = {12, 14, 16, 18};
+  p.zones.resize(zones);
+  double total = 0;
+  for (Zone &z : p.zones) {
+    z.light_hours = LIGHT[int(rnd() * 4) & 3];
+    z.load_kw = 0.5 + 2.0 * rnd();
+    z.min_dark = p.min_dark;
+    total += z.load_kw * z.light_hours;
+  }
+  // Cap at 150 % of a perfectly flat profile, so cheap hours are contested
+  p.cap_kw = 1.5 * total / DAY_HOURS;
+  finish_problem(p);
+}
+
+int cmd_bench(size_t max_zones, int days)
+{
+  unsigned threads = std::thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+  std::printf("%d day tariff, site cap = 150%% of flat load\n", days);
+  std::printf("   zones  threads  seconds  zones/s     cost      peak_kW  unplaced\n");
+  for (size_t zones = 1000; zones <= max_zones; zones *= 10) {
+    for (unsigned t = 1;; t = std::min(t * 2, threads)) {
+      Problem p;
+      synthetic(p, zones, days);
+      WorkPool pool(t);
+      auto t0 = std::chrono::steady_clock::now();
+      Plan plan = optimize(p, pool);
+      double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      size_t unplaced = size_t(std::count(plan.start.begin(), plan.start.end(), -1));
+      std::printf("%8zu  %7u  %7.3f  %7.0f  %10.1f  %9.1f  %8zu\n", zones, t, dt,
+                  zones / dt, plan.cost, plan.peak_kw, unplaced);
+      if (t == threads)
+        break;
+    }
+  }
+  return 0;
+}
+
+void usage()
+{
+  std::fprintf(stderr,
+    "usage: optimizer --tariff FILE --zones FILE [--min-dark H] [--cap KW]\n"
+    "                 [--threads T] [--controller K] [--zones-per-controller N]\n"
+    "                 [--boot-hour H] [--header FILE] [--eeprom FILE]\n"
+    "       optimizer bench [zones] [days]\n");
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  if (argc >= 2 && !std::strcmp(argv[1], "bench"))
+    return cmd_bench(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000,
+                     argc > 3 ? std::atoi(argv[3]) : 30);
+
+  Problem p;
+  const char *tariff = nullptr, *zones = nullptr, *header = nullptr, *eeprom = nullptr;
+  unsigned threads = std::thread::hardware_concurrency();
+  unsigned controller = 0;
+  unsigned per_controller = SCHEDULE_MAX_ZONES;
+  int boot_hour = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char *a = argv[i], *v = argv[i + 1];
+    if (!std::strcmp(a, "--tariff"))          tariff = v;
+    else if (!std::strcmp(a, "--zones"))      zones = v;
+    else if (!std::strcmp(a, "--min-dark"))   p.min_dark = std::atoi(v);
+    else if (!std::strcmp(a, "--cap"))        p.cap_kw = std::atof(v);
+    else if (!std::strcmp(a, "--threads"))    threads = unsigned(std::atoi(v));
+    else if (!std::strcmp(a, "--controller")) controller = unsigned(std::atoi(v));
+    else if (!std::strcmp(a, "--zones-per-controller")) per_controller = unsigned(std::atoi(v));
+    else if (!std::strcmp(a, "--boot-hour"))  boot_hour = std::atoi(v);
+    else if (!std::strcmp(a, "--header"))     header = v;
+    else if (!std::strcmp(a, "--eeprom"))     eeprom = v;
+    else { usage(); return 2; }
+  }
+  if (!tariff || !zones || per_controller < 1 || per_controller > 255 ||
+      boot_hour < 0 || boot_hour >= DAY_HOURS) {
+    usage();
+    return 2;
+  }
+  if (!read_tariff(tariff, p)) {
+    std::fprintf(stderr, "optimizer: %s: need 24*days hourly prices\n", tariff);
+    return 1;
+  }
+  if (!read_zones(zones, p)) {
+    std::fprintf(stderr, "optimizer: %s: bad zone list\n", zones);
+    return 1;
+  }
+  finish_problem(p);
+
+  WorkPool pool(threads ? threads : 1);
+  Plan plan = optimize(p, pool);
+
+  std::printf("zone  light  dark  start  load_kW\n");
+  bool ok = true;
+  for (size_t i = 0; i < p.zones.size(); i++) {
+    const Zone &z = p.zones[i];
+    if (plan.start[i] < 0) {
+      std::printf("%4zu  %5d     -  infeasible\n", i, z.light_hours);
+      ok = false;
+      continue;
+    }
+    std::printf("%4zu  %5d  %4d  %02d:00  %7.2f\n", i, z.light_hours,
+                DAY_HOURS - z.light_hours, plan.start[i], z.load_kw);
+  }
+  std::printf("cost over %zu days: %.2f, peak %.2f kW\n",
+              p.price.size() / DAY_HOURS, plan.cost, plan.peak_kw);
+
+  std::vector<ScheduleEntry> entries;
+  for (size_t i = size_t(controller) * per_controller;
+       i < p.zones.size() && entries.size() < per_controller; i++)
+    if (plan.start[i] >= 0)
+      entries.push_back(to_entry(p.zones[i], plan.start[i], boot_hour));
+  if ((header || eeprom) && (!ok || entries.empty())) {
+    std::fprintf(stderr, "optimizer: no feasible schedule for controller %u\n", controller);
+    return 1;
+  }
+  if (eeprom && !header && entries.size() != per_controller) {
+    std::fprintf(stderr, "optimizer: controller %u gets %zu of %u zones: its EEPROM image "
+                         "needs firmware built for %zu, write --header too\n",
+                 controller, entries.size(), per_controller, entries.size());
+    return 1;
+  }
+  if (header && !write_header(header, entries, plan.cost, boot_hour)) {
+    std::perror(header);
+    return 1;
+  }
+  if (eeprom && !write_eeprom_hex(eeprom, entries)) {
+    std::perror(eeprom);
+    return 1;
+  }
+  return ok ? 0 : 1;
+}
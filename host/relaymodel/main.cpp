@@ -0,0 +1,111 @@
+/**
+ * @brief relaymodel - validate relay bus timing against the board model
+ *
+ *
+ * @notes:
+ * - Replays a pin trace (simavr VCD from [env:uno_sim] or a text trace)
+ * through host/lib/RelayBoardModel, lists setup/hold/pulse/latch
+ * violations, the tightest timings observed, and the minimum safe
+ * SERIAL_RELAY_DELAY_* values for a faster transfer profile. They are
+ * only as good as the RC values given: the defaults are placeholders.
+ *
+ * - relaymodel [--trace FILE] [--modules M] [--safety S]
+ *              [--setup-ns N] [--hold-ns N] [--min-high-ns N] [--min-low-ns N]
+ *              [--tau-charge-us U] [--tau-discharge-us U]
+ *              [--threshold V] [--rearm V]
+ *   Without --trace only the safe delays are computed.
+ *
+ */
+#include <PinTrace.h>
+#include <RelayBoardModel.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+void print_ns(const char *name, uint64_t v)
+{
+  if (v == UINT64_MAX)
+    std::printf("  %-12s        -\n", name);
+  else
+    std::printf("  %-12s %9.3f us\n", name, v / 1000.0);
+}
+
+void usage()
+{
+  std::fprintf(stderr,
+    "usage: relaymodel [--trace FILE] [--modules M] [--safety S]\n"
+    "                  [--setup-ns N] [--hold-ns N] [--min-high-ns N] [--min-low-ns N]\n"
+    "                  [--tau-charge-us U] [--tau-discharge-us U] [--threshold V] [--rearm V]\n");
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  relayboard::Params p;
+  const char *path = nullptr;
+  double safety = 2.0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char *a = argv[i];
+    double v = std::atof(argv[i + 1]);
+    if (!std::strcmp(a, "--trace"))                 path = argv[i + 1];
+    else if (!std::strcmp(a, "--modules"))          p.modules = unsigned(v);
+    else if (!std::strcmp(a, "--safety"))           safety = v;
+    else if (!std::strcmp(a, "--setup-ns"))         p.setup_ns = v;
+    else if (!std::strcmp(a, "--hold-ns"))          p.hold_ns = v;
+    else if (!std::strcmp(a, "--min-high-ns"))      p.min_high_ns = v;
+    else if (!std::strcmp(a, "--min-low-ns"))       p.min_low_ns = v;
+    else if (!std::strcmp(a, "--tau-charge-us"))    p.tau_charge_ns = v * 1000;
+    else if (!std::strcmp(a, "--tau-discharge-us")) p.tau_discharge_ns = v * 1000;
+    else if (!std::strcmp(a, "--threshold"))        p.threshold = v;
+    else if (!std::strcmp(a, "--rearm"))            p.rearm = v;
+    else { usage(); return 2; }
+  }
+  if (p.modules == 0 || safety < 1 || p.threshold <= 0 || p.threshold >= 1) {
+    usage();
+    return 2;
+  }
+
+  int status = 0;
+  if (path) {
+    pintrace::Trace trace;
+    std::string error;
+    if (!pintrace::load_trace(path, trace, error)) {
+      std::fprintf(stderr, "relaymodel: %s\n", error.c_str());
+      return 2;
+    }
+    relayboard::Result r = relayboard::simulate(trace, p);
+    std::printf("%zu edges, %u good frames, %zu latches, %zu violation(s)\n",
+                trace.edges.size(), r.frames, r.latched.size(), r.violations.size());
+    for (size_t i = 0; i < r.violations.size() && i < 20; i++)
+      std::printf("  %12.3f ms  %s\n", r.violations[i].t_ns / 1e6, r.violations[i].what.c_str());
+    std::printf("tightest observed timing:\n");
+    print_ns("setup", r.observed.setup_ns);
+    print_ns("hold", r.observed.hold_ns);
+    print_ns("clock high", r.observed.high_ns);
+    print_ns("clock low", r.observed.low_ns);
+    print_ns("latch", r.observed.latch_ns);
+    std::printf("  %-12s %9.2f (threshold %.2f)\n", "RC peak", r.observed.peak_shift_v, p.threshold);
+    status = r.violations.empty() ? 0 : 1;
+  }
+
+  relayboard::SafeDelays d = relayboard::minimum_delays(p, safety);
+  std::printf("minimum safe delays (x%.1f margin, %u module(s)):\n", safety, p.modules);
+  std::printf("  SERIAL_RELAY_DELAY_DATA       %9.3f us\n", d.data_ns / 1000);
+  std::printf("  SERIAL_RELAY_DELAY_CLOCK_HIGH %9.3f us\n", d.clock_high_ns / 1000);
+  std::printf("  SERIAL_RELAY_DELAY_CLOCK_LOW  %9.3f us\n", d.clock_low_ns / 1000);
+  std::printf("  SERIAL_RELAY_DELAY_LATCH      %9.3f us\n", d.latch_ns / 1000);
+  std::printf("  -> %.3f us per bit, %.3f us per frame\n", d.bit_ns / 1000, d.frame_ns / 1000);
+  const relayboard::Params model;
+  if (p.tau_charge_ns == model.tau_charge_ns && p.tau_discharge_ns == model.tau_discharge_ns &&
+      p.threshold == model.threshold)
+    std::printf("  (default RC model: placeholder values, not a measured board; pass\n"
+                "   --tau-charge-us/--tau-discharge-us/--threshold before using these)\n");
+  return status;
+}
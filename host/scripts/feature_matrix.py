@@ -0,0 +1,98 @@
+"""
+Flash/RAM build matrix of the firmware features
+
+  python host/scripts/feature_matrix.py [-e uno|mega] [--markdown]
+
+Builds src/ once per combination of the FEATURE_* switches
+(include/firmware_features.h), each in its own build directory under
+.pio/matrix/, and prints flash and RAM per combination plus the cost of
+each feature over the all-off build, the floor every other row is
+measured against.
+
+The matrix has not been run yet: whether a disabled feature really costs
+nothing, compared with a build that never had the feature, is what its
+all-off row is for. Until someone runs it, treat that as unmeasured.
+
+Modbus needs USART0 for itself, so combinations of it with the status log,
+telemetry or the event log are skipped. FEATURE_HW_TIMERS is only built for the MEGA.
+"""
+import argparse
+import itertools
+import os
+import re
+import subprocess
+import sys
+
+FEATURES = ["STATUS_LOG", "TELEMETRY", "EVENT_LOG", "DEBUG_LED", "MODBUS", "SOFT_TIMERS"]
+MEGA_FEATURES = ["HW_TIMERS"]
+
+SIZE_RE = {
+    "ram": re.compile(r"RAM:.*used (\d+) bytes"),
+    "flash": re.compile(r"Flash:.*used (\d+) bytes"),
+}
+
+
+def build(project, env_name, flags, tag):
+    env = dict(os.environ)
+    env["PLATFORMIO_BUILD_FLAGS"] = " ".join(flags)
+    env["PLATFORMIO_BUILD_DIR"] = os.path.join(project, ".pio", "matrix", tag)
+    out = subprocess.run(
+        [sys.executable, "-m", "platformio", "run", "-d", project, "-e", env_name],
+        env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True,
+    )
+    if out.returncode != 0:
+        sys.stderr.write(out.stdout)
+        return None
+    sizes = {}
+    for key, pattern in SIZE_RE.items():
+        m = pattern.search(out.stdout)
+        sizes[key] = int(m.group(1)) if m else None
+    return sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("-e", "--env", default="uno", choices=["uno", "mega"])
+    parser.add_argument("--markdown", action="store_true", help="print a Markdown table")
+    args = parser.parse_args()
+
+    project = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+    features = FEATURES + (MEGA_FEATURES if args.env == "mega" else [])
+
+    rows = []
+    for bits in itertools.product([0, 1], repeat=len(features)):
+        on = dict(zip(features, bits))
+        if on["MODBUS"] and (on["STATUS_LOG"] or on["TELEMETRY"] or on["EVENT_LOG"]):
+            continue
+        flags = ["-DFEATURE_%s=%d" % (f, v) for f, v in on.items()]
+        tag = "%s-%s" % (args.env, "".join(str(b) for b in bits))
+        sizes = build(project, args.env, flags, tag)
+        if sizes is None:
+            print("FAIL %s" % " ".join(flags))
+            return 1
+        rows.append((on, sizes))
+
+    base = rows[0][1]
+    names = [f.lower() for f in features]
+    if args.markdown:
+        print("| %s | flash | RAM |" % " | ".join(names))
+        print("|%s---|---|" % "---|" * len(names))
+        for on, sizes in rows:
+            print("| %s | %d | %d |" % (" | ".join("x" if on[f] else "" for f in features),
+                                        sizes["flash"], sizes["ram"]))
+    else:
+        for on, sizes in rows:
+            enabled = "+".join(f.lower() for f in features if on[f]) or "none"
+            print("MATRIX %s flash=%d ram=%d" % (enabled, sizes["flash"], sizes["ram"]))
+
+    # Cost of each feature alone
+    for f in features:
+        alone = [s for on, s in rows if on[f] and sum(on.values()) == 1]
+        if alone:
+            print("#MATRIX %s flash=+%d ram=+%d" % (f.lower(), alone[0]["flash"] - base["flash"],
+                                                   alone[0]["ram"] - base["ram"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
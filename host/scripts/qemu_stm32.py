@@ -0,0 +1,27 @@
+"""
+STM32 port under QEMU for [env:stm32_qemu]
+
+  pio run -e stm32_qemu -t qemu
+
+Runs the firmware on qemu-system-arm's netduinoplus2 machine (STM32F405)
+with USART1 on stdio; the BENCH lines are the CoreBench results. -icount
+makes cycle counts deterministic. QEMU may point to the qemu-system-arm
+binary (default: on PATH).
+"""
+import os
+
+Import("env")
+
+qemu = os.environ.get("QEMU", "qemu-system-arm")
+
+env.AddCustomTarget(
+    name="qemu",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[
+        '%s -M netduinoplus2 -nographic -icount shift=0 '
+        '-semihosting-config enable=on,target=native '
+        '-kernel "$BUILD_DIR/${PROGNAME}.elf"' % qemu
+    ],
+    title="STM32 core (QEMU)",
+    description="Run the core benchmark and scheduler on an emulated STM32F405",
+)
@@ -0,0 +1,25 @@
+"""
+Benchmark suite under simavr
+
+  pio run -e uno_bench -t simbench
+  pio run -e mega_bench -t simbench
+
+Runs the benchmark firmware (bench/) in simavr at the board's F_CPU; the
+BENCH lines printed on the UART are the results. SIMAVR may point to the
+simavr binary (default: simavr on PATH).
+"""
+import os
+
+Import("env")
+
+simavr = os.environ.get("SIMAVR", "simavr")
+mcu = env.BoardConfig().get("build.mcu")
+f_cpu = env.BoardConfig().get("build.f_cpu").rstrip("L")
+
+env.AddCustomTarget(
+    name="simbench",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=['%s -m %s -f %s "$BUILD_DIR/${PROGNAME}.elf"' % (simavr, mcu, f_cpu)],
+    title="Benchmarks (simavr)",
+    description="Run the on-target benchmark suite in simavr",
+)
@@ -0,0 +1,39 @@
+"""
+Golden-trace target for [env:uno_sim]
+
+  pio run -e uno_sim -t golden
+
+Builds the firmware with SIMAVR_TRACE, runs the ELF in simavr (which
+records RELAY_DATA/RELAY_CLK into relay_trace.vcd, see include/SimTrace.h)
+and compares the decoded relay frames with the host model (host/tracecheck).
+
+SIMAVR_INCLUDE may point to simavr's headers (default /usr/include/simavr),
+SIMAVR to the simavr binary (default: simavr on PATH).
+"""
+import os
+
+Import("env")
+
+simavr_include = os.environ.get("SIMAVR_INCLUDE", "/usr/include/simavr")
+env.Append(CPPPATH=[simavr_include])
+
+simavr = os.environ.get("SIMAVR", "simavr")
+hour_ms = env.GetProjectOption("custom_sim_hour_ms")
+hours = env.GetProjectOption("custom_sim_hours")
+modules = env.GetProjectOption("custom_sim_modules")
+mcu = env.BoardConfig().get("build.mcu")
+f_cpu = env.BoardConfig().get("build.f_cpu").rstrip("L")
+tracecheck = os.path.join("$PROJECT_DIR", ".pio", "build", "tracecheck", "program")
+
+env.AddCustomTarget(
+    name="golden",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[
+        '"$PYTHONEXE" -m platformio run -d "$PROJECT_DIR" -e tracecheck',
+        'cd "$BUILD_DIR" && %s -m %s -f %s ${PROGNAME}.elf' % (simavr, mcu, f_cpu),
+        '"%s" --trace "$BUILD_DIR/relay_trace.vcd" --hour-ms %s --hours %s --modules %s'
+        % (tracecheck, hour_ms, hours, modules),
+    ],
+    title="Golden trace",
+    description="Run the firmware in simavr and compare relay frames with the host model",
+)
@@ -0,0 +1,157 @@
+/**
+ * @brief tracecheck - golden-trace check of the firmware against the host model
+ *
+ *
+ * @notes:
+ * - Decodes the relay frames the real firmware shifted out (simavr VCD
+ * of [env:uno_sim], or a text pin trace) and compares them with the
+ * frames the host model predicts for the same schedule: the zone table
+ * of include/schedule_config.h run through lib/LightSchedule.
+ *
+ * - Checked, in order:
+ *   - boot: one "all OFF" frame, then one carrying the initial zone mask;
+ *   - schedule: one frame per hour in which any zone toggled, with the
+ *     expected relay mask, at t0 + hour * hour_ms (t0 from the first
+ *     scheduled frame) within the tolerance.
+ *
+ * - tracecheck --trace FILE [--hour-ms MS] [--hours H] [--modules M]
+ *                          [--tolerance-ms T]
+ *   defaults match [env:uno_sim]: 50 ms hours, 1440 hours, 1 module
+ *
+ */
+#include <LightSchedule.h>
+#include <PinTrace.h>
+#include <schedule_config.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Expected
+{
+  unsigned hour;
+  uint8_t  mask;
+};
+
+// Host model of Trigger_relay(): one frame per hour with a toggle
+std::vector<Expected> model(unsigned hours, uint8_t &initial)
+{
+  LightSchedule s[SCHEDULE_ZONES];
+  initial = 0;
+  for (uint8_t z = 0; z < SCHEDULE_ZONES; z++) {
+    s[z] = schedule_from_entry(SCHEDULE_TABLE[z]);
+    if (s[z].is_on())
+      initial |= uint8_t(1 << z);
+  }
+  std::vector<Expected> out;
+  for (unsigned h = 1; h <= hours; h++) {
+    bool changed = false;
+    uint8_t mask = 0;
+    for (uint8_t z = 0; z < SCHEDULE_ZONES; z++) {
+      changed |= s[z].tick();
+      if (s[z].is_on())
+        mask |= uint8_t(1 << z);
+    }
+    if (changed)
+      out.push_back({h, mask});
+  }
+  return out;
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+  const char *path = nullptr;
+  double hour_ms = 50;
+  unsigned hours = 24 * 60;
+  unsigned modules = 1;
+  double tol_ms = -1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!std::strcmp(argv[i], "--trace"))             path = argv[i + 1];
+    else if (!std::strcmp(argv[i], "--hour-ms"))      hour_ms = std::atof(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "--hours"))        hours = unsigned(std::atoi(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "--modules"))      modules = unsigned(std::atoi(argv[i + 1]));
+    else if (!std::strcmp(argv[i], "--tolerance-ms")) tol_ms = std::atof(argv[i + 1]);
+  }
+  if (!path || hour_ms <= 0 || modules == 0) {
+    std::fprintf(stderr, "usage: tracecheck --trace FILE [--hour-ms MS] [--hours H] "
+                         "[--modules M] [--tolerance-ms T]\n");
+    return 2;
+  }
+  if (tol_ms < 0)
+    tol_ms = hour_ms * 0.01 > 1.0 ? hour_ms * 0.01 : 1.0;
+
+  pintrace::Trace trace;
+  std::string error;
+  if (!pintrace::load_trace(path, trace, error)) {
+    std::fprintf(stderr, "tracecheck: %s\n", error.c_str());
+    return 2;
+  }
+  std::vector<pintrace::Frame> frames = pintrace::decode_frames(trace, 8 * modules);
+
+  uint8_t initial;
+  std::vector<Expected> expected = model(hours, initial);
+  const size_t boot = 2;
+
+  std::printf("trace: %zu edges, %.3f s, %zu frames\n", trace.edges.size(),
+              trace.end_ns / 1e9, frames.size());
+  std::printf("model: %u zones, %u hours, %zu boot + %zu scheduled frames\n",
+              unsigned(SCHEDULE_ZONES), hours, boot, expected.size());
+
+  unsigned failures = 0;
+  if (frames.size() < boot) {
+    std::printf("FAIL boot: only %zu frames decoded\n", frames.size());
+    return 1;
+  }
+  for (uint8_t b : frames[0].bytes)
+    if (b) {
+      std::printf("FAIL boot: first frame is not all OFF\n");
+      failures++;
+      break;
+    }
+  uint8_t boot_last = frames[boot - 1].bytes.back();
+  if (boot_last != initial) {
+    std::printf("FAIL boot: last frame 0x%02X, expected initial mask 0x%02X\n", boot_last, initial);
+    failures++;
+  }
+
+  const size_t got = frames.size() - boot;
+  if (got != expected.size()) {
+    std::printf("FAIL count: %zu scheduled frames, model has %zu\n", got, expected.size());
+    failures++;
+  }
+
+  const size_t n = got < expected.size() ? got : expected.size();
+  const double hour_ns = hour_ms * 1e6;
+  double t0 = n ? frames[boot].t_first_ns - expected[0].hour * hour_ns : 0;
+  double worst = 0;
+  for (size_t k = 0; k < n; k++) {
+    const pintrace::Frame &f = frames[boot + k];
+    // Zones live on module 1, the last byte of the chain
+    uint8_t mask = f.bytes.back();
+    double drift_ms = (f.t_first_ns - (t0 + expected[k].hour * hour_ns)) / 1e6;
+    if (drift_ms < 0 ? -drift_ms > worst : drift_ms > worst)
+      worst = drift_ms < 0 ? -drift_ms : drift_ms;
+    bool bad_mask = mask != expected[k].mask;
+    bool bad_time = drift_ms > tol_ms || drift_ms < -tol_ms;
+    if (bad_mask || bad_time) {
+      if (failures < 20)
+        std::printf("FAIL hour %u: frame 0x%02X (model 0x%02X), %+.3f ms off\n",
+                    expected[k].hour, mask, expected[k].mask, drift_ms);
+      failures++;
+    }
+  }
+
+  std::printf("worst timing error %.3f ms (tolerance %.3f ms)\n", worst, tol_ms);
+  std::printf("%s: %u mismatch(es) over %.1f simulated days\n",
+              failures ? "FAILED" : "PASSED", failures, hours / 24.0);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+/**
+ * @brief simavr trace hooks
+ *
+ *
+ * @notes:
+ * - Only active in the [env:uno_sim] build (SIMAVR_TRACE defined). The
+ * firmware then carries simavr's .mmcu section, which tells simavr to
+ * record RELAY_DATA (PD7, pin 7) and RELAY_CLK (PB0, pin 8) into
+ * relay_trace.vcd while it runs.
+ *
+ * - SIM_HOURS schedule ticks after boot, Sim_stop() puts the core to
+ * sleep with interrupts off, which makes simavr exit cleanly.
+ *
+ * - https://github.com/buserror/simavr (simavr/sim/avr/avr_mcu_section.h)
+ *
+ */
+#pragma once
+
+#ifdef SIMAVR_TRACE
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/avr_mcu_section.h>
+
+#ifndef SIM_HOURS
+  #define SIM_HOURS (24 * 60)   // Simulated schedule hours before exiting
+#endif
+
+AVR_MCU(F_CPU, "atmega328p");
+AVR_MCU_VCD_FILE("relay_trace.vcd", 1000);
+
+const struct avr_mmcu_vcd_trace_t _relay_trace[] _MMCU_ = {
+  { AVR_MCU_VCD_SYMBOL("RELAY_DATA"), .mask = (1 << PORTD7), .what = (void *)&PORTD, },
+  { AVR_MCU_VCD_SYMBOL("RELAY_CLK"),  .mask = (1 << PORTB0), .what = (void *)&PORTB, },
+};
+
+inline void Sim_stop()
+{
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * @brief FIRMWARE FEATURES
+ * Pick the subsystems built into the firmware
+ *
+ * FEATURE_STATUS_LOG:  status and event lines on the USB serial port
+ * FEATURE_TELEMETRY:   binary min/max/mean snapshots between the status lines
+ * FEATURE_EVENT_LOG:   relay events kept in RAM, dumped by the host at up to 1 Mbaud
+ * FEATURE_DEBUG_LED:   LED_BUILTIN follows zone 0
+ * FEATURE_MODBUS:      Modbus RTU slave on the USB serial port (or RS-485)
+ * FEATURE_SOFT_TIMERS: software timers on a timing wheel (lib/TimerWheel)
+ * FEATURE_HW_TIMERS:   fan PWM, relay profiler, pulse counter (MEGA only)
+ *
+ * @notes:
+ * - Each is 0 or 1, and -DFEATURE_<NAME>=<0|1> in build_flags wins over
+ * the defaults below. A disabled subsystem is an empty policy class
+ * (include/subsystems.h): its calls are empty inline functions and its
+ * state is never instantiated.
+ *
+ * - host/scripts/feature_matrix.py builds every combination and reports
+ * flash and RAM of each. It has not been run yet, so what a disabled
+ * subsystem still costs, if anything, is not measured.
+ *
+ * - The old switches still work: -DDEBUG_MODE, -DMODBUS_RTU and
+ * -DSOFT_TIMERS turn the matching feature on.
+ *
+ */
+#pragma once
+
+#ifndef FEATURE_DEBUG_LED
+  #ifdef DEBUG_MODE
+    #define FEATURE_DEBUG_LED 1
+  #else
+    #define FEATURE_DEBUG_LED 0
+  #endif
+#endif
+
+#ifndef FEATURE_MODBUS
+  #ifdef MODBUS_RTU
+    #define FEATURE_MODBUS 1
+  #else
+    #define FEATURE_MODBUS 0
+  #endif
+#endif
+
+// The port carries either Modbus frames or status text
+#ifndef FEATURE_STATUS_LOG
+  #define FEATURE_STATUS_LOG (!FEATURE_MODBUS)
+#endif
+
+#ifndef FEATURE_TELEMETRY
+  #define FEATURE_TELEMETRY 0
+#endif
+
+#ifndef FEATURE_EVENT_LOG
+  #define FEATURE_EVENT_LOG 0
+#endif
+
+#ifndef FEATURE_SOFT_TIMERS
+  #ifdef SOFT_TIMERS
+    #define FEATURE_SOFT_TIMERS 1
+  #else
+    #define FEATURE_SOFT_TIMERS 0
+  #endif
+#endif
+
+#ifndef FEATURE_HW_TIMERS
+  #if defined(__AVR_ATmega2560__)
+    #define FEATURE_HW_TIMERS 1
+  #else
+    #define FEATURE_HW_TIMERS 0
+  #endif
+#endif
+
+static_assert(!(FEATURE_MODBUS && FEATURE_STATUS_LOG), "Modbus and the status log share USART0");
+static_assert(!(FEATURE_MODBUS && FEATURE_TELEMETRY), "Modbus and telemetry share USART0");
+static_assert(!(FEATURE_MODBUS && FEATURE_EVENT_LOG), "Modbus and the event log link share USART0");
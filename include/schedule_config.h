@@ -0,0 +1,49 @@
+/**
+ * @brief USER's LIGHT SCHEDULE
+ * Define the light patterns you want to use
+ *
+ * LIGHT_HOURS: How many hours of light
+ * DARK_HOURS: How many hours of dark
+ *
+ * @notes:
+ * - Shared by the firmware (src/main.cpp) and the host tools that model
+ * it (host/tracecheck, host/coresim), so both always run the same schedule.
+ *
+ */
+#pragma once
+
+#define LIGHT_HOURS 18  // Hours with lights on
+#define DARK_HOURS  6   // Hours with lights off
+// 1: the relay starts activated, 0: it starts with the dark hours
+#ifndef START_RELAY_ON
+  #define START_RELAY_ON 1
+#endif
+
+
+/**
+ * @brief ZONE SCHEDULES
+ *
+ *
+ * @notes:
+ * - Zone z drives channel z of the relay chain: with 4 relays per
+ * module, relay z % 4 + 1 of module z / 4 + 1 (RelayFrame::set_channel).
+ * - include/schedule_table.h is generated by host/optimizer. Without it
+ * a single zone runs the LIGHT_HOURS/DARK_HOURS pattern above.
+ * - A valid schedule image in EEPROM (also from host/optimizer)
+ * overrides the compiled table. It must hold exactly SCHEDULE_ZONES
+ * entries, so it re-plans the hours of this build's zones without a
+ * rebuild; a different zone count needs the header from the same
+ * optimizer run. A rejected image is reported at boot (StatusLog).
+ *
+ */
+#include <ScheduleTable.h>
+
+#if __has_include(<schedule_table.h>)
+  #include <schedule_table.h>
+#else
+  #define SCHEDULE_ZONES 1
+  constexpr ScheduleEntry SCHEDULE_TABLE[SCHEDULE_ZONES] = {
+    {LIGHT_HOURS, DARK_HOURS, START_RELAY_ON, 0}
+  };
+#endif
+static_assert(SCHEDULE_ZONES <= SCHEDULE_MAX_ZONES, "Too many zones: raise SCHEDULE_MAX_ZONES");
@@ -0,0 +1,532 @@
+/**
+ * @brief Firmware subsystems as policy classes
+ *
+ *
+ * @notes:
+ * - src/main.cpp is composed from these: each subsystem is a class
+ * template on `bool ENABLED` (include/firmware_features.h picks the
+ * value), whose static hooks setup() and loop() call unconditionally.
+ *
+ * - The <false> specialization of each one has the same hooks, empty and
+ * inline, and its state lives in static members of the <true> class, so
+ * the disabled subsystem defines no variables and calls no library code.
+ * No #ifdef at the call sites. The flash and RAM that leaves behind is
+ * for host/scripts/feature_matrix.py to measure; it has not been run.
+ *
+ * - The <true> specializations and the library headers they need are
+ * under their FEATURE_ guard, and platformio.ini sets lib_ldf_mode =
+ * chain+ so the library finder follows those #if: a build compiles only
+ * the libraries of its subsystems. That matters beyond size, RtuSerial
+ * and SerialLink both define the USART0 interrupt vectors.
+ *
+ * - Interrupt vectors cannot be templates: the few a subsystem needs
+ * (the soft timer tick) are still defined under #if in src/main.cpp.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include <IsrSafe.h>
+
+#include "firmware_features.h"
+#include "schedule_config.h"
+
+#if FEATURE_STATUS_LOG || FEATURE_TELEMETRY || FEATURE_EVENT_LOG
+  #include <SerialLink.h>
+#endif
+#if FEATURE_TELEMETRY
+  #include <LinkFrame.h>
+  #include <Telemetry.h>
+#endif
+#if FEATURE_EVENT_LOG
+  #include <EventLog.h>
+  #include <LinkSession.h>
+#endif
+#if FEATURE_SOFT_TIMERS
+  #include <TimerWheel.h>
+#endif
+#if FEATURE_MODBUS
+  #include <ModbusSlave.h>
+  #include <RtuSerial.h>
+  #include <TimeSync.h>
+#endif
+#if FEATURE_HW_TIMERS
+  #include <HwTimers.h>
+#endif
+
+
+/**
+ * @brief LED_BUILTIN follows zone 0
+ *
+ */
+template <bool ENABLED>
+struct DebugLed
+{
+  static void begin(bool on)
+  {
+    pinMode(LED_BUILTIN, OUTPUT);
+    set(on);
+  }
+
+  static void set(bool on) { digitalWrite(LED_BUILTIN, on); }
+};
+
+template <>
+struct DebugLed<false>
+{
+  static void begin(bool) {}
+  static void set(bool) {}
+};
+
+
+/**
+ * @brief Zone toggles from Trigger_relay to loop()
+ *
+ * @notes:
+ * - The ISR fills a RelayEvent from a fixed-block pool and queues it,
+ * one per toggled zone; poll() hands it to the handler with the pool
+ * statistics, then frees it. Zones toggling in the same hour need as
+ * many blocks at once: a toggle that finds the pool empty is lost and
+ * counted as a failed allocation.
+ *
+ */
+struct RelayEvent
+{
+  uint32_t hour;
+  uint8_t zone;       // Zone that toggled
+  bool on;            // Its state after the toggle
+};
+
+template <bool ENABLED, uint8_t N>
+class RelayEvents
+{
+public:
+  // Timer interrupt
+  static void record(uint32_t hour, uint8_t zone, bool on)
+  {
+    RelayEvent *e = pool_.alloc();
+    if (e) {
+      e->hour = hour;
+      e->zone = zone;
+      e->on = on;
+      queue_.push(e);
+    }
+  }
+
+  // Main loop: handler(const RelayEvent &, const PoolStats &)
+  template <class Handler>
+  static void poll(Handler handler)
+  {
+    RelayEvent *e;
+    if (!queue_.pop(e))
+      return;
+    PoolStats stats;
+    pool_.stats(stats);
+    handler(*e, stats);
+    pool_.free(e);
+  }
+
+private:
+  static BlockPool<RelayEvent, N> pool_;
+  static SpscRing<RelayEvent *, N> queue_;
+};
+
+template <bool ENABLED, uint8_t N> BlockPool<RelayEvent, N> RelayEvents<ENABLED, N>::pool_;
+template <bool ENABLED, uint8_t N> SpscRing<RelayEvent *, N> RelayEvents<ENABLED, N>::queue_;
+
+template <uint8_t N>
+struct RelayEvents<false, N>
+{
+  static void record(uint32_t, uint8_t, bool) {}
+  template <class Handler>
+  static void poll(Handler) {}
+};
+
+
+/**
+ * @brief Status and event lines on the USB serial port
+ *
+ * @notes:
+ * - Through SerialLink (lib/SerialLink), one frame per line: events and
+ * statistics go out as TELEMETRY, faults as ALARM, ahead of any queued
+ * telemetry or bulk output.
+ *
+ */
+template <bool ENABLED>
+struct StatusLog;
+
+#if FEATURE_STATUS_LOG
+template <>
+struct StatusLog<true>
+{
+  static void begin(const char *board)
+  {
+    SerialLink::begin(SERIAL_LINK_BAUD);
+    Print &out = SerialLink::out(SerialLink::TELEMETRY);
+    out.println(F("#WARNING: ARDUINO HAS BEEN RESET"));
+    out.print(F("\nStarting ESTUFA on "));
+    out.println(board);
+    out.print(F("CPU Frequency = "));
+    out.print(F_CPU / 1000000);
+    out.println(F(" MHz"));
+  }
+
+  static void schedules(ScheduleImageStatus status)
+  {
+    Print &out = SerialLink::out(SerialLink::TELEMETRY);
+    if (status == SCHEDULE_IMAGE_OK) {
+      out.println(F("Schedules loaded from EEPROM"));
+      return;
+    }
+    out.print(F("Schedules loaded from firmware table"));
+    switch (status) {
+      case SCHEDULE_IMAGE_OTHER_VERSION:
+        out.println(F(", EEPROM image rejected: other image version"));
+        break;
+      case SCHEDULE_IMAGE_ZONE_COUNT:
+        out.print(F(", EEPROM image rejected: zone count is not "));
+        out.println(SCHEDULE_ZONES);
+        break;
+      case SCHEDULE_IMAGE_CRC:
+        out.println(F(", EEPROM image rejected: bad CRC"));
+        break;
+      case SCHEDULE_IMAGE_ENTRY:
+        out.println(F(", EEPROM image rejected: invalid entry"));
+        break;
+      default:
+        out.println();   // No image written
+    }
+  }
+
+  static void timer(bool ok)
+  {
+    if (ok) {
+      Print &out = SerialLink::out(SerialLink::TELEMETRY);
+      out.print(F("Starting  ITimer1 OK, millis() = "));
+      out.println(millis());
+    }
+    else
+      SerialLink::out(SerialLink::ALARM).println(F("Can't set ITimer1"));
+  }
+
+  static void event(const RelayEvent &e, const PoolStats &pool)
+  {
+    Print &out = SerialLink::out(pool.failed ? SerialLink::ALARM : SerialLink::TELEMETRY);
+    out.print(F("#EVENT hour="));
+    out.print(e.hour);
+    out.print(F(" zone="));
+    out.print(e.zone);
+    out.print(F(" on="));
+    out.print(e.on);
+    out.print(F(" pool_used="));
+    out.print(pool.in_use);
+    out.print(F("/"));
+    out.print(pool.size);
+    out.print(F(" high="));
+    out.print(pool.high_water);
+    out.print(F(" failed="));
+    out.println(pool.failed);
+  }
+
+  static void relay_stats(uint32_t cycles, uint32_t max, uint32_t pulses)
+  {
+    Print &out = SerialLink::out(SerialLink::TELEMETRY);
+    out.print(F("#STATS relay_cycles="));
+    out.print(cycles);
+    out.print(F(" max="));
+    out.print(max);
+    out.print(F(" pulses="));
+    out.println(pulses);
+  }
+};
+#endif
+
+template <>
+struct StatusLog<false>
+{
+  static void begin(const char *) {}
+  static void schedules(ScheduleImageStatus) {}
+  static void timer(bool) {}
+  static void event(const RelayEvent &, const PoolStats &) {}
+  static void relay_stats(uint32_t, uint32_t, uint32_t) {}
+};
+
+
+/**
+ * @brief Binary telemetry snapshots between the status lines
+ *
+ * @notes:
+ * - Channel 0 is the longest loop() pass of each sample period, in us;
+ * sample() fills channels 1..CH-1. Every interval one Telemetry record
+ * (lib/EstufaCore/Telemetry.h) goes out as a LinkFrame on the TELEMETRY
+ * queue: 39 bytes for 4 channels, 78 bits/s at the default 5 s.
+ * - The interval starts at TELEMETRY_INTERVAL_MS. The host changes it,
+ * or stops the stream with 0, through LinkSession's 'I' command
+ * (`estufalink interval MS`), which is read by EventLogLink: without
+ * FEATURE_EVENT_LOG nothing listens and the interval stays fixed.
+ * - A record and its framing must fit one SerialLink frame, or every
+ * send() would be dropped: that bounds CH.
+ *
+ */
+template <bool ENABLED, class Hal, uint8_t CH>
+struct TelemetryStream;
+
+#if FEATURE_TELEMETRY
+template <class Hal, uint8_t CH>
+struct TelemetryStream<true, Hal, CH>
+{
+  typedef Telemetry<Hal, CH> Stream;
+  static_assert(Stream::record_size + LINK_FRAME_OVERHEAD <= SerialLink::max_frame,
+                "Telemetry record does not fit a SerialLink frame: fewer channels or a larger SERIAL_LINK_QUEUE");
+
+  static void begin()
+  {
+    SerialLink::begin(SERIAL_LINK_BAUD);
+    last_ = Hal::clock();
+  }
+
+  // Every loop() pass: sample(int16_t values[CH - 1])
+  template <class Sample>
+  static void poll(Sample sample)
+  {
+    const uint32_t now = Hal::clock();
+    const uint32_t pass = now - last_;
+    last_ = now;
+    if (pass > worst_)
+      worst_ = pass;
+
+    Stream::poll(
+      [&](int16_t *v) {
+        v[0] = int16_t(worst_ < 32767 ? worst_ : 32767);
+        worst_ = 0;
+        sample(v + 1);
+      },
+      [](const uint8_t *rec, uint8_t len) {
+        uint8_t frame[Stream::record_size + LINK_FRAME_OVERHEAD];
+        SerialLink::send(SerialLink::TELEMETRY, frame, link_frame(rec, len, frame));
+      });
+  }
+
+private:
+  static uint32_t last_;
+  static uint32_t worst_;
+};
+
+template <class Hal, uint8_t CH> uint32_t TelemetryStream<true, Hal, CH>::last_ = 0;
+template <class Hal, uint8_t CH> uint32_t TelemetryStream<true, Hal, CH>::worst_ = 0;
+#endif
+
+template <class Hal, uint8_t CH>
+struct TelemetryStream<false, Hal, CH>
+{
+  // For LinkSession: no channels, so 'I' is refused
+  struct Stream
+  {
+    static constexpr uint8_t channels = 0;
+    static void set_interval(uint16_t) {}
+    static uint16_t interval() { return 0; }
+  };
+
+  static void begin() {}
+  template <class Sample>
+  static void poll(Sample) {}
+};
+
+
+/**
+ * @brief Event log in RAM, dumped to the host on request
+ *
+ * @notes:
+ * - Every relay event goes into an EventLog of N records; LinkSession
+ * (lib/EstufaCore/LinkSession.h) pages it out to `estufalink dump` on
+ * the status link, at up to 1 Mbaud when the host negotiates it, falling
+ * back to SERIAL_LINK_BAUD by itself.
+ * - The same session takes the telemetry interval command for Tlm, a
+ * TelemetryStream's Stream.
+ *
+ */
+template <bool ENABLED, class Hal, uint16_t N, class Tlm>
+struct EventLogLink;
+
+#if FEATURE_EVENT_LOG
+template <class Hal, uint16_t N, class Tlm>
+struct EventLogLink<true, Hal, N, Tlm>
+{
+  typedef EventLog<N> Log;
+  typedef LinkSession<SerialLink, Hal, Log, Tlm> Session;
+  static_assert(SCHEDULE_ZONES <= 128, "EventRecord keeps 7 bits of zone");
+
+  static void begin()
+  {
+    SerialLink::begin(SERIAL_LINK_BAUD);
+    Session::begin(SERIAL_LINK_BAUD);
+  }
+
+  static void record(const RelayEvent &e, const PoolStats &pool)
+  {
+    EventRecord r;
+    r.hour = e.hour;
+    r.zone = e.zone;
+    r.on = e.on;
+    r.pool_in_use = pool.in_use;
+    r.pool_high = pool.high_water;
+    r.pool_failed = uint8_t(pool.failed < 255 ? pool.failed : 255);
+    Log::append(r);
+  }
+
+  static void poll() { Session::poll(); }
+};
+#endif
+
+template <class Hal, uint16_t N, class Tlm>
+struct EventLogLink<false, Hal, N, Tlm>
+{
+  static void begin() {}
+  static void record(const RelayEvent &, const PoolStats &) {}
+  static void poll() {}
+};
+
+
+/**
+ * @brief Software timers, ticked by Timer0's compare B interrupt
+ *
+ */
+template <bool ENABLED>
+struct SoftTimers;
+
+#if FEATURE_SOFT_TIMERS
+template <>
+struct SoftTimers<true>
+{
+  typedef TimerWheel<> Wheel;
+
+  static void begin()
+  {
+    // Mid-period of Timer0, away from its overflow interrupt
+    OCR0B = 128;
+    TIMSK0 |= _BV(OCIE0B);
+  }
+
+  static void tick() { Wheel::tick(); }
+  static void poll() { Wheel::poll(); }
+};
+#endif
+
+template <>
+struct SoftTimers<false>
+{
+  static void begin() {}
+  static void tick() {}
+  static void poll() {}
+};
+
+
+/**
+ * @brief MEGA hardware timers: fan PWM, relay profiler, pulse counter
+ *
+ * @notes:
+ * - send() shifts the relay chain out through Core, profiled, and sets
+ * fan channel 0 from the share of lit zones.
+ *
+ */
+template <bool ENABLED>
+struct MegaTimers;
+
+#if FEATURE_HW_TIMERS
+template <>
+struct MegaTimers<true>
+{
+  static void begin()
+  {
+    Profiler::begin();
+    FanPwm::begin();
+    PulseCounter::begin();
+  }
+
+  template <class Core, class Log>
+  static void send()
+  {
+    static ProfileStat stat;
+    {
+      ProfileScope profile(stat);
+      uint8_t lit = Core::send_relays();
+      FanPwm::set(0, uint8_t(lit * 255U / Core::zones));
+    }
+    Log::relay_stats(stat.last, stat.max, PulseCounter::count());
+  }
+};
+#endif
+
+template <>
+struct MegaTimers<false>
+{
+  static void begin() {}
+
+  template <class Core, class Log>
+  static void send() { Core::send_relays(); }
+};
+
+
+/**
+ * @brief Modbus RTU slave with time sync on USART0
+ *
+ * @notes:
+ * - RtuSerial replaces HardwareSerial: never enabled with StatusLog
+ * (include/firmware_features.h checks it).
+ *
+ */
+template <bool ENABLED, class Core, class Hal>
+struct ModbusLink;
+
+#if FEATURE_MODBUS
+template <class Core, class Hal>
+struct ModbusLink<true, Core, Hal>
+{
+  typedef TimeSync<Hal> Clock;
+  typedef ModbusSlave<Core, Hal, Clock> Slave;
+
+  static void begin(uint8_t address, uint32_t baud)
+  {
+    Slave::begin(address);
+    Clock::begin();
+    RtuSerial::begin(baud);
+  }
+
+  // One request per pass; responses go out from the UDRE interrupt. A
+  // response that finds the previous one still going out waits for a
+  // later pass, and no request is taken meanwhile
+  static void poll()
+  {
+    Clock::poll();
+    if (pending_) {
+      if (!RtuSerial::send(resp_, pending_))
+        return;
+      pending_ = 0;
+    }
+    uint16_t len;
+    const uint8_t *req = RtuSerial::frame(len);
+    if (!req)
+      return;
+    uint16_t n = Slave::handle(req, len, resp_, sizeof(resp_),
+                               RtuSerial::rx_stamp(), RtuSerial::tx_stamp());
+    RtuSerial::release();
+    if (n && !RtuSerial::send(resp_, n))
+      pending_ = n;
+  }
+
+private:
+  static uint8_t resp_[RTU_SERIAL_BUFFER];
+  static uint16_t pending_;
+};
+
+template <class Core, class Hal> uint8_t ModbusLink<true, Core, Hal>::resp_[RTU_SERIAL_BUFFER];
+template <class Core, class Hal> uint16_t ModbusLink<true, Core, Hal>::pending_ = 0;
+#endif
+
+template <class Core, class Hal>
+struct ModbusLink<false, Core, Hal>
+{
+  static void begin(uint8_t, uint32_t) {}
+  static void poll() {}
+};
@@ -0,0 +1,172 @@
+#include "EepromWriter.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+struct Job
+{
+  const uint8_t *src;
+  uint16_t addr;
+  uint16_t len;
+  uint16_t pos;           // Next byte to compare
+  uint8_t ticket;
+  bool programmed;        // Byte at pos was programmed, read it back
+  uint8_t value;          // ... and this is what it must read
+  volatile EepromStatus status;
+};
+
+static Job jobs[EEPROM_WRITER_JOBS];
+static volatile uint8_t head = 0;        // Job in progress
+static volatile uint8_t count = 0;       // Jobs queued, including head
+static uint8_t last_ticket = 0;
+
+static volatile uint16_t done_count = 0;
+static volatile uint16_t failed_count = 0;
+static volatile uint16_t written_count = 0;
+static volatile uint16_t skipped_count = 0;
+
+
+uint8_t EepromWriter::write(uint16_t addr, const void *src, uint16_t len)
+{
+  if (!len || uint32_t(addr) + len > uint32_t(E2END) + 1)
+    return 0;
+  uint8_t sreg = SREG;
+  cli();
+  if (count == EEPROM_WRITER_JOBS) {
+    SREG = sreg;
+    return 0;
+  }
+  if (++last_ticket == 0)
+    last_ticket = 1;
+  Job &j = jobs[(head + count) % EEPROM_WRITER_JOBS];
+  j.src = static_cast<const uint8_t *>(src);
+  j.addr = addr;
+  j.len = len;
+  j.pos = 0;
+  j.ticket = last_ticket;
+  j.programmed = false;
+  j.status = EEPROM_PENDING;
+  count = count + 1;
+  EECR |= _BV(EERIE);
+  SREG = sreg;
+  return last_ticket;
+}
+
+EepromStatus EepromWriter::status(uint8_t ticket)
+{
+  for (uint8_t i = 0; i < EEPROM_WRITER_JOBS; i++)
+    if (jobs[i].ticket == ticket && ticket)
+      return jobs[i].status;
+  return EEPROM_EXPIRED;
+}
+
+bool EepromWriter::busy()
+{
+  return count != 0;
+}
+
+void EepromWriter::flush()
+{
+  while (busy());
+}
+
+void EepromWriter::read(uint16_t addr, void *dst, uint16_t len)
+{
+  uint8_t *out = static_cast<uint8_t *>(dst);
+
+  // The interrupt also drives EEAR: keep it off while reading
+  uint8_t sreg = SREG;
+  cli();
+  EECR &= uint8_t(~_BV(EERIE));
+  SREG = sreg;
+
+  while (EECR & _BV(EEPE));
+  for (uint16_t i = 0; i < len; i++) {
+    EEAR = addr + i;
+    EECR |= _BV(EERE);
+    out[i] = EEDR;
+  }
+
+  // Queued data wins, later jobs over earlier ones
+  for (uint8_t q = 0; q < count; q++) {
+    const Job &j = jobs[(head + q) % EEPROM_WRITER_JOBS];
+    for (uint16_t i = 0; i < j.len; i++) {
+      uint16_t a = j.addr + i;
+      if (a >= addr && a - addr < len)
+        out[a - addr] = j.src[i];
+    }
+  }
+
+  if (count)
+    EECR |= _BV(EERIE);
+}
+
+void EepromWriter::stats(StorageStats &s)
+{
+  uint8_t sreg = SREG;
+  cli();
+  s.pending = count;
+  s.done = done_count;
+  s.failed = failed_count;
+  s.written = written_count;
+  s.skipped = skipped_count;
+  SREG = sreg;
+}
+
+
+static void finish(Job &j, EepromStatus status)
+{
+  j.status = status;
+  if (status == EEPROM_DONE)
+    done_count++;
+  else
+    failed_count++;
+  head = (head + 1) % EEPROM_WRITER_JOBS;
+  count = count - 1;
+}
+
+// EEPROM ready: no write in progress
+ISR(EE_READY_vect)
+{
+  for (uint8_t n = 0; n < EEPROM_WRITER_SCAN; n++) {
+    if (!count) {
+      EECR &= uint8_t(~_BV(EERIE));
+      return;
+    }
+    Job &j = jobs[head];
+    if (j.pos == j.len) {
+      finish(j, EEPROM_DONE);
+      continue;
+    }
+
+    EEAR = j.addr + j.pos;
+    EECR |= _BV(EERE);
+    const uint8_t current = EEDR;
+    if (j.programmed) {
+      j.programmed = false;
+      if (current != j.value) {
+        finish(j, EEPROM_FAILED);
+        continue;
+      }
+      j.pos++;
+      continue;
+    }
+    const uint8_t want = j.src[j.pos];
+    if (current == want) {
+      skipped_count++;
+      j.pos++;
+      continue;
+    }
+
+    // Erase and write (EEPM = 00); EEPE within 4 cycles of EEMPE
+    EEDR = want;
+    EECR |= _BV(EEMPE);
+    EECR |= _BV(EEPE);
+    j.value = want;
+    j.programmed = true;
+    written_count++;
+    return;
+  }
+  // More to compare: the interrupt fires again right away, after
+  // anything pending
+}
@@ -0,0 +1,66 @@
+/**
+ * @brief EepromWriter - EEPROM writes programmed from the EE_READY interrupt
+ *
+ *
+ * @notes:
+ * - A byte write takes 3.3-3.4 ms and eeprom_write_block()/EEPROM.put()
+ * busy-wait through every one of them: saving a 140-byte schedule image
+ * would stall loop() for half a second. Here write() only queues a job
+ * and returns; the EE_READY interrupt programs one byte each time the
+ * EEPROM is ready again.
+ *
+ * - Unchanged bytes are skipped: each byte is read first and only
+ * programmed if it differs (no 3.4 ms, no wear). Every programmed byte
+ * is read back; a job whose byte does not take is reported FAILED.
+ *
+ * - The source is not copied: the buffer given to write() must stay
+ * valid until status() of its ticket is no longer EEPROM_PENDING. Bytes
+ * changed meanwhile may or may not make it; queue the range again.
+ *
+ * - read() sees queued writes (read-your-writes), and keeps the
+ * interrupt away while it reads.
+ *
+ * - Tickets 1..255 cycle; the result of a ticket is kept until its
+ * queue slot is reused EEPROM_WRITER_JOBS jobs later (then EXPIRED).
+ *
+ * - Usage:
+ *   static Config cfg;
+ *   uint8_t t = EepromWriter::write(addr, &cfg, sizeof(cfg));   0 = queue full
+ *   ... EepromWriter::status(t) == EEPROM_DONE
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <StorageStats.h>
+
+#ifndef EEPROM_WRITER_JOBS
+  #define EEPROM_WRITER_JOBS 8     // Queued jobs
+#endif
+#ifndef EEPROM_WRITER_SCAN
+  #define EEPROM_WRITER_SCAN 16    // Unchanged bytes compared per interrupt
+#endif
+
+enum EepromStatus : uint8_t
+{
+  EEPROM_PENDING,
+  EEPROM_DONE,
+  EEPROM_FAILED,
+  EEPROM_EXPIRED
+};
+
+class EepromWriter
+{
+public:
+  // Queue `len` bytes from `src` to EEPROM `addr`; ticket, or 0 if the queue is full
+  static uint8_t write(uint16_t addr, const void *src, uint16_t len);
+  static EepromStatus status(uint8_t ticket);
+  static bool busy();
+  // Wait for every queued job (interrupts must be enabled)
+  static void flush();
+
+  static void read(uint16_t addr, void *dst, uint16_t len);
+
+  static void stats(StorageStats &s);
+};
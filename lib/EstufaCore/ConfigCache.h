@@ -0,0 +1,137 @@
+/**
+ * @brief ConfigCache - RAM copy of a configuration block in storage
+ *
+ *
+ * @notes:
+ * - The block [BASE, BASE + SIZE) of the HAL's storage is read once by
+ * load(); after that reads are plain RAM accesses and writes only change
+ * RAM and widen a dirty range.
+ *
+ * - poll() (main loop) writes the dirty range back through
+ * Hal::storage_write() once the block has been quiet for
+ * CONFIG_CACHE_HOLDOFF_MS, or has been dirty for 4 times that, and no
+ * earlier write-back is still in progress. Changes made in the meantime
+ * coalesce into one range; a byte changed and changed back costs
+ * nothing, and the writer (lib/EepromWriter) skips bytes that already
+ * hold their value, so only bytes that really differ are programmed.
+ *
+ * - The write-back reads straight from the cache buffer, which stays
+ * valid; a byte changed while a write-back runs is dirty again and goes
+ * out with the next one.
+ *
+ * - Main loop only (no locking). The HAL needs storage_read(),
+ * storage_write(), storage_busy(), clock() and clock_hz().
+ *
+ * - Usage:
+ *   typedef ConfigCache<Hal, 0, 64> Config;
+ *   Config::load();
+ *   Config::write(offset, &value, sizeof(value));
+ *   loop: Config::poll();
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef CONFIG_CACHE_HOLDOFF_MS
+  #define CONFIG_CACHE_HOLDOFF_MS 500
+#endif
+
+template <class Hal, uint16_t BASE, uint16_t SIZE>
+class ConfigCache
+{
+public:
+  static constexpr uint16_t size = SIZE;
+
+  static void load()
+  {
+    Hal::storage_read(BASE, data_, SIZE);
+    lo_ = hi_ = 0;
+  }
+
+  static const uint8_t *data() { return data_; }
+
+  static void read(uint16_t offset, void *dst, uint16_t len)
+  {
+    memcpy(dst, data_ + offset, len);
+  }
+
+  /**
+   * @brief Change `len` bytes at `offset`
+   *
+   * @return true if any byte changed (and is now dirty)
+   */
+  static bool write(uint16_t offset, const void *src, uint16_t len)
+  {
+    const uint8_t *in = static_cast<const uint8_t *>(src);
+    uint16_t first = len, last = 0;
+    for (uint16_t i = 0; i < len; i++)
+      if (data_[offset + i] != in[i]) {
+        data_[offset + i] = in[i];
+        if (first == len)
+          first = i;
+        last = i + 1;
+      }
+    if (first == len)
+      return false;
+
+    const uint32_t now = Hal::clock();
+    if (!dirty()) {
+      lo_ = offset + first;
+      hi_ = offset + last;
+      dirty_since_ = now;
+    } else {
+      if (offset + first < lo_)
+        lo_ = offset + first;
+      if (offset + last > hi_)
+        hi_ = offset + last;
+    }
+    changed_at_ = now;
+    return true;
+  }
+
+  static bool dirty() { return hi_ != 0; }
+
+  // Main loop: write back when due
+  static void poll()
+  {
+    if (!dirty() || Hal::storage_busy())
+      return;
+    const uint32_t holdoff = Hal::clock_hz() / 1000 * CONFIG_CACHE_HOLDOFF_MS;
+    const uint32_t now = Hal::clock();
+    if (now - changed_at_ < holdoff && now - dirty_since_ < 4 * holdoff)
+      return;
+    write_back();
+  }
+
+  // Write back now (still in the background)
+  static bool flush()
+  {
+    return !dirty() || (!Hal::storage_busy() && write_back());
+  }
+
+  static uint16_t write_backs() { return write_backs_; }
+
+private:
+  static bool write_back()
+  {
+    if (!Hal::storage_write(BASE + lo_, data_ + lo_, hi_ - lo_))
+      return false;
+    lo_ = hi_ = 0;
+    write_backs_++;
+    return true;
+  }
+
+  static uint8_t data_[SIZE];
+  static uint16_t lo_, hi_;          // Dirty range, hi_ == 0: clean
+  static uint32_t changed_at_, dirty_since_;
+  static uint16_t write_backs_;
+};
+
+template <class Hal, uint16_t BASE, uint16_t SIZE> uint8_t ConfigCache<Hal, BASE, SIZE>::data_[SIZE];
+template <class Hal, uint16_t BASE, uint16_t SIZE> uint16_t ConfigCache<Hal, BASE, SIZE>::lo_ = 0;
+template <class Hal, uint16_t BASE, uint16_t SIZE> uint16_t ConfigCache<Hal, BASE, SIZE>::hi_ = 0;
+template <class Hal, uint16_t BASE, uint16_t SIZE> uint32_t ConfigCache<Hal, BASE, SIZE>::changed_at_ = 0;
+template <class Hal, uint16_t BASE, uint16_t SIZE> uint32_t ConfigCache<Hal, BASE, SIZE>::dirty_since_ = 0;
+template <class Hal, uint16_t BASE, uint16_t SIZE> uint16_t ConfigCache<Hal, BASE, SIZE>::write_backs_ = 0;
@@ -0,0 +1,40 @@
+/**
+ * @brief CoreBench - portable benchmark of the EstufaCore hot paths
+ *
+ *
+ * @notes:
+ * - Same code on every port, timed with the HAL clock:
+ *   static uint32_t Hal::clock();      free-running counter
+ *   static uint32_t Hal::clock_hz();   its frequency
+ *
+ * - report(name, ops, clocks) is called once per case; the port prints
+ * it (BENCH lines, like bench/Bench.h on AVR).
+ *
+ * - Cases:
+ *   core_tick        one schedule hour of every zone (timer interrupt path)
+ *   core_send        one full-chain refresh, snapshot + framing + driver
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define CORE_BENCH_TICKS  (24UL * 365)  // one simulated year
+#define CORE_BENCH_SENDS  64
+
+template <class Core, class Hal, class Report>
+void core_bench(Report report)
+{
+  Core::load_schedules();
+  Core::begin();
+
+  uint32_t start = Hal::clock();
+  for (uint32_t i = 0; i < CORE_BENCH_TICKS; i++)
+    Core::tick();
+  report("core_tick", CORE_BENCH_TICKS, Hal::clock() - start);
+
+  start = Hal::clock();
+  for (uint32_t i = 0; i < CORE_BENCH_SENDS; i++)
+    Core::send_relays();
+  report("core_send", CORE_BENCH_SENDS, Hal::clock() - start);
+}
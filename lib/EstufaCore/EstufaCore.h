@@ -0,0 +1,267 @@
+/**
+ * @brief EstufaCore - hardware-independent controller core
+ *
+ *
+ * @notes:
+ * - Zone schedules, relay framing and schedule image loading, with no
+ * Arduino, AVR or OS call: everything hardware-specific comes from the
+ * HAL class given as template parameter, so the same core runs on AVR
+ * (lib/HalAvr), STM32 under QEMU (lib/HalStm32) and the host
+ * (host/lib/HalNative), and every HAL call is resolved at compile time.
+ *
+ * - A HAL provides:
+ *   typedef <relay driver> Relay;     see lib/RelayBus/RelayDriver.h
+ *   class Critical;                   RAII, masks the tick interrupt
+ *   static void storage_read(uint16_t addr, void *dst, uint16_t len);
+ *   static bool storage_write(uint16_t addr, const void *src, uint16_t len);
+ *   static bool storage_busy();       writes may complete later
+ *   static uint32_t clock(); static uint32_t clock_hz();
+ *   static void storage_stats(StorageStats &s);     only for ModbusSlave
+ *
+ * - The schedule image is held in a ConfigCache (Config): set_zone()
+ * updates its entry and CRC in RAM, Config::poll() in the main loop
+ * writes the changed bytes back later. The first change turns an absent
+ * image into the compiled table plus that change.
+ *
+ * - Threading: tick() runs in the port's timer interrupt, once per
+ * schedule hour, and only flags a refresh. The port's main loop calls
+ * send_relays() when refresh_pending(); long chains are shifted out there.
+ *
+ * - Remote control (ModbusSlave.h) goes through set_channel() and
+ * set_zone(), from the main loop. A channel set by hand keeps its state
+ * until its zone's next scheduled toggle; channels past the last zone
+ * are only driven by hand.
+ *
+ * - Usage:
+ *   typedef EstufaCore<HalAvr<RelayOut>, NumModules> Core;
+ *   Core::load_schedules(); Core::begin();     setup
+ *   timer ISR -> Core::tick(); or Core::tick(toggled) to see which zones
+ *   if (Core::refresh_pending()) Core::send_relays();     loop
+ *   Core::Config::poll();                                  loop
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ConfigCache.h>
+#include <LightSchedule.h>
+#include <RelayFrame.h>
+#include <schedule_config.h>
+
+template <class Hal, uint16_t MODULES>
+class EstufaCore
+{
+public:
+  typedef typename Hal::Relay Relay;
+  typedef RelayFrame<MODULES, Relay::relays_per_module> Frame;
+  static constexpr uint16_t channels = Frame::channels;
+  static constexpr uint8_t zones = SCHEDULE_ZONES;
+  typedef ConfigCache<Hal, SCHEDULE_EEPROM_ADDR, SCHEDULE_IMAGE_SIZE(SCHEDULE_ZONES)> Config;
+
+  static_assert(SCHEDULE_ZONES <= Frame::channels, "more zones than relays in the chain");
+
+  /**
+   * @brief Load zone schedules
+   *
+   * @return SCHEDULE_IMAGE_OK if the stored image was used, else why the
+   * compiled table runs instead
+   */
+  static ScheduleImageStatus load_schedules()
+  {
+    Config::load();
+    ScheduleImageHeader hdr;
+    Config::read(0, &hdr, sizeof(hdr));
+
+    ScheduleImageStatus status = SCHEDULE_IMAGE_OK;
+    ScheduleEntry entries[SCHEDULE_ZONES];
+    if (hdr.magic[0] != 'E' || hdr.magic[1] != 'S')
+      status = SCHEDULE_IMAGE_ABSENT;
+    else if (hdr.version != SCHEDULE_IMAGE_VERSION)
+      status = SCHEDULE_IMAGE_OTHER_VERSION;
+    else if (hdr.count != SCHEDULE_ZONES)
+      status = SCHEDULE_IMAGE_ZONE_COUNT;
+    else if (schedule_crc8(Config::data(), Config::size - 1) != Config::data()[Config::size - 1])
+      status = SCHEDULE_IMAGE_CRC;
+    else {
+      Config::read(sizeof(hdr), entries, sizeof(entries));
+      for (uint8_t z = 0; status == SCHEDULE_IMAGE_OK && z < SCHEDULE_ZONES; z++)
+        if (!schedule_entry_valid(entries[z]))
+          status = SCHEDULE_IMAGE_ENTRY;
+    }
+
+    const bool from_storage = status == SCHEDULE_IMAGE_OK;
+    for (uint8_t z = 0; z < SCHEDULE_ZONES; z++)
+      schedules_[z] = schedule_from_entry(from_storage ? entries[z] : SCHEDULE_TABLE[z]);
+    image_valid_ = from_storage;
+    return status;
+  }
+
+  // Relays all OFF, then the initial zone states. Before the tick starts.
+  static void begin()
+  {
+    Relay::begin();
+    frame_.clear();
+    Relay::write_frame(frame_.bytes(), frame_.size());
+    send_relays();
+  }
+
+  /**
+   * @brief Advance every zone by one hour (timer interrupt)
+   *
+   * @param toggled called as toggled(zone, on) for each zone that
+   *        toggled, in zone order, from the same interrupt
+   * @return true if any zone toggled; a refresh is then pending
+   */
+  template <class Toggled>
+  static bool tick(Toggled toggled)
+  {
+    bool changed = false;
+    for (uint8_t z = 0; z < SCHEDULE_ZONES; z++)
+      if (schedules_[z].tick()) {
+        // The schedule takes its channel back
+        manual_[z / 8] &= uint8_t(~(1 << (z % 8)));
+        toggled(z, schedules_[z].is_on());
+        changed = true;
+      }
+    if (changed)
+      refresh_ = true;
+    return changed;
+  }
+
+  static bool tick()
+  {
+    return tick([](uint8_t, bool) {});
+  }
+
+  static bool refresh_pending() { return refresh_; }
+
+  /**
+   * @brief Send the zone states to the whole relay chain
+   *
+   * Zone z drives relay channel z (see RelayFrame::set_channel) unless
+   * the channel was set by hand. Only the snapshot runs inside a critical
+   * section.
+   *
+   * @return number of lit zones
+   */
+  static uint8_t send_relays()
+  {
+    bool on[SCHEDULE_ZONES];
+    uint8_t manual[sizeof(manual_)], manual_on[sizeof(manual_on_)];
+    {
+      typename Hal::Critical lock;
+      refresh_ = false;
+      for (uint8_t z = 0; z < SCHEDULE_ZONES; z++)
+        on[z] = schedules_[z].is_on();
+      memcpy(manual, manual_, sizeof(manual));
+      memcpy(manual_on, manual_on_, sizeof(manual_on));
+    }
+
+    frame_.clear();
+    uint8_t lit = 0;
+    for (uint16_t c = 0; c < channels; c++) {
+      bool state = (manual[c / 8] >> (c % 8)) & 1 ? (manual_on[c / 8] >> (c % 8)) & 1
+                 : c < SCHEDULE_ZONES ? on[c] : false;
+      frame_.set_channel(c, state);
+      if (c < SCHEDULE_ZONES)
+        lit += on[c];
+    }
+    Relay::write_frame(frame_.bytes(), frame_.size());
+    return lit;
+  }
+
+  // State channel c is driven to (sent with the next refresh if pending)
+  static bool channel(uint16_t c)
+  {
+    typename Hal::Critical lock;
+    if ((manual_[c / 8] >> (c % 8)) & 1)
+      return (manual_on_[c / 8] >> (c % 8)) & 1;
+    return c < SCHEDULE_ZONES && schedules_[c].is_on();
+  }
+
+  // Set channel c by hand, until its zone toggles (main loop)
+  static void set_channel(uint16_t c, bool on)
+  {
+    typename Hal::Critical lock;
+    manual_[c / 8] |= uint8_t(1 << (c % 8));
+    if (on)
+      manual_on_[c / 8] |= uint8_t(1 << (c % 8));
+    else
+      manual_on_[c / 8] &= uint8_t(~(1 << (c % 8)));
+    refresh_ = true;
+  }
+
+  // Zone z as a schedule entry, hour 0 = now
+  static ScheduleEntry zone(uint8_t z)
+  {
+    typename Hal::Critical lock;
+    return schedule_to_entry(schedules_[z]);
+  }
+
+  /**
+   * @brief Replace zone z's schedule (main loop)
+   *
+   * @return false if the entry is not valid (nothing changed)
+   */
+  static bool set_zone(uint8_t z, const ScheduleEntry &e)
+  {
+    if (!schedule_entry_valid(e))
+      return false;
+    {
+      typename Hal::Critical lock;
+      schedules_[z] = schedule_from_entry(e);
+      manual_[z / 8] &= uint8_t(~(1 << (z % 8)));
+      refresh_ = true;
+    }
+    store_zone(z, e);
+    return true;
+  }
+
+  // Read from the loop inside a Hal::Critical, or from the tick itself
+  static const LightSchedule &schedule(uint8_t zone) { return schedules_[zone]; }
+  static const Frame &frame() { return frame_; }
+
+private:
+  // Entry z of the cached image, and the image CRC
+  static void store_zone(uint8_t z, const ScheduleEntry &e)
+  {
+    if (!image_valid_) {
+      const ScheduleImageHeader hdr = {{'E', 'S'}, SCHEDULE_IMAGE_VERSION, SCHEDULE_ZONES};
+      Config::write(0, &hdr, sizeof(hdr));
+      for (uint8_t i = 0; i < SCHEDULE_ZONES; i++)
+        Config::write(sizeof(hdr) + i * sizeof(ScheduleEntry), &SCHEDULE_TABLE[i], sizeof(ScheduleEntry));
+      image_valid_ = true;
+    }
+    Config::write(sizeof(ScheduleImageHeader) + z * sizeof(ScheduleEntry), &e, sizeof(e));
+    const uint8_t crc = schedule_crc8(Config::data(), Config::size - 1);
+    Config::write(Config::size - 1, &crc, 1);
+  }
+
+  static LightSchedule schedules_[SCHEDULE_ZONES];
+  static Frame frame_;
+  static volatile bool refresh_;
+  // Channels set by hand, and their state
+  static uint8_t manual_[(channels + 7) / 8];
+  static uint8_t manual_on_[(channels + 7) / 8];
+  static bool image_valid_;
+};
+
+template <class Hal, uint16_t MODULES>
+LightSchedule EstufaCore<Hal, MODULES>::schedules_[SCHEDULE_ZONES];
+
+template <class Hal, uint16_t MODULES>
+typename EstufaCore<Hal, MODULES>::Frame EstufaCore<Hal, MODULES>::frame_;
+
+template <class Hal, uint16_t MODULES>
+volatile bool EstufaCore<Hal, MODULES>::refresh_ = false;
+
+template <class Hal, uint16_t MODULES>
+uint8_t EstufaCore<Hal, MODULES>::manual_[(channels + 7) / 8];
+
+template <class Hal, uint16_t MODULES>
+uint8_t EstufaCore<Hal, MODULES>::manual_on_[(channels + 7) / 8];
+
+template <class Hal, uint16_t MODULES>
+bool EstufaCore<Hal, MODULES>::image_valid_ = false;
@@ -0,0 +1,93 @@
+/**
+ * @brief EventLog - the last N relay events, addressed by sequence number
+ *
+ *
+ * @notes:
+ * - A RAM ring of 8-byte EventRecords: append() overwrites the oldest once
+ * full. Every record keeps the sequence number it was appended with
+ * (from 0, 32-bit), so a reader asks for records by number and can tell
+ * which ones it missed: read() fails for records already overwritten.
+ *
+ * - Main loop only (RelayEvents::poll hands the events over).
+ *
+ * - One record per toggled zone: its index (0..127) and new state share
+ * one byte on the wire, state in bit 7.
+ *
+ * - N is a power of two. RAM: 8 x N bytes + 4.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+struct EventRecord
+{
+  uint32_t hour;          // Hours since boot
+  uint8_t zone : 7;       // Zone that toggled
+  uint8_t on : 1;         // Its state after the toggle
+  uint8_t pool_in_use;    // RelayEvents pool, as with the #EVENT line
+  uint8_t pool_high;
+  uint8_t pool_failed;    // Saturates at 255
+};
+
+static_assert(sizeof(EventRecord) == 8, "EventRecord is sent as 8 bytes");
+
+// Little endian wire form, 8 bytes
+inline void event_record_pack(const EventRecord &r, uint8_t *p)
+{
+  p[0] = uint8_t(r.hour);
+  p[1] = uint8_t(r.hour >> 8);
+  p[2] = uint8_t(r.hour >> 16);
+  p[3] = uint8_t(r.hour >> 24);
+  p[4] = uint8_t(r.zone | r.on << 7);
+  p[5] = r.pool_in_use;
+  p[6] = r.pool_high;
+  p[7] = r.pool_failed;
+}
+
+inline EventRecord event_record_unpack(const uint8_t *p)
+{
+  EventRecord r;
+  r.hour = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+  r.zone = p[4] & 0x7F;
+  r.on = p[4] >> 7;
+  r.pool_in_use = p[5];
+  r.pool_high = p[6];
+  r.pool_failed = p[7];
+  return r;
+}
+
+template <uint16_t N>
+class EventLog
+{
+  static_assert(N > 0 && (N & (N - 1)) == 0, "EventLog size must be a power of two");
+
+public:
+  static constexpr uint16_t capacity = N;
+
+  static void append(const EventRecord &r)
+  {
+    records_[uint16_t(next_ % N)] = r;
+    next_++;
+  }
+
+  // Sequence number of the oldest record kept, and of the next one
+  static uint32_t first() { return next_ > N ? next_ - N : 0; }
+  static uint32_t end() { return next_; }
+
+  // false if `seq` was overwritten or is not written yet
+  static bool read(uint32_t seq, EventRecord &r)
+  {
+    if (seq < first() || seq >= next_)
+      return false;
+    r = records_[uint16_t(seq % N)];
+    return true;
+  }
+
+private:
+  static EventRecord records_[N];
+  static uint32_t next_;
+};
+
+template <uint16_t N> EventRecord EventLog<N>::records_[N];
+template <uint16_t N> uint32_t EventLog<N>::next_ = 0;
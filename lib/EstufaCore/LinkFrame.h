@@ -0,0 +1,116 @@
+/**
+ * @brief LinkFrame - COBS frames with a CRC, mixed into the status text stream
+ *
+ *
+ * @notes:
+ * - Frame: 0x00 COBS(payload crc_lo crc_hi) 0x00. COBS (Consistent
+ * Overhead Byte Stuffing) removes every 0x00 from the body, so 0x00 only
+ * ever delimits frames and a receiver finds the next frame boundary
+ * whatever it lost before. The status lines never contain 0x00: text
+ * and frames share the link, text being whatever lies outside a frame.
+ *
+ * - Overhead: the delimiters, one COBS code byte per 254 bytes and the
+ * CRC: 5 bytes for payloads up to LINK_FRAME_MAX (250, a frame of
+ * at most 255 bytes).
+ *
+ * - CRC-16/X-25 (reflected 0x1021, init 0xFFFF, the avr-libc
+ * _crc_ccitt_update step): a few shifts per byte, no table. The frame
+ * carries it complemented, so that run over payload and CRC it leaves
+ * LINK_CRC_GOOD. A plain CRC would leave 0, and a frame whose CRC ends
+ * in 0x00 would then still check with its last COBS byte lost.
+ *
+ * - link_decode() works in place: decoded bytes never overtake the ones
+ * still to read, so the payload is written over the encoded body in the
+ * buffer it arrived in. Buf is a pointer, or a ring view (RingSpan,
+ * lib/IsrSafe/FrameRing.h) for the firmware's receive ring: no copy on
+ * either end.
+ *
+ * - Portable: the firmware (through lib/SerialLink) and the host tools
+ * (host/estufalink) share it.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define LINK_FRAME_DELIMITER 0x00
+#define LINK_FRAME_MAX 250
+#define LINK_FRAME_OVERHEAD 5
+#define LINK_CRC_GOOD 0xF0B8
+
+inline uint16_t link_crc16_update(uint16_t crc, uint8_t data)
+{
+  data ^= uint8_t(crc);
+  data ^= uint8_t(data << 4);
+  return uint16_t((uint16_t(data) << 8 | uint8_t(crc >> 8)) ^ uint8_t(data >> 4) ^ (uint16_t(data) << 3));
+}
+
+inline uint16_t link_crc16(const uint8_t *data, uint8_t len, uint16_t crc = 0xFFFF)
+{
+  while (len--)
+    crc = link_crc16_update(crc, *data++);
+  return crc;
+}
+
+/**
+ * @brief Frame `len` payload bytes (at most LINK_FRAME_MAX) into `out`
+ *
+ * @param out len + LINK_FRAME_OVERHEAD bytes
+ * @return the frame size
+ */
+inline uint8_t link_frame(const uint8_t *payload, uint8_t len, uint8_t *out)
+{
+  const uint16_t crc = uint16_t(~link_crc16(payload, len));
+  out[0] = LINK_FRAME_DELIMITER;
+  uint8_t code_at = 1, w = 2, code = 1;
+  // At most 252 bytes: a run never outgrows one code byte
+  for (uint16_t i = 0; i < len + 2u; i++) {
+    const uint8_t c = i < len ? payload[i] : i == len ? uint8_t(crc) : uint8_t(crc >> 8);
+    if (c) {
+      out[w++] = c;
+      code++;
+    }
+    else {
+      out[code_at] = code;
+      code_at = w++;
+      code = 1;
+    }
+  }
+  out[code_at] = code;
+  out[w++] = LINK_FRAME_DELIMITER;
+  return w;
+}
+
+/**
+ * @brief Decode a frame body (no delimiters) in place and check its CRC
+ *
+ * @param b the body, b[0] .. b[n - 1]; pointer or ring view
+ * @return payload length, -1 if the body is not a valid frame
+ */
+template <class Buf>
+int16_t link_decode(Buf b, uint16_t n)
+{
+  uint16_t r = 0, w = 0, crc = 0xFFFF;
+  while (r < n) {
+    const uint8_t code = b[r++];
+    if (code == 0 || r + code - 1 > n)
+      return -1;
+    for (uint8_t i = 1; i < code; i++) {
+      const uint8_t c = b[r++];
+      b[w++] = c;
+      crc = link_crc16_update(crc, c);
+    }
+    if (code != 0xFF && r < n) {
+      b[w++] = 0;
+      crc = link_crc16_update(crc, 0);
+    }
+  }
+  return w >= 2 && crc == LINK_CRC_GOOD ? int16_t(w - 2) : -1;
+}
+
+// Little-endian 32-bit value at b[i] of a decoded payload
+template <class Buf>
+uint32_t link_get32(const Buf &b, uint16_t i)
+{
+  return uint32_t(b[i]) | uint32_t(b[i + 1]) << 8 | uint32_t(b[i + 2]) << 16 | uint32_t(b[i + 3]) << 24;
+}
@@ -0,0 +1,256 @@
+/**
+ * @brief LinkSession - host commands on the status link: baud upgrade, log
+ * dump, telemetry interval
+ *
+ *
+ * @notes:
+ * - Commands and answers are LinkFrames (lib/EstufaCore/LinkFrame.h), the
+ * first payload byte says which; numbers are little endian:
+ *   host                    device
+ *   'B' baud[4]             'B' ok baud[4]       switch rates (ok = 0: refused)
+ *   'P' nonce               'P' nonce baud[4]    probe / ping
+ *   'G' tag cursor[4] n[2]  'R' tag seq[4] k rec[8 x k] ...
+ *                           'N' tag next[4] first[4] end[4]
+ *                                                page of the event log
+ *   'I' ms[2]               'I' ok ms[2]         telemetry interval, 0 stops
+ *                                                it (ok = 0: no stream)
+ * Answers go out as RESPONSE, pages as BULK: status lines and telemetry
+ * keep flowing in between.
+ *
+ * - Baud upgrade: the device answers 'B' at the old rate, switches once
+ * that answer is on the wire, and waits up to LINK_PROBE_MS for a 'P' at
+ * the new rate. No probe (the adapter cannot do the rate, the cable is
+ * too long, the host gave up): it falls back to the base rate by itself.
+ * Once upgraded, LINK_FAST_IDLE_MS without a host frame also returns to
+ * the base rate, so a closed tool never leaves the port at 1 Mbaud with
+ * the serial monitor at 115200.
+ *
+ * - Log download in pages: 'G' asks for n records from sequence number
+ * `cursor` on; they come as 'R' chunks, each in its own frame and so
+ * under its own CRC, then 'N' closes the page with the cursor to ask for
+ * next and the range now in the log. The cursor is the host's
+ * acknowledgement: everything before it arrived intact. After a lost or
+ * damaged chunk the host asks again from where it was, and a download cut
+ * short resumes the same way, from the last cursor. The device keeps no
+ * state between pages; a new 'G' ends the current page at once.
+ *
+ * - Records overwritten before they were sent are skipped: a page starts
+ * at most at Log::first(), and 'N' says where that is. The page goes out
+ * as fast as the BULK queue takes it, never waiting; 'N' is queued
+ * behind the chunks, in order.
+ *
+ * - Commands are read where they were received: Port::frame() hands out
+ * each one decoded in its receive buffer, as a Port::Span.
+ *
+ * - Port: SerialLink, or anything with its static API (send, space,
+ * frame, release, idle, baud_ok, set_baud, max_frame, Span, RESPONSE,
+ * BULK). The HAL needs clock() and clock_hz(); Log is an EventLog. Tlm
+ * is the Telemetry whose interval 'I' sets, or a class with the same
+ * set_interval()/interval() and channels = 0 when there is none.
+ *
+ * - Main loop only.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "EventLog.h"
+#include "LinkFrame.h"
+
+#ifndef LINK_PROBE_MS
+  #define LINK_PROBE_MS      1000
+#endif
+#ifndef LINK_FAST_IDLE_MS
+  #define LINK_FAST_IDLE_MS  3000
+#endif
+
+#define LINK_CMD_BAUD   'B'
+#define LINK_CMD_PROBE  'P'
+#define LINK_CMD_PAGE   'G'
+#define LINK_RECORDS    'R'
+#define LINK_PAGE_END   'N'
+#define LINK_CMD_INTERVAL 'I'
+
+template <class Port, class Hal, class Log, class Tlm>
+class LinkSession
+{
+public:
+  static constexpr uint8_t chunk_records = (Port::max_frame - LINK_FRAME_OVERHEAD - 7) / sizeof(EventRecord);
+  static_assert(chunk_records > 0, "Port frames too short for a record");
+
+  static void begin(uint32_t base)
+  {
+    base_ = baud_ = base;
+    state_ = BASE;
+  }
+
+  static uint32_t baud() { return baud_; }
+  static bool paging() { return paging_; }
+
+  static void poll()
+  {
+    typename Port::Span f;
+    while (Port::frame(f)) {
+      seen_ = Hal::clock();
+      command(f);
+      Port::release();
+    }
+
+    switch (state_) {
+      case SWITCHING:
+        if (Port::idle()) {
+          Port::set_baud(baud_);
+          since_ = Hal::clock();
+          state_ = baud_ == base_ ? BASE : PROBING;
+        }
+        break;
+      case PROBING:
+        if (elapsed(since_, LINK_PROBE_MS))
+          fall_back();
+        break;
+      case FAST:
+        if (!paging_ && elapsed(seen_, LINK_FAST_IDLE_MS))
+          fall_back();
+        break;
+      default:
+        break;
+    }
+
+    if (paging_)
+      page();
+  }
+
+private:
+  enum State { BASE, SWITCHING, PROBING, FAST };
+
+  static bool elapsed(uint32_t since, uint16_t ms)
+  {
+    return uint32_t(Hal::clock() - since) >= Hal::clock_hz() / 1000 * ms;
+  }
+
+  static uint8_t *put32(uint8_t *p, uint32_t v)
+  {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+    p[2] = uint8_t(v >> 16);
+    p[3] = uint8_t(v >> 24);
+    return p + 4;
+  }
+
+  static bool reply(uint8_t prio, const uint8_t *payload, uint8_t len)
+  {
+    uint8_t frame[Port::max_frame];
+    return Port::send(prio, frame, link_frame(payload, len, frame));
+  }
+
+  // Payload decoded in the receive ring
+  static void command(const typename Port::Span &p)
+  {
+    const uint8_t len = p.len;
+    uint8_t out[6];
+    switch (len ? p[0] : 0) {
+      case LINK_CMD_BAUD:
+        if (len == 5) {
+          const uint32_t want = link_get32(p, 1);
+          const bool ok = state_ != SWITCHING && Port::baud_ok(want);
+          out[0] = LINK_CMD_BAUD;
+          out[1] = ok;
+          put32(out + 2, want);
+          reply(Port::RESPONSE, out, 6);
+          if (ok && want != baud_) {
+            baud_ = want;
+            state_ = SWITCHING;
+          }
+        }
+        break;
+      case LINK_CMD_PROBE:
+        if (len == 2) {
+          if (state_ == PROBING)
+            state_ = baud_ == base_ ? BASE : FAST;
+          out[0] = LINK_CMD_PROBE;
+          out[1] = p[1];
+          put32(out + 2, baud_);
+          reply(Port::RESPONSE, out, 6);
+        }
+        break;
+      case LINK_CMD_PAGE:
+        if (len == 8) {
+          tag_ = p[1];
+          cursor_ = link_get32(p, 2);
+          page_end_ = cursor_ + (uint16_t(p[6]) | uint16_t(p[7]) << 8);
+          paging_ = true;
+        }
+        break;
+      case LINK_CMD_INTERVAL:
+        if (len == 3) {
+          if (Tlm::channels)
+            Tlm::set_interval(uint16_t(p[1] | p[2] << 8));
+          const uint16_t ms = Tlm::interval();
+          out[0] = LINK_CMD_INTERVAL;
+          out[1] = Tlm::channels != 0;
+          out[2] = uint8_t(ms);
+          out[3] = uint8_t(ms >> 8);
+          reply(Port::RESPONSE, out, 4);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  static void fall_back()
+  {
+    baud_ = base_;
+    state_ = SWITCHING;
+  }
+
+  static void page()
+  {
+    const uint8_t frame_max = 7 + chunk_records * sizeof(EventRecord) + LINK_FRAME_OVERHEAD;
+    while (paging_ && Port::space(Port::BULK) >= frame_max) {
+      if (cursor_ < Log::first())
+        cursor_ = Log::first();
+      const uint32_t end = Log::end();
+      const uint32_t stop = page_end_ < end ? page_end_ : end;
+      if (cursor_ >= stop) {
+        uint8_t out[14] = {LINK_PAGE_END, tag_};
+        put32(put32(put32(out + 2, cursor_), Log::first()), end);
+        reply(Port::BULK, out, 14);
+        paging_ = false;
+        break;
+      }
+      uint8_t payload[7 + chunk_records * sizeof(EventRecord)];
+      payload[0] = LINK_RECORDS;
+      payload[1] = tag_;
+      put32(payload + 2, cursor_);
+      uint8_t n = 0;
+      EventRecord r;
+      while (n < chunk_records && cursor_ < stop && Log::read(cursor_, r)) {
+        event_record_pack(r, payload + 7 + n * sizeof(EventRecord));
+        n++;
+        cursor_++;
+      }
+      payload[6] = n;
+      if (n)
+        reply(Port::BULK, payload, uint8_t(7 + n * sizeof(EventRecord)));
+    }
+  }
+
+  static State state_;
+  static uint32_t base_, baud_;
+  static uint32_t since_, seen_;
+  static bool paging_;
+  static uint8_t tag_;
+  static uint32_t cursor_, page_end_;
+};
+
+template <class Port, class Hal, class Log, class Tlm> typename LinkSession<Port, Hal, Log, Tlm>::State LinkSession<Port, Hal, Log, Tlm>::state_;
+template <class Port, class Hal, class Log, class Tlm> uint32_t LinkSession<Port, Hal, Log, Tlm>::base_ = 0;
+template <class Port, class Hal, class Log, class Tlm> uint32_t LinkSession<Port, Hal, Log, Tlm>::baud_ = 0;
+template <class Port, class Hal, class Log, class Tlm> uint32_t LinkSession<Port, Hal, Log, Tlm>::since_ = 0;
+template <class Port, class Hal, class Log, class Tlm> uint32_t LinkSession<Port, Hal, Log, Tlm>::seen_ = 0;
+template <class Port, class Hal, class Log, class Tlm> bool LinkSession<Port, Hal, Log, Tlm>::paging_ = false;
+template <class Port, class Hal, class Log, class Tlm> uint8_t LinkSession<Port, Hal, Log, Tlm>::tag_ = 0;
+template <class Port, class Hal, class Log, class Tlm> uint32_t LinkSession<Port, Hal, Log, Tlm>::cursor_ = 0;
+template <class Port, class Hal, class Log, class Tlm> uint32_t LinkSession<Port, Hal, Log, Tlm>::page_end_ = 0;
@@ -0,0 +1,425 @@
+/**
+ * @brief ModbusSlave - Modbus RTU request handling for EstufaCore
+ *
+ *
+ * @notes:
+ * - Hardware independent: takes one complete RTU frame (address, PDU,
+ * CRC) as delimited by the port's transport (lib/RtuSerial on AVR,
+ * host/lib/ModbusRtu on the host) and builds the response frame.
+ *
+ * - Data model:
+ *   Coils 0..channels-1     relay channels. Read: state the channel is
+ *                           driven to. Write: set by hand (see EstufaCore)
+ *   Holding registers       4 per zone, zone z at 4*z:
+ *     +0 light hours  +1 dark hours  +2 lit (0/1)  +3 hours into phase
+ *   A write replaces the zone's schedule from "now"; the whole request
+ *   is rejected (exception 03) if any touched zone would be invalid.
+ *
+ * - Function codes: 01 read coils, 03 read holding registers, 05 write
+ * single coil, 06 write single register, 15 write multiple coils,
+ * 16 write multiple registers. Others answer exception 01.
+ *
+ * - Address 0 is broadcast: writes are applied, nothing is answered.
+ *
+ * - Multidrop (RS-485): the slave address lives in storage at
+ * MODBUS_ADDRESS_STORAGE, read by begin(). Register 0x0400 reads it and,
+ * written with function 06, stores a new one (1..247). The answer still
+ * comes from the old address; the next request must use the new one.
+ * Hal needs storage_read() and storage_write(); a full write queue
+ * answers exception 06 (busy).
+ *
+ * - Storage: 0x0600 read 5, Hal::storage_stats(): jobs pending, done,
+ * failed, bytes written, bytes skipped (already holding the value).
+ *
+ * - Time sync (Clock = TimeSync<Hal>, see TimeSync.h), 64-bit values
+ * as 4 registers, most significant first, times in device us:
+ *   0x0500  read 16   +0 this request received   +4 previous request
+ *                     received   +8 previous response sent
+ *                     +12 rate (ppb, int32)  +14 offset still to slew (us)
+ *   0x0510  write     +0 offset to slew in (us, int32), +2 rate (ppb,
+ *                     int32), +4 offset to step by (us, int64); any
+ *                     aligned run of these, not by broadcast
+ *   Without a Clock (NoTimeSync) these answer exception 02.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <ScheduleTable.h>
+#include <StorageStats.h>
+
+#define MODBUS_BROADCAST          0
+#define MODBUS_MAX_ADDRESS        247
+#define MODBUS_REGS_PER_ZONE      4
+#define MODBUS_REG_ADDRESS        0x0400   // Slave address register
+
+#define MODBUS_REG_TIME           0x0500   // Time sync stamps, 16 registers
+#define MODBUS_REG_TIME_CORRECT   0x0510   // Offset, rate, step: 8 registers
+#define MODBUS_TIME_REGS          16
+#define MODBUS_REG_STORAGE        0x0600   // StorageStats, 5 registers
+
+#ifndef MODBUS_ADDRESS_STORAGE
+  #define MODBUS_ADDRESS_STORAGE  1023     // Last EEPROM byte of an ATmega328P
+#endif
+
+#define MODBUS_READ_COILS         0x01
+#define MODBUS_READ_HOLDING       0x03
+#define MODBUS_WRITE_COIL         0x05
+#define MODBUS_WRITE_REGISTER     0x06
+#define MODBUS_WRITE_COILS        0x0F
+#define MODBUS_WRITE_REGISTERS    0x10
+
+#define MODBUS_ILLEGAL_FUNCTION   0x01
+#define MODBUS_ILLEGAL_ADDRESS    0x02
+#define MODBUS_ILLEGAL_VALUE      0x03
+#define MODBUS_DEVICE_BUSY        0x06
+
+// CRC-16/MODBUS (poly 0xA001 reflected, init 0xFFFF), sent low byte first
+inline uint16_t modbus_crc16(const uint8_t *data, uint16_t len, uint16_t crc = 0xFFFF)
+{
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+// ModbusSlave without time registers
+struct NoTimeSync
+{
+  static constexpr bool enabled = false;
+  static void request(uint32_t, uint32_t) {}
+  static uint64_t request_us() { return 0; }
+  static uint64_t prev_request_us() { return 0; }
+  static uint64_t prev_response_us() { return 0; }
+  static void correct(int32_t) {}
+  static void step(int64_t) {}
+  static void set_rate(int32_t) {}
+  static int32_t rate_ppb() { return 0; }
+  static int32_t slew_pending_us() { return 0; }
+};
+
+template <class Core, class Hal, class Clock = NoTimeSync>
+class ModbusSlave
+{
+public:
+  static constexpr uint16_t registers = Core::zones * MODBUS_REGS_PER_ZONE;
+
+  // Stored address, or `fallback` if none was ever set
+  static void begin(uint8_t fallback)
+  {
+    uint8_t a;
+    Hal::storage_read(MODBUS_ADDRESS_STORAGE, &a, 1);
+    address_ = a != MODBUS_BROADCAST && a <= MODBUS_MAX_ADDRESS ? a : fallback;
+  }
+
+  static void set_address(uint8_t address) { address_ = address; }
+  static uint8_t address() { return address_; }
+
+  /**
+   * @brief Handle one RTU frame
+   *
+   * @param resp buffer for the response frame, resp_size bytes
+   * @param rx_stamp, tx_stamp raw clock stamps for the Clock: first byte
+   *        of this request, first byte of the last response sent
+   * @return response length, 0 when nothing must be sent (bad CRC,
+   *         other slave, broadcast)
+   */
+  static uint16_t handle(const uint8_t *req, uint16_t len, uint8_t *resp, uint16_t resp_size,
+                         uint32_t rx_stamp = 0, uint32_t tx_stamp = 0)
+  {
+    if (len < 4)
+      return 0;
+    uint16_t crc = modbus_crc16(req, len - 2);
+    if (req[len - 2] != (crc & 0xFF) || req[len - 1] != (crc >> 8))
+      return 0;
+    if (req[0] != address_ && req[0] != MODBUS_BROADCAST)
+      return 0;
+
+    Pdu p = {req + 1, uint16_t(len - 3), resp + 1, uint16_t(resp_size - 3), 0};
+    broadcast_ = req[0] == MODBUS_BROADCAST;
+    if (!broadcast_)
+      Clock::request(rx_stamp, tx_stamp);
+    uint8_t exception = dispatch(p);
+    if (broadcast_)
+      return 0;
+
+    resp[0] = address_;
+    if (exception) {
+      resp[1] = req[1] | 0x80;
+      resp[2] = exception;
+      p.out_len = 2;
+    }
+    uint16_t n = p.out_len + 1;
+    crc = modbus_crc16(resp, n);
+    resp[n++] = crc & 0xFF;
+    resp[n++] = crc >> 8;
+    if (new_address_) {
+      address_ = new_address_;
+      new_address_ = 0;
+    }
+    return n;
+  }
+
+private:
+  struct Pdu
+  {
+    const uint8_t *in;
+    uint16_t in_len;
+    uint8_t *out;
+    uint16_t out_size;
+    uint16_t out_len;
+  };
+
+  static uint16_t be16(const uint8_t *p) { return uint16_t(p[0] << 8 | p[1]); }
+
+  static void put16(uint8_t *p, uint16_t v)
+  {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+  }
+
+  static bool supported(uint8_t fn)
+  {
+    return fn == MODBUS_READ_COILS || fn == MODBUS_READ_HOLDING || fn == MODBUS_WRITE_COIL ||
+           fn == MODBUS_WRITE_REGISTER || fn == MODBUS_WRITE_COILS || fn == MODBUS_WRITE_REGISTERS;
+  }
+
+  static uint8_t dispatch(Pdu &p)
+  {
+    // The function code first: a short unsupported request is still 01
+    if (!supported(p.in[0]))
+      return MODBUS_ILLEGAL_FUNCTION;
+    if (p.in_len < 5)
+      return MODBUS_ILLEGAL_VALUE;
+    const uint8_t fn = p.in[0];
+    const uint16_t start = be16(p.in + 1);
+    const uint16_t value = be16(p.in + 3);
+    p.out[0] = fn;
+
+    switch (fn) {
+      case MODBUS_READ_COILS:
+        return read_coils(p, start, value);
+      case MODBUS_READ_HOLDING:
+        return read_registers(p, start, value);
+      case MODBUS_WRITE_COIL:
+        if (start >= Core::channels)
+          return MODBUS_ILLEGAL_ADDRESS;
+        if (value != 0xFF00 && value != 0x0000)
+          return MODBUS_ILLEGAL_VALUE;
+        Core::set_channel(start, value == 0xFF00);
+        return echo(p, 5);
+      case MODBUS_WRITE_REGISTER:
+        if (start == MODBUS_REG_ADDRESS)
+          return write_address(p, value);
+        if (start >= registers)
+          return MODBUS_ILLEGAL_ADDRESS;
+        return write_registers(start, 1, p.in + 3) ? MODBUS_ILLEGAL_VALUE : echo(p, 5);
+      case MODBUS_WRITE_COILS:
+        return write_coils(p, start, value);
+      case MODBUS_WRITE_REGISTERS:
+        if (p.in_len < 6 || value == 0 || p.in[5] != value * 2 || p.in_len < 6U + p.in[5])
+          return MODBUS_ILLEGAL_VALUE;
+        if (start >= MODBUS_REG_TIME_CORRECT && start < MODBUS_REG_TIME_CORRECT + 8)
+          return write_time(p, start, value);
+        if (uint32_t(start) + value > registers)
+          return MODBUS_ILLEGAL_ADDRESS;
+        return write_registers(start, value, p.in + 6) ? MODBUS_ILLEGAL_VALUE : echo(p, 5);
+      default:
+        return MODBUS_ILLEGAL_FUNCTION;
+    }
+  }
+
+  // Write responses repeat the first `n` request bytes
+  static uint8_t echo(Pdu &p, uint16_t n)
+  {
+    for (uint16_t i = 0; i < n; i++)
+      p.out[i] = p.in[i];
+    p.out_len = n;
+    return 0;
+  }
+
+  static uint8_t read_coils(Pdu &p, uint16_t start, uint16_t count)
+  {
+    const uint16_t bytes = (count + 7) / 8;
+    if (count == 0 || 2U + bytes > p.out_size)
+      return MODBUS_ILLEGAL_VALUE;
+    if (uint32_t(start) + count > Core::channels)
+      return MODBUS_ILLEGAL_ADDRESS;
+    p.out[1] = uint8_t(bytes);
+    for (uint16_t i = 0; i < bytes; i++)
+      p.out[2 + i] = 0;
+    for (uint16_t i = 0; i < count; i++)
+      if (Core::channel(start + i))
+        p.out[2 + i / 8] |= uint8_t(1 << (i % 8));
+    p.out_len = 2 + bytes;
+    return 0;
+  }
+
+  static uint8_t write_coils(Pdu &p, uint16_t start, uint16_t count)
+  {
+    const uint16_t bytes = (count + 7) / 8;
+    if (count == 0 || p.in_len < 6 || p.in[5] != bytes || p.in_len < 6U + bytes)
+      return MODBUS_ILLEGAL_VALUE;
+    if (uint32_t(start) + count > Core::channels)
+      return MODBUS_ILLEGAL_ADDRESS;
+    for (uint16_t i = 0; i < count; i++)
+      Core::set_channel(start + i, (p.in[6 + i / 8] >> (i % 8)) & 1);
+    return echo(p, 5);
+  }
+
+  static uint8_t read_registers(Pdu &p, uint16_t start, uint16_t count)
+  {
+    if (count == 0 || 2U + 2U * count > p.out_size)
+      return MODBUS_ILLEGAL_VALUE;
+    if (start == MODBUS_REG_ADDRESS && count == 1) {
+      p.out[1] = 2;
+      put16(p.out + 2, address_);
+      p.out_len = 4;
+      return 0;
+    }
+    if (start == MODBUS_REG_STORAGE && count <= 5) {
+      StorageStats st;
+      Hal::storage_stats(st);
+      const uint16_t v[5] = {st.pending, st.done, st.failed, st.written, st.skipped};
+      p.out[1] = uint8_t(2 * count);
+      for (uint16_t i = 0; i < count; i++)
+        put16(p.out + 2 + 2 * i, v[i]);
+      p.out_len = 2 + 2 * count;
+      return 0;
+    }
+    if (start >= MODBUS_REG_TIME && start < MODBUS_REG_TIME + MODBUS_TIME_REGS) {
+      if (!Clock::enabled || uint32_t(start) + count > MODBUS_REG_TIME + MODBUS_TIME_REGS)
+        return MODBUS_ILLEGAL_ADDRESS;
+      p.out[1] = uint8_t(2 * count);
+      for (uint16_t i = 0; i < count; i++)
+        put16(p.out + 2 + 2 * i, time_register(start - MODBUS_REG_TIME + i));
+      p.out_len = 2 + 2 * count;
+      return 0;
+    }
+    if (uint32_t(start) + count > registers)
+      return MODBUS_ILLEGAL_ADDRESS;
+    p.out[1] = uint8_t(2 * count);
+    for (uint16_t i = 0; i < count; i++) {
+      const uint16_t reg = start + i;
+      const ScheduleEntry e = Core::zone(reg / MODBUS_REGS_PER_ZONE);
+      put16(p.out + 2 + 2 * i, field(e, reg % MODBUS_REGS_PER_ZONE));
+    }
+    p.out_len = 2 + 2 * count;
+    return 0;
+  }
+
+  // Not by broadcast: every slave on the bus would take the same address
+  static uint8_t write_address(Pdu &p, uint16_t value)
+  {
+    if (value == MODBUS_BROADCAST || value > MODBUS_MAX_ADDRESS || broadcast_)
+      return MODBUS_ILLEGAL_VALUE;
+    // Written in the background: the source has to outlive this call
+    static uint8_t stored;
+    stored = uint8_t(value);
+    if (!Hal::storage_write(MODBUS_ADDRESS_STORAGE, &stored, 1))
+      return MODBUS_DEVICE_BUSY;
+    new_address_ = stored;
+    return echo(p, 5);
+  }
+
+  static uint16_t time_register(uint16_t r)
+  {
+    if (r < 12) {
+      const uint64_t t = r < 4 ? Clock::request_us() : r < 8 ? Clock::prev_request_us()
+                                                             : Clock::prev_response_us();
+      return uint16_t(t >> (16 * (3 - r % 4)));
+    }
+    const uint32_t v = uint32_t(r < 14 ? Clock::rate_ppb() : Clock::slew_pending_us());
+    return r % 2 ? uint16_t(v) : uint16_t(v >> 16);
+  }
+
+  // Slew offset (+0,+1), rate (+2,+3), step (+4..+7) at MODBUS_REG_TIME_CORRECT
+  static uint8_t write_time(Pdu &p, uint16_t start, uint16_t count)
+  {
+    const uint16_t r = start - MODBUS_REG_TIME_CORRECT;
+    // 32-bit values whole, the step all 4 registers
+    if (!Clock::enabled || r % 2 || count % 2 || r + count > 8 || (r + count > 4 && (r > 4 || r + count < 8)))
+      return MODBUS_ILLEGAL_ADDRESS;
+    if (broadcast_)
+      return MODBUS_ILLEGAL_VALUE;
+    for (uint16_t i = 0; i < count; i += 2) {
+      const uint8_t *v = p.in + 6 + 2 * i;
+      const uint32_t hi = uint32_t(be16(v)) << 16 | be16(v + 2);
+      if (r + i == 0) {
+        Clock::correct(int32_t(hi));
+      } else if (r + i == 2) {
+        Clock::set_rate(int32_t(hi));
+      } else {
+        Clock::step(int64_t(uint64_t(hi) << 32 | uint32_t(be16(v + 4)) << 16 | be16(v + 6)));
+        i += 2;
+      }
+    }
+    return echo(p, 5);
+  }
+
+  /**
+   * @brief Apply `count` big-endian register values starting at `start`
+   *
+   * Zones are validated as a whole before anything is written.
+   *
+   * @return true if a zone would be invalid (nothing written)
+   */
+  static bool write_registers(uint16_t start, uint16_t count, const uint8_t *values)
+  {
+    if (start >= registers || uint32_t(start) + count > registers)
+      return true;
+    const uint8_t first = start / MODBUS_REGS_PER_ZONE;
+    const uint8_t last = (start + count - 1) / MODBUS_REGS_PER_ZONE;
+    for (uint8_t pass = 0; pass < 2; pass++)
+      for (uint8_t z = first; z <= last; z++) {
+        ScheduleEntry e = Core::zone(z);
+        for (uint16_t i = 0; i < count; i++) {
+          const uint16_t reg = start + i;
+          if (reg / MODBUS_REGS_PER_ZONE != z)
+            continue;
+          const uint16_t v = be16(values + 2 * i);
+          if (v > 0xFF)
+            return true;
+          set_field(e, reg % MODBUS_REGS_PER_ZONE, uint8_t(v));
+        }
+        // pass 0 validates every zone, pass 1 applies
+        if (pass == 0 ? !schedule_entry_valid(e) : !Core::set_zone(z, e))
+          return true;
+      }
+    return false;
+  }
+
+  static uint16_t field(const ScheduleEntry &e, uint8_t f)
+  {
+    switch (f) {
+      case 0: return e.light_hours;
+      case 1: return e.dark_hours;
+      case 2: return e.start_on;
+      default: return e.start_hours;
+    }
+  }
+
+  static void set_field(ScheduleEntry &e, uint8_t f, uint8_t v)
+  {
+    switch (f) {
+      case 0: e.light_hours = v; break;
+      case 1: e.dark_hours = v; break;
+      case 2: e.start_on = v; break;
+      default: e.start_hours = v; break;
+    }
+  }
+
+  static uint8_t address_;
+  static uint8_t new_address_;
+  static bool broadcast_;
+};
+
+template <class Core, class Hal, class Clock>
+uint8_t ModbusSlave<Core, Hal, Clock>::address_ = 1;
+template <class Core, class Hal, class Clock>
+uint8_t ModbusSlave<Core, Hal, Clock>::new_address_ = 0;
+template <class Core, class Hal, class Clock>
+bool ModbusSlave<Core, Hal, Clock>::broadcast_ = false;
@@ -0,0 +1,22 @@
+/**
+ * @brief StorageStats - counters of a HAL's persistent storage writes
+ *
+ *
+ * @notes:
+ * - Filled by Hal::storage_stats(), shown to the host as Modbus
+ * registers 0x0600.. (ModbusSlave.h).
+ * - Byte counters wrap at 65536.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+struct StorageStats
+{
+  uint16_t pending;   // Write jobs queued or in progress
+  uint16_t done;      // Jobs completed and verified
+  uint16_t failed;    // Jobs abandoned: a byte did not read back
+  uint16_t written;   // Bytes programmed
+  uint16_t skipped;   // Bytes left alone, already holding the value
+};
@@ -0,0 +1,191 @@
+/**
+ * @brief Telemetry - periodic snapshot records aggregated on the device
+ *
+ *
+ * @notes:
+ * - CH channels are sampled every TELEMETRY_SAMPLE_MS; every interval
+ * (TELEMETRY_INTERVAL_MS by default, set_interval() at run time, which
+ * LinkSession's 'I' command calls; 0 stops the stream) the min, max and
+ * mean of each channel go out as one record, so the link carries one
+ * summary instead of every sample.
+ *
+ * - Record, little endian (telemetry_decode() reads it back):
+ *   'T' channels seq[2] end_ms[4] samples[2] { min[2] max[2] mean[2] } x CH
+ * 10 + 6 x CH bytes: 34 for 4 channels.
+ *
+ * - Values are int16_t; the sampler scales its sensors to fit.
+ *
+ * - Main loop only. The HAL needs clock() and clock_hz().
+ *
+ * - Usage:
+ *   typedef Telemetry<Hal, 3> Tlm;
+ *   loop: Tlm::poll([](int16_t *v) { v[0] = ...; },
+ *                   [](const uint8_t *rec, uint8_t len) { send(rec, len); });
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifndef TELEMETRY_SAMPLE_MS
+  #define TELEMETRY_SAMPLE_MS    100
+#endif
+#ifndef TELEMETRY_INTERVAL_MS
+  #define TELEMETRY_INTERVAL_MS  5000
+#endif
+
+#define TELEMETRY_RECORD 'T'
+#define TELEMETRY_HEADER 10
+#define TELEMETRY_SIZE(ch) (TELEMETRY_HEADER + 6 * (ch))
+
+struct TelemetryStat
+{
+  int16_t min;
+  int16_t max;
+  int16_t mean;
+};
+
+template <class Hal, uint8_t CH>
+class Telemetry
+{
+  static_assert(CH > 0 && TELEMETRY_SIZE(CH) <= 255, "Telemetry record must fit one frame");
+
+public:
+  static constexpr uint8_t channels = CH;
+  static constexpr uint8_t record_size = TELEMETRY_SIZE(CH);
+
+  static void set_interval(uint16_t ms)
+  {
+    interval_ms_ = ms;
+    reset();
+  }
+  static uint16_t interval() { return interval_ms_; }
+
+  // Fold one sample in
+  static void add(const int16_t *v)
+  {
+    for (uint8_t c = 0; c < CH; c++) {
+      if (!count_ || v[c] < min_[c])
+        min_[c] = v[c];
+      if (!count_ || v[c] > max_[c])
+        max_[c] = v[c];
+      sum_[c] += v[c];
+    }
+    count_++;
+  }
+
+  // Record of the samples so far, then start a new interval
+  static uint8_t snapshot(uint8_t *rec)
+  {
+    uint8_t *p = rec;
+    *p++ = TELEMETRY_RECORD;
+    *p++ = CH;
+    p = put16(p, seq_++);
+    p = put32(p, ms_);
+    p = put16(p, count_);
+    for (uint8_t c = 0; c < CH; c++) {
+      p = put16(p, uint16_t(count_ ? min_[c] : 0));
+      p = put16(p, uint16_t(count_ ? max_[c] : 0));
+      p = put16(p, uint16_t(count_ ? int16_t(sum_[c] / int32_t(count_)) : 0));
+    }
+    reset();
+    return record_size;
+  }
+
+  /**
+   * @brief Main loop: sample and emit when due
+   *
+   * @param sample void(int16_t values[CH])
+   * @param emit void(const uint8_t *record, uint8_t len)
+   */
+  template <class Sample, class Emit>
+  static void poll(Sample sample, Emit emit)
+  {
+    const uint32_t now = Hal::clock();
+    const uint32_t tick = Hal::clock_hz() / 1000 * TELEMETRY_SAMPLE_MS;
+    if (now - last_ < tick)
+      return;
+    last_ += tick;
+    if (now - last_ >= tick)      // Fell behind (long frame): skip ahead
+      last_ = now;
+    ms_ += TELEMETRY_SAMPLE_MS;
+    if (!interval_ms_)
+      return;
+
+    int16_t v[CH];
+    sample(v);
+    add(v);
+    elapsed_ms_ += TELEMETRY_SAMPLE_MS;
+    if (elapsed_ms_ >= interval_ms_) {
+      uint8_t rec[record_size];
+      emit(rec, snapshot(rec));
+    }
+  }
+
+private:
+  static void reset()
+  {
+    count_ = 0;
+    elapsed_ms_ = 0;
+    for (uint8_t c = 0; c < CH; c++)
+      sum_[c] = 0;
+  }
+
+  static uint8_t *put16(uint8_t *p, uint16_t v)
+  {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+    return p + 2;
+  }
+
+  static uint8_t *put32(uint8_t *p, uint32_t v)
+  {
+    return put16(put16(p, uint16_t(v)), uint16_t(v >> 16));
+  }
+
+  static int16_t min_[CH], max_[CH];
+  static int32_t sum_[CH];
+  static uint16_t count_;
+  static uint16_t seq_;
+  static uint16_t interval_ms_;
+  static uint16_t elapsed_ms_;
+  static uint32_t ms_;           // Sample clock, ms since begin
+  static uint32_t last_;
+};
+
+template <class Hal, uint8_t CH> int16_t Telemetry<Hal, CH>::min_[CH];
+template <class Hal, uint8_t CH> int16_t Telemetry<Hal, CH>::max_[CH];
+template <class Hal, uint8_t CH> int32_t Telemetry<Hal, CH>::sum_[CH];
+template <class Hal, uint8_t CH> uint16_t Telemetry<Hal, CH>::count_ = 0;
+template <class Hal, uint8_t CH> uint16_t Telemetry<Hal, CH>::seq_ = 0;
+template <class Hal, uint8_t CH> uint16_t Telemetry<Hal, CH>::interval_ms_ = TELEMETRY_INTERVAL_MS;
+template <class Hal, uint8_t CH> uint16_t Telemetry<Hal, CH>::elapsed_ms_ = 0;
+template <class Hal, uint8_t CH> uint32_t Telemetry<Hal, CH>::ms_ = 0;
+template <class Hal, uint8_t CH> uint32_t Telemetry<Hal, CH>::last_ = 0;
+
+
+/**
+ * @brief Host side: read a record back
+ *
+ * @param stats CH entries
+ * @return channels in the record, 0 if it is not a valid record
+ */
+inline uint8_t telemetry_decode(const uint8_t *rec, uint8_t len, uint16_t &seq, uint32_t &end_ms,
+                                uint16_t &samples, TelemetryStat *stats, uint8_t max_channels)
+{
+  if (len < TELEMETRY_HEADER || rec[0] != TELEMETRY_RECORD)
+    return 0;
+  const uint8_t ch = rec[1];
+  if (ch == 0 || ch > max_channels || len != TELEMETRY_SIZE(ch))
+    return 0;
+  seq = uint16_t(rec[2] | rec[3] << 8);
+  end_ms = uint32_t(rec[4]) | uint32_t(rec[5]) << 8 | uint32_t(rec[6]) << 16 | uint32_t(rec[7]) << 24;
+  samples = uint16_t(rec[8] | rec[9] << 8);
+  const uint8_t *p = rec + TELEMETRY_HEADER;
+  for (uint8_t c = 0; c < ch; c++, p += 6) {
+    stats[c].min = int16_t(p[0] | p[1] << 8);
+    stats[c].max = int16_t(p[2] | p[3] << 8);
+    stats[c].mean = int16_t(p[4] | p[5] << 8);
+  }
+  return ch;
+}
@@ -0,0 +1,150 @@
+/**
+ * @brief TimeSync - disciplined device time base
+ *
+ *
+ * @notes:
+ * - Device time is a 64-bit microsecond count derived from the HAL's
+ * free-running clock, corrected by the host (ModbusSlave time registers):
+ *   rate     frequency correction in ppb, applied continuously
+ *   offset   added by slewing, at most TIME_SYNC_SLEW_PPM of elapsed
+ *            time, so device time never jumps and never runs backwards;
+ *            only corrections above TIME_SYNC_STEP_US are stepped
+ *   step     explicit jump, for the first sync after boot (device time
+ *            starts at 0, fleet time is the host's wall clock)
+ *
+ * - Exchange stamps: the transport takes raw Hal::clock() stamps in its
+ * interrupts (first byte of a request received, first byte of a response
+ * sent) and request() turns them into device time. The host gets, with
+ * each request, the receive time of that request and the receive/send
+ * times of the previous one, NTP style: t1 host send, t2 device receive,
+ * t3 device send, t4 host receive of the previous exchange.
+ *
+ * - The HAL needs clock() and clock_hz() (as for CoreBench). poll() must
+ * run more often than half a clock wrap: 35 minutes with the AVR's
+ * micros(), 2 s with the native HAL's nanoseconds.
+ *
+ * - Everything runs in the main loop; only the raw stamps come from
+ * interrupts, so nothing here masks them.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifndef TIME_SYNC_SLEW_PPM
+  #define TIME_SYNC_SLEW_PPM 5000       // 5 ms of correction per second
+#endif
+#ifndef TIME_SYNC_STEP_US
+  #define TIME_SYNC_STEP_US  1000000L   // Larger corrections are stepped
+#endif
+
+template <class Hal>
+class TimeSync
+{
+public:
+  static constexpr bool enabled = true;
+
+  static void begin() { raw_last_ = Hal::clock(); }
+
+  // Main loop: keep the time base ahead of the clock wrap
+  static void poll()
+  {
+    if (uint32_t(Hal::clock() - raw_last_) >= Hal::clock_hz() / 4)
+      update();
+  }
+
+  static uint64_t now_us()
+  {
+    update();
+    return time_ns_ / 1000;
+  }
+
+  // Device time of a raw stamp taken within half a clock wrap of the last update
+  static uint64_t at_us(uint32_t raw)
+  {
+    int64_t ns = int64_t(time_ns_) + int64_t(int32_t(raw - raw_last_)) * 1000000000LL / int64_t(Hal::clock_hz());
+    return ns > 0 ? uint64_t(ns) / 1000 : 0;
+  }
+
+  /**
+   * @brief A request addressed to this device
+   *
+   * @param rx_raw stamp of its first byte
+   * @param tx_raw stamp of the first byte of the last response sent,
+   *               i.e. the answer to the previous request
+   */
+  static void request(uint32_t rx_raw, uint32_t tx_raw)
+  {
+    update();
+    prev_rx_us_ = rx_us_;
+    prev_tx_us_ = at_us(tx_raw);
+    rx_us_ = at_us(rx_raw);
+  }
+
+  static uint64_t request_us() { return rx_us_; }
+  static uint64_t prev_request_us() { return prev_rx_us_; }
+  static uint64_t prev_response_us() { return prev_tx_us_; }
+
+  // Add `offset_us` to device time: slewed, or stepped if large
+  static void correct(int32_t offset_us)
+  {
+    update();
+    if (offset_us > TIME_SYNC_STEP_US || offset_us < -TIME_SYNC_STEP_US)
+      step(offset_us);
+    else
+      slew_ns_ += int64_t(offset_us) * 1000;
+  }
+
+  static void step(int64_t offset_us)
+  {
+    update();
+    int64_t t = int64_t(time_ns_) + offset_us * 1000;
+    time_ns_ = t > 0 ? uint64_t(t) : 0;
+    slew_ns_ = 0;
+  }
+
+  static void set_rate(int32_t ppb)
+  {
+    update();
+    rate_ppb_ = ppb;
+  }
+
+  static int32_t rate_ppb() { return rate_ppb_; }
+  static int32_t slew_pending_us() { return int32_t(slew_ns_ / 1000); }
+
+private:
+  static void update()
+  {
+    const uint32_t raw = Hal::clock();
+    const uint32_t hz = Hal::clock_hz();
+    const uint32_t d = raw - raw_last_;
+    raw_last_ = raw;
+
+    // Clock ticks to ns, remainder carried to the next update
+    const uint64_t n = uint64_t(d) * 1000000000ULL + frac_;
+    int64_t ns = int64_t(n / hz);
+    frac_ = uint32_t(n % hz);
+
+    ns += ns * rate_ppb_ / 1000000000LL;
+    const int64_t limit = ns * TIME_SYNC_SLEW_PPM / 1000000L;
+    const int64_t s = slew_ns_ > limit ? limit : slew_ns_ < -limit ? -limit : slew_ns_;
+    slew_ns_ -= s;
+    time_ns_ += uint64_t(ns + s);
+  }
+
+  static uint32_t raw_last_;
+  static uint32_t frac_;
+  static uint64_t time_ns_;
+  static int64_t slew_ns_;
+  static int32_t rate_ppb_;
+  static uint64_t rx_us_, prev_rx_us_, prev_tx_us_;
+};
+
+template <class Hal> uint32_t TimeSync<Hal>::raw_last_ = 0;
+template <class Hal> uint32_t TimeSync<Hal>::frac_ = 0;
+template <class Hal> uint64_t TimeSync<Hal>::time_ns_ = 0;
+template <class Hal> int64_t TimeSync<Hal>::slew_ns_ = 0;
+template <class Hal> int32_t TimeSync<Hal>::rate_ppb_ = 0;
+template <class Hal> uint64_t TimeSync<Hal>::rx_us_ = 0;
+template <class Hal> uint64_t TimeSync<Hal>::prev_rx_us_ = 0;
+template <class Hal> uint64_t TimeSync<Hal>::prev_tx_us_ = 0;
@@ -0,0 +1,60 @@
+/**
+ * @brief HalAvr - EstufaCore backend for AVR Arduino boards (UNO, MEGA)
+ *
+ *
+ * @notes:
+ * - Relay output is any AVR driver of lib/RelayBus (RelayBus for
+ * SerialRelay boards, ShiftRegisterBus for 74HC595), chosen by main.cpp.
+ * - Storage is the internal EEPROM, written in the background by
+ * lib/EepromWriter: storage_write() queues and returns at once, the
+ * source must stay valid until storage_busy() is false.
+ * - clock() is micros() (4 us steps at 16 MHz), enough for CoreBench
+ * averages; bench/Bench.h counts single cycles.
+ * - The tick comes from ITimer1 (TimerInterrupt library), attached in
+ * main.cpp: that library defines its objects in its header, so it can
+ * only be included by one translation unit.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdint.h>
+
+#include <EepromWriter.h>
+#include <StorageStats.h>
+
+template <class RelayDriver>
+struct HalAvr
+{
+  typedef RelayDriver Relay;
+
+  class Critical
+  {
+  public:
+    Critical() : sreg_(SREG) { cli(); }
+    ~Critical() { SREG = sreg_; }
+
+  private:
+    uint8_t sreg_;
+  };
+
+  // Includes writes still queued
+  static void storage_read(uint16_t addr, void *dst, uint16_t len)
+  {
+    EepromWriter::read(addr, dst, len);
+  }
+
+  // false if the write queue is full
+  static bool storage_write(uint16_t addr, const void *src, uint16_t len)
+  {
+    return EepromWriter::write(addr, src, len) != 0;
+  }
+
+  static bool storage_busy() { return EepromWriter::busy(); }
+  static void storage_stats(StorageStats &s) { EepromWriter::stats(s); }
+
+  static uint32_t clock() { return micros(); }
+  static uint32_t clock_hz() { return 1000000UL; }
+};
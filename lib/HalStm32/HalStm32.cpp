@@ -0,0 +1,143 @@
+#include "HalStm32.h"
+
+#include <string.h>
+
+static volatile uint32_t ms = 0;
+static volatile uint32_t tick_ms = 0;
+static uint32_t tick_period = 0;
+static void (*tick_fn)() = 0;
+
+extern "C" void SysTick_Handler()
+{
+  ms++;
+  if (tick_fn && ++tick_ms >= tick_period) {
+    tick_ms = 0;
+    tick_fn();
+  }
+}
+
+void HalStm32::begin()
+{
+  SystemCoreClockUpdate();
+
+  // SysTick at 1 kHz from the core clock
+  SysTick_Config(SystemCoreClock / 1000);
+
+  // USART1 on PA9 (AF7), 115200 8N1, TX only
+  RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+  RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+  GPIOA->MODER = (GPIOA->MODER & ~GPIO_MODER_MODER9) | GPIO_MODER_MODER9_1;
+  GPIOA->AFR[1] = (GPIOA->AFR[1] & ~(0xFU << 4)) | (7U << 4);
+  USART1->BRR = SystemCoreClock / 115200;
+  USART1->CR1 = USART_CR1_UE | USART_CR1_TE;
+}
+
+void HalStm32::storage_read(uint16_t, void *dst, uint16_t len)
+{
+  memset(dst, 0xFF, len);
+}
+
+void HalStm32::start_ticks(uint32_t period_ms, void (*fn)())
+{
+  Critical lock;
+  tick_period = period_ms;
+  tick_ms = 0;
+  tick_fn = fn;
+}
+
+uint32_t HalStm32::clock()
+{
+  const uint32_t reload = SysTick->LOAD + 1;
+  uint32_t m, val, pending;
+  // Retry if the millisecond counter moved while reading VAL
+  do {
+    m = ms;
+    val = SysTick->VAL;
+    pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+  } while (m != ms);
+  // Wrapped but not serviced yet (interrupts masked)
+  if (pending && val > reload / 2)
+    m++;
+  return m * reload + (reload - 1 - val);
+}
+
+void HalStm32::delay_ns(uint32_t ns)
+{
+  const uint32_t cycles = uint32_t((uint64_t)ns * SystemCoreClock / 1000000000ULL) + 1;
+  const uint32_t start = clock();
+  while (clock() - start < cycles);
+}
+
+void HalStm32::print(const char *text)
+{
+  while (*text) {
+    while (!(USART1->SR & USART_SR_TXE));
+    USART1->DR = uint8_t(*text++);
+  }
+}
+
+void HalStm32::print(uint32_t value)
+{
+  char buf[11];
+  char *p = buf + sizeof(buf);
+  *--p = 0;
+  do {
+    *--p = char('0' + value % 10);
+    value /= 10;
+  } while (value);
+  print(p);
+}
+
+void HalStm32::exit()
+{
+  while (!(USART1->SR & USART_SR_TC));
+#ifdef QEMU_SEMIHOSTING
+  // SYS_EXIT, ADP_Stopped_ApplicationExit
+  register uint32_t r0 __asm__("r0") = 0x18;
+  register uint32_t r1 __asm__("r1") = 0x20026;
+  __asm__ volatile("bkpt 0xAB" : : "r"(r0), "r"(r1) : "memory");
+#endif
+  for (;;)
+    __WFI();
+}
+
+
+/**
+ * @brief Relay chain, PA0 = DATA, PA1 = CLOCK
+ *
+ * Interrupts are masked only while CLOCK is high on a data bit, as in
+ * lib/RelayBus/RelayBus.h: a stretched pulse could latch a partial frame.
+ */
+#define RELAY_DATA_BIT 0
+#define RELAY_CLK_BIT  1
+
+void HalStm32::Relay::begin()
+{
+  RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+  GPIOA->BSRR = (1U << (RELAY_DATA_BIT + 16)) | (1U << (RELAY_CLK_BIT + 16));
+  GPIOA->MODER |= (1U << (RELAY_DATA_BIT * 2)) | (1U << (RELAY_CLK_BIT * 2));
+}
+
+void HalStm32::Relay::write_frame(const uint8_t *bytes, uint16_t len)
+{
+  for (uint16_t i = 0; i < len; i++) {
+    const bool last_byte = i + 1 == len;
+    for (uint8_t mask = 0x80; mask; mask >>= 1) {
+      GPIOA->BSRR = (bytes[i] & mask) ? (1U << RELAY_DATA_BIT) : (1U << (RELAY_DATA_BIT + 16));
+      delay_ns(data_ns);
+      if (last_byte && mask == 0x01) {
+        GPIOA->BSRR = 1U << RELAY_CLK_BIT;
+        delay_ns(latch_ns);
+        GPIOA->BSRR = 1U << (RELAY_CLK_BIT + 16);
+      } else {
+        Critical lock;
+        GPIOA->BSRR = 1U << RELAY_CLK_BIT;
+        delay_ns(clock_high_ns);
+        GPIOA->BSRR = 1U << (RELAY_CLK_BIT + 16);
+      }
+      delay_ns(clock_low_ns);
+    }
+  }
+  // Reset to maintain LOW level when not in use
+  GPIOA->BSRR = 1U << (RELAY_DATA_BIT + 16);
+}
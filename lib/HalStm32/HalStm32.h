@@ -0,0 +1,71 @@
+/**
+ * @brief HalStm32 - EstufaCore backend for STM32F4 (Cortex-M4), bare CMSIS
+ *
+ *
+ * @notes:
+ * - Written against the STM32F405 of QEMU's netduinoplus2 machine, so
+ * the core can be run and benchmarked with qemu-system-arm
+ * ([env:stm32_qemu]); the same code runs on a real F405/F407 board.
+ *
+ * - SysTick at 1 kHz is both the clock (clock() = core cycles, from the
+ * SysTick count) and the schedule tick source (start_ticks()).
+ * - Console on USART1 (PA9 TX, 115200 8N1), polled.
+ * - Relays: SerialRelay waveform bit-banged on PA0 (DATA) / PA1 (CLOCK)
+ * through BSRR, same phases and interrupt rule as lib/RelayBus. Phases
+ * are RelayTimingFast, which is uncalibrated: fine for the QEMU bench,
+ * measure the board's RC before driving real relays with it.
+ * - No EEPROM: storage reads as erased (0xFF) and takes writes without
+ * keeping them, so the compiled schedule table is used and zone changes
+ * stay in RAM. Accepting them matters: a refused write leaves
+ * ConfigCache dirty, retrying on every loop() pass.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <RelayTimingFast.h>
+
+#include "stm32f4xx.h"
+
+struct HalStm32
+{
+  // Phase lengths (data_ns...) from lib/RelayBus/RelayTimingFast.h
+  struct Relay : RelayTimingFast
+  {
+    static constexpr uint8_t relays_per_module = 4;
+
+    static void begin();
+    static void write_frame(const uint8_t *bytes, uint16_t len);
+  };
+
+  class Critical
+  {
+  public:
+    Critical() : primask_(__get_PRIMASK()) { __disable_irq(); }
+    ~Critical() { __set_PRIMASK(primask_); }
+
+  private:
+    uint32_t primask_;
+  };
+
+  static void begin();
+
+  static void storage_read(uint16_t addr, void *dst, uint16_t len);
+  // Accepted and dropped: nothing persists
+  static bool storage_write(uint16_t, const void *, uint16_t) { return true; }
+  static bool storage_busy() { return false; }
+
+  // Call fn from the SysTick interrupt every period_ms
+  static void start_ticks(uint32_t period_ms, void (*fn)());
+
+  static uint32_t clock();
+  static uint32_t clock_hz() { return SystemCoreClock; }
+  static void delay_ns(uint32_t ns);
+
+  static void print(const char *text);
+  static void print(uint32_t value);
+
+  // Ends the QEMU run (semihosting SYS_EXIT); spins on real hardware
+  static void exit();
+};
@@ -0,0 +1,67 @@
+/**
+ * @brief FanPwm - 3 PWM outputs at 25 kHz on Timer3
+ *
+ *
+ * @notes:
+ * - 25 kHz is the PWM frequency of 4-wire PC fans (Intel spec), above the
+ * audible range. Arduino's analogWrite() runs these pins at 490 Hz.
+ *
+ * - Fast PWM, TOP = ICR3 = F_CPU / 25 kHz - 1 (639 at 16 MHz), so each
+ * channel has 640 steps; set() takes 0..255 and scales it.
+ *
+ * - Channels: 0 = OC3A (D5), 1 = OC3B (D2), 2 = OC3C (D3). Only those in
+ * FAN_PWM_OUTPUTS (bit n = channel n) are driven; the others stay plain
+ * pins. D2 is also the usual RS-485 DE pin (env:uno_rs485): an RTU build
+ * whose RTU_SERIAL_DE_PIN is a driven output does not compile, drop the
+ * channel (-DFAN_PWM_OUTPUTS=0x5) or move DE.
+ *
+ */
+#pragma once
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define FAN_PWM_HZ        25000UL
+#define FAN_PWM_CHANNELS  3
+#ifndef FAN_PWM_OUTPUTS
+  #define FAN_PWM_OUTPUTS 0x7
+#endif
+
+#ifdef RTU_SERIAL_DE_PIN
+static_assert(!((FAN_PWM_OUTPUTS & 0x1) && RTU_SERIAL_DE_PIN == 5) &&
+              !((FAN_PWM_OUTPUTS & 0x2) && RTU_SERIAL_DE_PIN == 2) &&
+              !((FAN_PWM_OUTPUTS & 0x4) && RTU_SERIAL_DE_PIN == 3),
+              "RTU_SERIAL_DE_PIN is a FanPwm output: leave it out of FAN_PWM_OUTPUTS or move DE");
+#endif
+
+class FanPwm
+{
+public:
+  static constexpr uint16_t top = F_CPU / FAN_PWM_HZ - 1;
+
+  static void begin()
+  {
+    OCR3A = 0;
+    OCR3B = 0;
+    OCR3C = 0;
+    ICR3 = top;
+    // Mode 14 (fast PWM, TOP = ICR3), clear on compare, clk/1
+    TCCR3A = (FAN_PWM_OUTPUTS & 0x1 ? _BV(COM3A1) : 0) |
+             (FAN_PWM_OUTPUTS & 0x2 ? _BV(COM3B1) : 0) |
+             (FAN_PWM_OUTPUTS & 0x4 ? _BV(COM3C1) : 0) | _BV(WGM31);
+    TCCR3B = _BV(WGM33) | _BV(WGM32) | _BV(CS30);
+    DDRE |= (FAN_PWM_OUTPUTS & 0x1 ? _BV(PE3) : 0) |
+            (FAN_PWM_OUTPUTS & 0x2 ? _BV(PE4) : 0) |
+            (FAN_PWM_OUTPUTS & 0x4 ? _BV(PE5) : 0);
+  }
+
+  static void set(uint8_t channel, uint8_t duty)
+  {
+    uint16_t value = uint16_t((uint32_t)duty * top / 255);
+    switch (channel) {
+      case 0: OCR3A = value; break;
+      case 1: OCR3B = value; break;
+      case 2: OCR3C = value; break;
+    }
+  }
+};
@@ -0,0 +1,26 @@
+/**
+ * @brief HwTimers - dedicated hardware timers of the ATmega2560 (MEGA)
+ *
+ *
+ * @notes:
+ * - Timer allocation on MEGA, one job per timer so none of them has to
+ * share prescaler, mode or interrupt with another:
+ *   Timer0  millis()/delay()            Arduino core (compare B: soft timer tick)
+ *   Timer1  schedule ticks (ITimer1)    TimerInterrupt library
+ *   Timer2  Modbus RTU t3.5 timer       lib/RtuSerial (FEATURE_MODBUS)
+ *   Timer3  fan PWM, 25 kHz             FanPwm.h       D5, D2, D3
+ *   Timer4  cycle profiler, F_CPU       Profiler.h
+ *   Timer5  pulse counter, T5 input     PulseCounter.h D47
+ *
+ * - The UNO has Timers 0-2 only: these are MEGA-only features.
+ *
+ */
+#pragma once
+
+#if !defined(TCCR5A)
+  #error "HwTimers needs Timers 3-5 (ATmega2560/1280)"
+#endif
+
+#include "FanPwm.h"
+#include "Profiler.h"
+#include "PulseCounter.h"
@@ -0,0 +1,40 @@
+#include "Profiler.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#if defined(TCCR5A)
+
+static volatile uint16_t overflows = 0;
+
+ISR(TIMER4_OVF_vect)
+{
+  overflows++;
+}
+
+void Profiler::begin()
+{
+  // Normal mode, clk/1
+  TCCR4A = 0;
+  TCCR4B = 0;
+  TCNT4 = 0;
+  overflows = 0;
+  TIFR4 = _BV(TOV4);
+  TIMSK4 = _BV(TOIE4);
+  TCCR4B = _BV(CS40);
+}
+
+uint32_t Profiler::cycles()
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t lo = TCNT4;
+  uint16_t hi = overflows;
+  // Overflow pending but not serviced yet
+  if ((TIFR4 & _BV(TOV4)) && lo < 0x8000)
+    hi++;
+  SREG = sreg;
+  return ((uint32_t)hi << 16) | lo;
+}
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @brief Profiler - cycle-accurate section timing on Timer4
+ *
+ *
+ * @notes:
+ * - Timer4 runs at F_CPU with no prescaler; its overflow interrupt
+ * extends the count to 32 bits (wraps after ~268 s at 16 MHz, longer
+ * than any section worth profiling).
+ *
+ * - Usage:
+ *   ProfileStat relay_stat;
+ *   void Send_relays() { ProfileScope p(relay_stat); ... }
+ *   ... relay_stat.last / relay_stat.max / relay_stat.count
+ *
+ * - A ProfileStat is updated by whoever runs the section: do not share
+ * one between an ISR and loop().
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+class Profiler
+{
+public:
+  static void begin();
+  static uint32_t cycles();
+};
+
+struct ProfileStat
+{
+  uint32_t last = 0;
+  uint32_t max = 0;
+  uint32_t count = 0;
+
+  void add(uint32_t cycles)
+  {
+    last = cycles;
+    if (cycles > max)
+      max = cycles;
+    count++;
+  }
+};
+
+class ProfileScope
+{
+public:
+  explicit ProfileScope(ProfileStat &stat) : stat_(stat), start_(Profiler::cycles()) {}
+  ~ProfileScope() { stat_.add(Profiler::cycles() - start_); }
+
+private:
+  ProfileStat &stat_;
+  uint32_t start_;
+};
@@ -0,0 +1,44 @@
+#include "PulseCounter.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#if defined(TCCR5A)
+
+static volatile uint16_t overflows = 0;
+
+ISR(TIMER5_OVF_vect)
+{
+  overflows++;
+}
+
+void PulseCounter::begin()
+{
+  // T5 (PL2) as input with pull-up, for open-collector meter outputs
+  DDRL &= uint8_t(~_BV(PL2));
+  PORTL |= _BV(PL2);
+
+  TCCR5A = 0;
+  TCCR5B = 0;
+  TCNT5 = 0;
+  overflows = 0;
+  TIFR5 = _BV(TOV5);
+  TIMSK5 = _BV(TOIE5);
+  // External clock on T5, rising edge
+  TCCR5B = _BV(CS52) | _BV(CS51) | _BV(CS50);
+}
+
+uint32_t PulseCounter::count()
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t lo = TCNT5;
+  uint16_t hi = overflows;
+  // Overflow pending but not serviced yet
+  if ((TIFR5 & _BV(TOV5)) && lo < 0x8000)
+    hi++;
+  SREG = sreg;
+  return ((uint32_t)hi << 16) | lo;
+}
+
+#endif
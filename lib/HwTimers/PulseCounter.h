@@ -0,0 +1,25 @@
+/**
+ * @brief PulseCounter - hardware pulse counting on Timer5
+ *
+ *
+ * @notes:
+ * - Timer5 is clocked by rising edges on its T5 input (D47), so pulses
+ * (flow meter, S0 energy meter, ...) are counted by the timer itself with
+ * no interrupt per pulse. The overflow interrupt extends the count to 32
+ * bits, once every 65536 pulses.
+ *
+ * - External clock inputs are synchronized to the CPU clock: pulses up to
+ * about F_CPU / 2.5 are counted.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+class PulseCounter
+{
+public:
+  static void begin();
+  // Pulses since begin()
+  static uint32_t count();
+};
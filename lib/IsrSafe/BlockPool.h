@@ -0,0 +1,135 @@
+/**
+ * @brief BlockPool - fixed-block allocator for ISRs and loop()
+ *
+ *
+ * @notes:
+ * - N blocks of one type in a static array, handed out and taken back in
+ * O(1) from a free list: no heap, so no fragmentation on a 2 KB AVR, and
+ * an exhausted pool fails one alloc() instead of corrupting the stack.
+ *
+ * - Any context may alloc() or free(), an ISR may free a block loop()
+ * allocated and the other way round (typical: the ISR fills a block and
+ * passes the pointer through a SpscRing).
+ *   AVR    the list update runs under IsrGuard, about 20 cycles masked
+ *   other  lock-free: the list head is an index plus a 24-bit tag,
+ *          swapped with compare-and-exchange (threads, Cortex-M ISRs)
+ *
+ * - Blocks are raw storage for plain data: nothing is constructed or
+ * destroyed, and a block's content is undefined after alloc().
+ *
+ * - stats() reports the size, blocks in use, the high-water mark and
+ * failed allocations, to size N from a real run.
+ *
+ * - Usage:
+ *   static BlockPool<Event, 8> events;
+ *   Event *e = events.alloc();   if (e) { ...; queue.push(e); }
+ *   ...                          events.free(e);
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "IsrAtomic.h"
+
+struct PoolStats
+{
+  uint8_t size;
+  uint8_t in_use;
+  uint8_t high_water;
+  uint16_t failed;
+};
+
+template <class T, uint8_t N>
+class BlockPool
+{
+  static_assert(N > 0 && N < 255, "BlockPool holds 1..254 blocks");
+
+public:
+  static constexpr uint8_t size = N;
+
+  BlockPool()
+  {
+    for (uint8_t i = 0; i < N; i++)
+      next_[i] = uint8_t(i + 1 < N ? i + 1 : NIL);
+  }
+
+  // nullptr when every block is in use
+  T *alloc()
+  {
+#if defined(__AVR__)
+    IsrGuard guard;
+    const uint8_t i = head_;
+    if (i == NIL) {
+      failed_++;
+      return nullptr;
+    }
+    head_ = next_[i];
+    if (++in_use_ > high_water_)
+      high_water_ = in_use_;
+#else
+    uint32_t h = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+    uint8_t i;
+    do {
+      i = uint8_t(h);
+      if (i == NIL) {
+        __atomic_add_fetch(&failed_, 1, __ATOMIC_RELAXED);
+        return nullptr;
+      }
+    } while (!__atomic_compare_exchange_n(&head_, &h, ((h + 0x100) & ~0xFFUL) | next_[i], true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    uint8_t used = __atomic_add_fetch(&in_use_, 1, __ATOMIC_RELAXED);
+    uint8_t high = __atomic_load_n(&high_water_, __ATOMIC_RELAXED);
+    while (used > high && !__atomic_compare_exchange_n(&high_water_, &high, used, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      ;
+#endif
+    return reinterpret_cast<T *>(blocks_[i]);
+  }
+
+  // p must come from this pool's alloc() (nullptr is ignored)
+  void free(T *p)
+  {
+    if (!p)
+      return;
+    const uint8_t i = uint8_t((reinterpret_cast<unsigned char *>(p) - blocks_[0]) / sizeof(T));
+#if defined(__AVR__)
+    IsrGuard guard;
+    next_[i] = head_;
+    head_ = i;
+    in_use_--;
+#else
+    uint32_t h = __atomic_load_n(&head_, __ATOMIC_RELAXED);
+    do {
+      next_[i] = uint8_t(h);
+    } while (!__atomic_compare_exchange_n(&head_, &h, ((h + 0x100) & ~0xFFUL) | i, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    __atomic_sub_fetch(&in_use_, 1, __ATOMIC_RELAXED);
+#endif
+  }
+
+  void stats(PoolStats &s) const
+  {
+#if defined(__AVR__)
+    IsrGuard guard;
+#endif
+    s.size = N;
+    s.in_use = in_use_;
+    s.high_water = high_water_;
+    s.failed = failed_;
+  }
+
+private:
+  static constexpr uint8_t NIL = 0xFF;
+
+  alignas(T) unsigned char blocks_[N][sizeof(T)];
+  uint8_t next_[N];         // Free list links
+#if defined(__AVR__)
+  uint8_t head_ = 0;
+#else
+  uint32_t head_ = 0;       // Tag << 8 | index
+#endif
+  uint8_t in_use_ = 0;
+  uint8_t high_water_ = 0;
+  uint16_t failed_ = 0;
+};
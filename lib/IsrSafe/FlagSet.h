@@ -0,0 +1,61 @@
+/**
+ * @brief FlagSet - N event flags shared between ISRs and loop()
+ *
+ *
+ * @notes:
+ * - Any side sets a flag, the side that handles it take()s it: test and
+ * clear in one atomic step, so an event raised between the test and the
+ * clear is never lost (as it would be with "if (flag) { flag = false; }"
+ * on a volatile bool).
+ *
+ * - Flags are packed 8 per byte; each operation touches one byte with
+ * an atomic read-modify-write (lib/IsrSafe/IsrAtomic.h).
+ *
+ * - Usage:
+ *   enum { EV_TICK, EV_RX };
+ *   static FlagSet<2> events;
+ *   ISR:  events.set(EV_TICK);
+ *   loop: if (events.take(EV_TICK)) ...
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "IsrAtomic.h"
+
+template <uint8_t N>
+class FlagSet
+{
+  static_assert(N > 0, "FlagSet needs at least one flag");
+
+public:
+  static constexpr uint8_t flags = N;
+
+  FlagSet()
+  {
+    for (uint8_t i = 0; i < BYTES; i++)
+      bits_[i] = 0;
+  }
+
+  void set(uint8_t f) { isr_fetch_or(bits_[f >> 3], mask(f)); }
+  void clear(uint8_t f) { isr_fetch_and(bits_[f >> 3], uint8_t(~mask(f))); }
+  bool test(uint8_t f) const { return isr_load(bits_[f >> 3]) & mask(f); }
+
+  // Test and clear
+  bool take(uint8_t f) { return isr_fetch_and(bits_[f >> 3], uint8_t(~mask(f))) & mask(f); }
+
+  bool any() const
+  {
+    for (uint8_t i = 0; i < BYTES; i++)
+      if (isr_load(bits_[i]))
+        return true;
+    return false;
+  }
+
+private:
+  static constexpr uint8_t BYTES = (N + 7) / 8;
+  static constexpr uint8_t mask(uint8_t f) { return uint8_t(1 << (f & 7)); }
+
+  uint8_t bits_[BYTES];
+};
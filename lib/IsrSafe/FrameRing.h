@@ -0,0 +1,112 @@
+/**
+ * @brief FrameRing - receive ring cut into 0x00-delimited frames
+ *
+ *
+ * @notes:
+ * - The receive interrupt put()s bytes; loop() takes whole frames with
+ * frame(), as a RingSpan over the bytes still in the ring, and lets them
+ * go with release(). The frame is never copied out: a COBS decoder
+ * (link_decode(), lib/EstufaCore/LinkFrame.h) rewrites it where it lies.
+ *
+ * - The interrupt counts delimiters as they arrive, so frame() knows
+ * whether one is complete without scanning. Empty frames (back-to-back
+ * delimiters) are skipped.
+ *
+ * - A full ring drops the incoming byte (counted in overruns()): the frame
+ * it belonged to then fails its CRC. A ring filled without a single
+ * delimiter holds no frame and is cleared, so noise cannot wedge it.
+ *
+ * - N is a power of two up to 128, indices as in SpscRing.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "IsrAtomic.h"
+
+// Bytes of a ring from `start` on, `len` of them valid
+struct RingSpan
+{
+  uint8_t *ring;
+  uint8_t start;
+  uint8_t mask;
+  uint8_t len;
+
+  uint8_t &operator[](uint16_t i) const { return ring[uint8_t(start + i) & mask]; }
+};
+
+template <uint8_t N>
+class FrameRing
+{
+  static_assert(N >= 8 && N <= 128 && (N & (N - 1)) == 0, "FrameRing size must be a power of two, 8..128");
+
+public:
+  static constexpr uint8_t capacity = N;
+
+  // Receive interrupt
+  void put(uint8_t c)
+  {
+    const uint8_t h = head_;
+    if (uint8_t(h - isr_load(tail_)) == N) {
+      overruns_++;
+      return;
+    }
+    buf_[h & MASK] = c;
+    isr_store(head_, uint8_t(h + 1));
+    if (c == 0)
+      isr_store(delimiters_, uint8_t(delimiters_ + 1));
+  }
+
+  /**
+   * @brief Main loop: the oldest complete frame, delimiter excluded
+   *
+   * @return false if none; otherwise `f` stays valid until release()
+   */
+  bool frame(RingSpan &f)
+  {
+    release();
+    while (isr_load(delimiters_) != taken_) {
+      uint8_t n = 0;
+      while (buf_[uint8_t(tail_ + n) & MASK])
+        n++;
+      taken_++;
+      if (n) {
+        f.ring = buf_;
+        f.start = tail_;
+        f.mask = MASK;
+        f.len = n;
+        pending_ = uint8_t(n + 1);
+        return true;
+      }
+      isr_store(tail_, uint8_t(tail_ + 1));
+    }
+    const uint8_t h = isr_load(head_);
+    if (uint8_t(h - tail_) == N)
+      isr_store(tail_, h);
+    return false;
+  }
+
+  // Main loop: done with the frame frame() returned
+  void release()
+  {
+    if (pending_) {
+      isr_store(tail_, uint8_t(tail_ + pending_));
+      pending_ = 0;
+    }
+  }
+
+  // Read with the interrupt kept out by the caller on AVR (16-bit)
+  uint16_t overruns() const { return overruns_; }
+
+private:
+  static constexpr uint8_t MASK = N - 1;
+
+  uint8_t buf_[N];
+  uint8_t head_ = 0;          // Interrupt
+  uint8_t delimiters_ = 0;    // Interrupt: delimiters received
+  uint8_t tail_ = 0;          // Main loop
+  uint8_t taken_ = 0;         // Main loop: delimiters consumed
+  uint8_t pending_ = 0;       // Main loop: bytes of the frame handed out
+  uint16_t overruns_ = 0;
+};
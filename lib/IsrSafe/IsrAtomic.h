@@ -0,0 +1,83 @@
+/**
+ * @brief IsrAtomic - the few atomic operations the IsrSafe primitives need
+ *
+ *
+ * @notes:
+ * - On AVR a byte load or store is a single instruction, so it cannot
+ * tear; only the ordering needs help, and on one core a compiler barrier
+ * is enough. Read-modify-writes run under IsrGuard (SREG saved, cli),
+ * because avr-gcc has no inline __atomic_fetch_* and an ISR could land
+ * between the load and the store.
+ *
+ * - Elsewhere (native host threads, Cortex-M) the GCC __atomic builtins
+ * give the same guarantees with acquire/release ordering.
+ *
+ * - Indexes and counters are bytes on purpose: wider ones would tear on
+ * the 8-bit AVR.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__AVR__)
+  #include <avr/interrupt.h>
+  #include <avr/io.h>
+
+  // Masks interrupts for its scope, restores the previous state
+  class IsrGuard
+  {
+  public:
+    IsrGuard() : sreg_(SREG) { cli(); }
+    ~IsrGuard() { SREG = sreg_; }
+
+  private:
+    uint8_t sreg_;
+  };
+
+  inline void isr_fence() { __asm__ __volatile__("" ::: "memory"); }
+
+  inline uint8_t isr_load(const uint8_t &v)
+  {
+    uint8_t r = *reinterpret_cast<const volatile uint8_t *>(&v);
+    isr_fence();
+    return r;
+  }
+
+  inline void isr_store(uint8_t &v, uint8_t x)
+  {
+    isr_fence();
+    *reinterpret_cast<volatile uint8_t *>(&v) = x;
+  }
+
+  inline uint8_t isr_fetch_or(uint8_t &v, uint8_t mask)
+  {
+    IsrGuard guard;
+    uint8_t old = isr_load(v);
+    isr_store(v, old | mask);
+    return old;
+  }
+
+  inline uint8_t isr_fetch_and(uint8_t &v, uint8_t mask)
+  {
+    IsrGuard guard;
+    uint8_t old = isr_load(v);
+    isr_store(v, old & mask);
+    return old;
+  }
+#else
+  inline void isr_fence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+  inline uint8_t isr_load(const uint8_t &v) { return __atomic_load_n(&v, __ATOMIC_ACQUIRE); }
+  inline void isr_store(uint8_t &v, uint8_t x) { __atomic_store_n(&v, x, __ATOMIC_RELEASE); }
+
+  inline uint8_t isr_fetch_or(uint8_t &v, uint8_t mask)
+  {
+    return __atomic_fetch_or(&v, mask, __ATOMIC_ACQ_REL);
+  }
+
+  inline uint8_t isr_fetch_and(uint8_t &v, uint8_t mask)
+  {
+    return __atomic_fetch_and(&v, mask, __ATOMIC_ACQ_REL);
+  }
+#endif
@@ -0,0 +1,26 @@
+/**
+ * @brief IsrSafe - data shared between interrupts and loop()
+ *
+ *
+ * @notes:
+ * - SpscRing  queue of elements, one producer and one consumer
+ * - FrameRing receive bytes, taken back as 0x00-delimited frames in place
+ * - SeqLock   snapshot of a multi-byte value, one writer
+ * - FlagSet   event flags, set anywhere, taken by the handler
+ * - BlockPool fixed-size blocks, allocated and freed anywhere
+ *
+ * - All sized at compile time, no heap. None of them masks interrupts
+ * except for the few-cycle read-modify-writes of FlagSet and BlockPool
+ * on AVR. Portable: the same headers build for AVR, STM32 and the native
+ * host tools.
+ *
+ * - Cycle costs: bench/main.cpp (pio run -e uno_bench -t simbench).
+ *
+ */
+#pragma once
+
+#include "BlockPool.h"
+#include "FlagSet.h"
+#include "FrameRing.h"
+#include "SeqLock.h"
+#include "SpscRing.h"
@@ -0,0 +1,78 @@
+/**
+ * @brief SeqLock - lock-free snapshot of a multi-byte value
+ *
+ *
+ * @notes:
+ * - For a value the ISR updates and loop() reads (a uint32_t count, a
+ * small struct), where a plain volatile copy can tear: the reader gets
+ * the old low byte with the new high one.
+ *
+ * - The writer makes the sequence odd, copies the value, makes it even
+ * again. The reader copies the value between two reads of the sequence
+ * and retries if it was odd or changed, so a snapshot is always one the
+ * writer published. Neither side masks interrupts.
+ *
+ * - One writer, which must not be interrupted by a reader: the writer is
+ * the ISR (or the only thread), readers are loop() or lower priority
+ * code. A reader in an ISR that preempts the writer would spin forever.
+ *
+ * - T must be trivially copyable. The sequence is a byte (no tearing on
+ * AVR); a reader would need 128 writes during one copy to be fooled.
+ *
+ * - Usage:
+ *   static SeqLock<uint32_t> hours;
+ *   ISR:  hours.write(h);
+ *   loop: uint32_t h = hours.read();
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "IsrAtomic.h"
+
+template <class T>
+class SeqLock
+{
+public:
+  SeqLock() : seq_(0), value_() {}
+
+  // Writer side
+  void write(const T &v)
+  {
+    const uint8_t s = seq_;
+    isr_store(seq_, uint8_t(s + 1));
+    isr_fence();
+    memcpy(&value_, &v, sizeof(T));
+    isr_fence();
+    isr_store(seq_, uint8_t(s + 2));
+  }
+
+  // Reader side; false if the writer got in the way (v is then garbage)
+  bool try_read(T &v) const
+  {
+    const uint8_t s = isr_load(seq_);
+    if (s & 1)
+      return false;
+    memcpy(&v, &value_, sizeof(T));
+    isr_fence();
+    return isr_load(seq_) == s;
+  }
+
+  // Reader side: retries until it gets a consistent copy
+  T read() const
+  {
+    T v;
+    while (!try_read(v))
+      ;
+    return v;
+  }
+
+  // Bumped by every write (even when idle)
+  uint8_t sequence() const { return isr_load(seq_); }
+
+private:
+  uint8_t seq_;
+  T value_;
+};
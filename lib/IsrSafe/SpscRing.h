@@ -0,0 +1,78 @@
+/**
+ * @brief SpscRing - single-producer single-consumer ring buffer
+ *
+ *
+ * @notes:
+ * - One side pushes, the other pops, typically an ISR and loop(), in
+ * either direction. Neither masks interrupts: the producer owns head_,
+ * the consumer owns tail_, and each only reads the other's byte.
+ *
+ * - N is a power of two up to 128: head_ and tail_ run freely over 0..255
+ * and are masked on access, so full (head_ - tail_ == N) and empty
+ * (head_ == tail_) need no spare slot and no flag.
+ *
+ * - The element is copied into its slot before head_ moves (release),
+ * and read out before tail_ moves, so the other side never sees a half
+ * written or recycled slot.
+ *
+ * - Usage:
+ *   static SpscRing<uint8_t, 16> rx;
+ *   ISR:  rx.push(UDR0);
+ *   loop: uint8_t c; while (rx.pop(c)) ...
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "IsrAtomic.h"
+
+template <class T, uint8_t N>
+class SpscRing
+{
+  static_assert(N >= 2 && N <= 128 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two, 2..128");
+
+public:
+  static constexpr uint8_t capacity = N;
+
+  // Producer side; false if full
+  bool push(const T &v)
+  {
+    const uint8_t h = head_;
+    if (uint8_t(h - isr_load(tail_)) == N)
+      return false;
+    buf_[h & MASK] = v;
+    isr_store(head_, uint8_t(h + 1));
+    return true;
+  }
+
+  // Consumer side; false if empty
+  bool pop(T &v)
+  {
+    const uint8_t t = tail_;
+    if (isr_load(head_) == t)
+      return false;
+    v = buf_[t & MASK];
+    isr_store(tail_, uint8_t(t + 1));
+    return true;
+  }
+
+  // Consumer side: the oldest element, left in place, or nullptr
+  const T *peek() const
+  {
+    const uint8_t t = tail_;
+    return isr_load(head_) == t ? nullptr : &buf_[t & MASK];
+  }
+
+  // Exact for the side calling it, a lower/upper bound for the other one
+  uint8_t size() const { return uint8_t(isr_load(head_) - isr_load(tail_)); }
+  uint8_t space() const { return uint8_t(N - size()); }
+  bool empty() const { return size() == 0; }
+
+private:
+  static constexpr uint8_t MASK = N - 1;
+
+  T buf_[N];
+  uint8_t head_ = 0;      // Written by the producer only
+  uint8_t tail_ = 0;      // Written by the consumer only
+};
@@ -0,0 +1,64 @@
+/**
+ * @brief LightSchedule - light/dark cycle engine
+ *
+ *
+ * @notes:
+ * - Hardware independent: the firmware calls tick() from the Timer1 ISR
+ * once per TIMER_TRIGGER_MS, the host simulator calls it once per
+ * virtual hour. Both must see exactly the same transitions.
+ *
+ * - No Arduino includes and no dynamic memory, so the same header builds
+ * for AVR and for the native (host) platform.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+class LightSchedule
+{
+public:
+  /**
+   * @param light_hours: How many hours of light
+   * @param dark_hours:  How many hours of dark
+   * @param start_on:    Relay starts activated
+   * @param start_hours: Hours already spent in the start state, used to
+   *                     join a cycle in the middle (see ScheduleTable.h)
+   */
+  constexpr LightSchedule(uint8_t light_hours, uint8_t dark_hours, bool start_on,
+                          uint8_t start_hours = 0)
+    : light_hours_(light_hours), dark_hours_(dark_hours), hours_(start_hours), on_(start_on)
+  {
+  }
+
+  // Placeholder for arrays, assign a real schedule before the first tick()
+  constexpr LightSchedule() : LightSchedule(0, 0, false) {}
+
+  /**
+   * @brief Advance the schedule by one hour
+   *
+   * @return true when the relay has to be toggled
+   */
+  bool tick()
+  {
+    hours_++;
+    if ((on_ && hours_ == light_hours_) || (!on_ && hours_ == dark_hours_)) {
+      // Reset couting hours
+      hours_ = 0;
+      on_ = !on_;
+      return true;
+    }
+    return false;
+  }
+
+  bool is_on() const { return on_; }
+  uint8_t hours() const { return hours_; }
+  uint8_t light_hours() const { return light_hours_; }
+  uint8_t dark_hours() const { return dark_hours_; }
+
+private:
+  uint8_t light_hours_;
+  uint8_t dark_hours_;
+  uint8_t hours_;       // Hours spent in the current state
+  bool on_;
+};
@@ -0,0 +1,104 @@
+/**
+ * @brief ScheduleTable - per-zone schedule format shared with host tools
+ *
+ *
+ * @notes:
+ * - One ScheduleEntry per zone (relay channel). Hour 0 is the moment the
+ * controller starts its Timer1 (boot). start_on/start_hours describe
+ * where in its light/dark cycle the zone is at that moment, so a block
+ * of light can start at any hour of the day.
+ *
+ * - The same entries are used in two places:
+ *   - include/schedule_table.h, a constexpr table generated by
+ *     host/optimizer and compiled into the firmware;
+ *   - an EEPROM image (Intel HEX, also from host/optimizer) which
+ *     overrides the compiled table when its header and CRC are valid.
+ *
+ * - An image holds exactly SCHEDULE_ZONES entries, the count the firmware
+ * was built with: one with any other count is rejected as a whole
+ * (SCHEDULE_IMAGE_ZONE_COUNT) and the compiled table runs. Re-planning
+ * from EEPROM changes the hours of the zones a build has, not how many.
+ *
+ * - EEPROM image layout, starting at SCHEDULE_EEPROM_ADDR:
+ *   'E' 'S' version count entry[count] crc8
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "LightSchedule.h"
+
+#define SCHEDULE_EEPROM_ADDR     0
+#define SCHEDULE_IMAGE_VERSION   1
+#ifndef SCHEDULE_MAX_ZONES
+  #define SCHEDULE_MAX_ZONES     4   // Relays of one SerialRelay module
+#endif
+
+struct ScheduleEntry
+{
+  uint8_t light_hours;  // How many hours of light
+  uint8_t dark_hours;   // How many hours of dark
+  uint8_t start_on;     // Zone is lit at hour 0
+  uint8_t start_hours;  // Hours already spent in that state at hour 0
+};
+
+struct ScheduleImageHeader
+{
+  uint8_t magic[2];     // 'E' 'S'
+  uint8_t version;
+  uint8_t count;        // Number of entries following the header
+};
+
+// Outcome of loading an image, in the order it is checked
+enum ScheduleImageStatus : uint8_t
+{
+  SCHEDULE_IMAGE_OK,
+  SCHEDULE_IMAGE_ABSENT,        // No 'E' 'S' magic: never written
+  SCHEDULE_IMAGE_OTHER_VERSION, // Written by another image version
+  SCHEDULE_IMAGE_ZONE_COUNT,    // count != SCHEDULE_ZONES
+  SCHEDULE_IMAGE_CRC,           // Damaged
+  SCHEDULE_IMAGE_ENTRY          // An entry fails schedule_entry_valid()
+};
+
+// Bytes used by an image of `count` entries (header + entries + crc)
+#define SCHEDULE_IMAGE_SIZE(count) \
+  (sizeof(ScheduleImageHeader) + (count) * sizeof(ScheduleEntry) + 1)
+
+
+/**
+ * @brief CRC-8 (Dallas/Maxim, poly 0x31 reflected) of the image bytes
+ *
+ */
+inline uint8_t schedule_crc8(const uint8_t *data, uint16_t len, uint8_t crc = 0)
+{
+  while (len--) {
+    uint8_t b = *data++;
+    for (uint8_t i = 0; i < 8; i++) {
+      uint8_t mix = (crc ^ b) & 0x01;
+      crc >>= 1;
+      if (mix)
+        crc ^= 0x8C;
+      b >>= 1;
+    }
+  }
+  return crc;
+}
+
+inline bool schedule_entry_valid(const ScheduleEntry &e)
+{
+  const uint8_t phase_len = e.start_on ? e.light_hours : e.dark_hours;
+  return e.light_hours > 0 && e.dark_hours > 0 && e.start_on <= 1 &&
+         e.start_hours < phase_len;
+}
+
+inline LightSchedule schedule_from_entry(const ScheduleEntry &e)
+{
+  return LightSchedule(e.light_hours, e.dark_hours, e.start_on != 0, e.start_hours);
+}
+
+// Current state of a schedule as an entry (hour 0 = now)
+inline ScheduleEntry schedule_to_entry(const LightSchedule &s)
+{
+  return ScheduleEntry{s.light_hours(), s.dark_hours(), uint8_t(s.is_on()), s.hours()};
+}
@@ -0,0 +1,106 @@
+/**
+ * @brief FastPin - compile-time Arduino pin to port/bit mapping
+ *
+ *
+ * @notes:
+ * - digitalWrite() looks the pin up in PROGMEM tables and masks
+ * interrupts on every call (~50 cycles at 16 MHz). With the pin known at
+ * compile time, high()/low() compile to a single sbi/cbi (2 cycles).
+ *
+ * - ATmega328P (UNO) mapping: D0-D7 = PORTD, D8-D13 = PORTB,
+ * A0-A5 (D14-D19) = PORTC.
+ *
+ * - ATmega2560 (MEGA) mapping follows the core's pins_arduino.h (D0-D69,
+ * A0-A15 = D54-D69). PORTH..PORTL sit above the sbi/cbi range, so writes
+ * there are lds/or/sts sequences; they run with interrupts masked so an
+ * ISR touching the same port cannot lose an update (~5 cycles more).
+ *
+ */
+#pragma once
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdint.h>
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__)
+
+template <uint8_t PIN>
+struct FastPin
+{
+  static_assert(PIN < 20, "Arduino pin out of range for ATmega328P");
+
+  static constexpr uint8_t bit = PIN < 8 ? PIN : PIN < 14 ? PIN - 8 : PIN - 14;
+  static constexpr uint8_t mask = uint8_t(1 << bit);
+
+  static volatile uint8_t &port() { return PIN < 8 ? PORTD : PIN < 14 ? PORTB : PORTC; }
+  static volatile uint8_t &ddr()  { return PIN < 8 ? DDRD  : PIN < 14 ? DDRB  : DDRC; }
+
+  static void output() { ddr() |= mask; }
+  static void high()   { port() |= mask; }
+  static void low()    { port() &= uint8_t(~mask); }
+  static void write(bool level) { if (level) high(); else low(); }
+};
+
+#elif defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+
+template <uint8_t PIN>
+struct FastPin
+{
+  static_assert(PIN < 70, "Arduino pin out of range for ATmega2560");
+
+  // Port letter and bit of D0..D69
+  static constexpr char letter =
+    "EEEEGEHHHHBBBBJJHHDDDDAAAAAAAACCCCCCCCDGGGLLLLLLLLBBBBFFFFFFFFKKKKKKKK"[PIN];
+  static constexpr uint8_t bit =
+    "0145533456456710103210012345677654321072107654321032100123456701234567"[PIN] - '0';
+  static constexpr uint8_t mask = uint8_t(1 << bit);
+  static constexpr bool extended = letter >= 'H';
+
+  static volatile uint8_t &port()
+  {
+    switch (letter) {
+      case 'A': return PORTA;  case 'B': return PORTB;  case 'C': return PORTC;
+      case 'D': return PORTD;  case 'E': return PORTE;  case 'F': return PORTF;
+      case 'G': return PORTG;  case 'H': return PORTH;  case 'J': return PORTJ;
+      case 'K': return PORTK;  default:  return PORTL;
+    }
+  }
+  static volatile uint8_t &ddr()
+  {
+    switch (letter) {
+      case 'A': return DDRA;  case 'B': return DDRB;  case 'C': return DDRC;
+      case 'D': return DDRD;  case 'E': return DDRE;  case 'F': return DDRF;
+      case 'G': return DDRG;  case 'H': return DDRH;  case 'J': return DDRJ;
+      case 'K': return DDRK;  default:  return DDRL;
+    }
+  }
+
+  static void output() { update(ddr(), mask, true); }
+  static void high()   { update(port(), mask, true); }
+  static void low()    { update(port(), mask, false); }
+  static void write(bool level) { if (level) high(); else low(); }
+
+private:
+  static void apply(volatile uint8_t &reg, uint8_t m, bool set)
+  {
+    if (set)
+      reg |= m;
+    else
+      reg &= uint8_t(~m);
+  }
+
+  static void update(volatile uint8_t &reg, uint8_t m, bool set)
+  {
+    if (extended) {
+      uint8_t sreg = SREG;
+      cli();
+      apply(reg, m, set);
+      SREG = sreg;
+    } else
+      apply(reg, m, set);
+  }
+};
+
+#else
+  #error "FastPin: no pin map for this MCU"
+#endif
@@ -0,0 +1,88 @@
+/**
+ * @brief RelayBus - cycle-exact frame transfer to the SerialRelay board
+ *
+ *
+ * @notes:
+ * - Same waveform as the SerialRelay library (8 bits per module, MSB
+ * first, data sampled on rising CLOCK, long clock pulse on the last bit
+ * latches), but pins and delays are compile-time constants: FastPin
+ * writes and __builtin_avr_delay_cycles() from a RelayTiming profile.
+ *
+ * - Interrupts are only masked while CLOCK is high on a data bit: an ISR
+ * stretching that pulse could charge the board's latch RC and latch a
+ * half-shifted frame. Data setup, CLOCK low and the latch pulse itself may
+ * be stretched freely, so a long chain (64 modules = 512 bits) streams out
+ * with interrupts served between bits, and the longest masked window is
+ * one clock_high phase whatever the chain length.
+ *
+ * - Usage:
+ *   typedef RelayBus<RelayTimingFast, RELAY_DATA, RELAY_CLK> Bus;
+ *   Bus::begin();
+ *   Bus::write_frame(frame.bytes(), frame.size());   (see RelayFrame.h)
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "FastPin.h"
+#include "RelayTiming.h"
+
+template <class Profile, uint8_t DATA_PIN, uint8_t CLK_PIN>
+class RelayBus
+{
+public:
+  static constexpr uint8_t relays_per_module = 4;
+
+  typedef RelayCycles<Profile> Cycles;
+  typedef FastPin<DATA_PIN> Data;
+  typedef FastPin<CLK_PIN> Clock;
+
+  static void begin()
+  {
+    Data::low();
+    Clock::low();
+    Data::output();
+    Clock::output();
+  }
+
+  /**
+   * @brief Shift `len` bytes out and latch them
+   *
+   * bytes[0] goes out first, so with a chain it ends up in the module
+   * farthest from the Arduino.
+   */
+  static void write_frame(const uint8_t *bytes, uint16_t len)
+  {
+    for (uint16_t i = 0; i < len; i++)
+      write_byte(bytes[i], i + 1 == len);
+    // Reset to maintain LOW level when not in use
+    Data::low();
+  }
+
+  static void write_byte(uint8_t value, bool last)
+  {
+    for (uint8_t mask = 0x80; mask; mask >>= 1) {
+      // set Data line
+      Data::write(value & mask);
+      __builtin_avr_delay_cycles(Cycles::data);
+      if (last && mask == 0x01) {
+        // latch pulse, only needs to be long enough
+        Clock::high();
+        __builtin_avr_delay_cycles(Cycles::latch);
+        Clock::low();
+      } else {
+        // rising edge, must not be stretched
+        uint8_t sreg = SREG;
+        cli();
+        Clock::high();
+        __builtin_avr_delay_cycles(Cycles::clock_high);
+        Clock::low();
+        SREG = sreg;
+      }
+      __builtin_avr_delay_cycles(Cycles::clock_low);
+    }
+  }
+};
@@ -0,0 +1,33 @@
+/**
+ * @brief RelayDriver - compile-time selection of the relay output driver
+ *
+ *
+ * @notes:
+ * - A relay driver is any class with this static interface:
+ *   static constexpr uint8_t relays_per_module;
+ *   static void begin();
+ *   static void write_frame(const uint8_t *bytes, uint16_t len);
+ * where bytes[0] is the module farthest from the Arduino. Callers name
+ * the driver through a typedef, so every call is resolved (and usually
+ * inlined) at compile time: no vtable, no function pointer.
+ *
+ * - Drivers:
+ *   RelayBus<Profile, DATA_PIN, CLK_PIN>  RoboCore SerialRelay (RelayBus.h)
+ *   ShiftRegisterBus<LATCH_PIN>           74HC595 on hardware SPI (ShiftRegisterBus.h)
+ *
+ * - Usage:
+ *   typedef ShiftRegisterBus<10> Driver;
+ *   RelayDriverFrame<Driver, NumModules> frame;
+ *   Driver::begin();
+ *   Driver::write_frame(frame.bytes(), frame.size());
+ *
+ */
+#pragma once
+
+#include "RelayBus.h"
+#include "RelayFrame.h"
+#include "ShiftRegisterBus.h"
+
+// Frame image laid out for a driver's boards
+template <class Driver, uint16_t MODULES>
+using RelayDriverFrame = RelayFrame<MODULES, Driver::relays_per_module>;
@@ -0,0 +1,71 @@
+/**
+ * @brief RelayFrame - compile-time sized image of a relay board chain
+ *
+ *
+ * @notes:
+ * - One byte per module, relay r in bit r-1: 4 relays per SerialRelay
+ * module (bits 0..3), 8 per 74HC595 board. Module 1 is the one wired to
+ * the Arduino; it is stored last because the first byte shifted out ends
+ * up in the farthest module, so bytes() can go straight to the driver's
+ * write_frame() (see RelayDriver.h).
+ *
+ * - The buffer is a plain array of MODULES bytes, no heap and no library
+ * limit on the chain length (64 modules = 64 bytes of RAM).
+ *
+ * - Usage:
+ *   RelayFrame<NumModules, Driver::relays_per_module> frame;
+ *   frame.set(relay, module, true);
+ *   Driver::write_frame(frame.bytes(), frame.size());
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define RELAY_FRAME_RELAYS_PER_MODULE 4
+
+template <uint16_t MODULES, uint8_t RELAYS = RELAY_FRAME_RELAYS_PER_MODULE>
+class RelayFrame
+{
+  static_assert(MODULES > 0, "RelayFrame needs at least one module");
+  static_assert(RELAYS > 0 && RELAYS <= 8, "a module is one byte");
+
+public:
+  static constexpr uint16_t modules = MODULES;
+  static constexpr uint16_t channels = MODULES * RELAYS;
+
+  RelayFrame() { clear(); }
+
+  void clear() { memset(data_, 0, sizeof(data_)); }
+
+  /**
+   * @brief Set one relay
+   *
+   * @param relay 1..RELAYS, as in SerialRelay::SetRelay()
+   * @param module 1..MODULES, 1 is the one next to the Arduino
+   */
+  void set(uint8_t relay, uint16_t module, bool on)
+  {
+    uint8_t &b = data_[MODULES - module];
+    uint8_t mask = uint8_t(1 << (relay - 1));
+    b = on ? (b | mask) : (b & ~mask);
+  }
+
+  // Relay channel 0..channels-1 across the chain: module 1 first, then module 2, ...
+  void set_channel(uint16_t channel, bool on)
+  {
+    set(channel % RELAYS + 1, channel / RELAYS + 1, on);
+  }
+
+  bool get(uint8_t relay, uint16_t module) const
+  {
+    return data_[MODULES - module] & (1 << (relay - 1));
+  }
+
+  const uint8_t *bytes() const { return data_; }
+  static constexpr uint16_t size() { return MODULES; }
+
+private:
+  uint8_t data_[MODULES];
+};
@@ -0,0 +1,62 @@
+/**
+ * @brief RelayTiming - relay bus timing profiles, in CPU cycles
+ *
+ *
+ * @notes:
+ * - Each profile gives the length of every phase of a bit in ns. The
+ * cycle counts are computed from F_CPU at compile time (rounded up) and
+ * burned with __builtin_avr_delay_cycles(), which is exact, instead of
+ * delayMicroseconds(), which has 1 us granularity plus call overhead.
+ *
+ * - Phases of one bit (see RelayBus.h):
+ *   DATA set -> data_ns -> CLOCK high -> clock_high_ns (latch_ns on the
+ *   last bit of a frame) -> CLOCK low -> clock_low_ns
+ *
+ * - RelayTimingConservative: the SerialRelay library's own delays, the
+ *   default.
+ *   RelayTimingFast (RelayTimingFast.h): uncalibrated, from relaymodel's
+ *   placeholder RC model, opt-in only.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <SerialRelay.h>
+
+#include "RelayTimingFast.h"
+
+struct RelayTimingConservative
+{
+  static constexpr uint32_t data_ns       = SERIAL_RELAY_DELAY_DATA * 1000UL;
+  static constexpr uint32_t clock_high_ns = SERIAL_RELAY_DELAY_CLOCK_HIGH * 1000UL;
+  static constexpr uint32_t clock_low_ns  = SERIAL_RELAY_DELAY_CLOCK_LOW * 1000UL;
+  static constexpr uint32_t latch_ns      = SERIAL_RELAY_DELAY_LATCH * 1000UL;
+};
+
+constexpr uint32_t relay_ns_to_cycles(uint32_t ns)
+{
+  return uint32_t(((uint64_t)ns * (F_CPU / 1000UL) + 999999UL) / 1000000UL);
+}
+
+// A phase already spends `overhead` cycles in the pin writes around it
+constexpr uint32_t relay_delay_cycles(uint32_t ns, uint32_t overhead)
+{
+  return relay_ns_to_cycles(ns) > overhead ? relay_ns_to_cycles(ns) - overhead : 0;
+}
+
+template <class Profile>
+struct RelayCycles
+{
+  // sbi/cbi = 2 cycles, SREG restore, the data-bit test and branch ~4 more
+  static constexpr uint32_t data       = relay_delay_cycles(Profile::data_ns, 2);
+  static constexpr uint32_t clock_high = relay_delay_cycles(Profile::clock_high_ns, 2);
+  static constexpr uint32_t clock_low  = relay_delay_cycles(Profile::clock_low_ns, 6);
+  static constexpr uint32_t latch      = relay_delay_cycles(Profile::latch_ns, 2);
+
+  // Whole frame of `bits` bits, for reporting and budgeting
+  static constexpr uint32_t frame_ns(uint16_t bits)
+  {
+    return (bits - 1) * (Profile::data_ns + Profile::clock_high_ns + Profile::clock_low_ns) +
+           Profile::data_ns + Profile::latch_ns + Profile::clock_low_ns;
+  }
+};
@@ -0,0 +1,28 @@
+/**
+ * @brief RelayTimingFast - short SerialRelay bit phases, UNCALIBRATED
+ *
+ *
+ * @notes:
+ * - Phase lengths in ns (see RelayTiming.h for the phases of one bit).
+ * No CPU or Arduino dependency, so the AVR RelayBus and the STM32 port
+ * (lib/HalStm32) share this one definition.
+ *
+ * - Not measured on any board: these are host/relaymodel's minimum
+ * delays (x2 margin, rounded up) for its default RC model, tau_charge
+ * 100 us, tau_discharge 10 us, threshold 0.5, which are placeholders,
+ * not the R/C of a real SerialRelay module. Opt-in only
+ * (RELAY_TIMING_FAST in src/main.cpp): re-run relaymodel with the
+ * measured RC values of your board and update these before using it.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+struct RelayTimingFast
+{
+  static constexpr uint32_t data_ns       = 250;
+  static constexpr uint32_t clock_high_ns = 1000;
+  static constexpr uint32_t clock_low_ns  = 1000;
+  static constexpr uint32_t latch_ns      = 150000;
+};
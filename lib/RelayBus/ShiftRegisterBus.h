@@ -0,0 +1,72 @@
+/**
+ * @brief ShiftRegisterBus - 74HC595 relay boards on the hardware SPI port
+ *
+ *
+ * @notes:
+ * - Wiring: MOSI -> SER (DS), SCK -> SRCLK (SH_CP), LATCH_PIN -> RCLK
+ * (ST_CP), OE tied low, SRCLR tied high, QH' -> SER of the next board.
+ * UNO: MOSI = D11, SCK = D13 (also LED_BUILTIN, so no FEATURE_DEBUG_LED).
+ *
+ * - SPI runs at F_CPU/2 (8 MHz on UNO, mode 0, MSB first): one byte
+ * every 16-18 cycles instead of the ~100 us per byte of the SerialRelay
+ * waveform. The 74HC595 needs no timing margins at that speed and has a
+ * dedicated latch line, so nothing here masks interrupts.
+ *
+ * - Outputs hold random levels from power-up until the first latch:
+ * send an all-OFF frame right after begin().
+ *
+ * - Same driver interface as RelayBus (see RelayDriver.h), with 8 relays
+ * per module: relay r of a board is output Q(r-1).
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "FastPin.h"
+
+template <uint8_t LATCH_PIN>
+class ShiftRegisterBus
+{
+public:
+  static constexpr uint8_t relays_per_module = 8;
+
+  typedef FastPin<LATCH_PIN> Latch;
+
+  static void begin()
+  {
+    Latch::low();
+    Latch::output();
+    // SS must be an output or a low level on it drops SPI out of master mode
+    FastPin<SS>::output();
+    FastPin<MOSI>::output();
+    FastPin<SCK>::output();
+    // Enable, master, mode 0, MSB first, F_CPU/4 | SPI2X = F_CPU/2
+    SPCR = _BV(SPE) | _BV(MSTR);
+    SPSR = _BV(SPI2X);
+  }
+
+  /**
+   * @brief Shift `len` bytes out and latch them
+   *
+   * bytes[0] goes out first and ends up in the board farthest from the
+   * Arduino, as with RelayBus.
+   */
+  static void write_frame(const uint8_t *bytes, uint16_t len)
+  {
+    if (!len)
+      return;
+    SPDR = bytes[0];
+    for (uint16_t i = 1; i < len; i++) {
+      // Fetch the next byte while the current one is on the wire
+      uint8_t next = bytes[i];
+      while (!(SPSR & _BV(SPIF)));
+      SPDR = next;
+    }
+    while (!(SPSR & _BV(SPIF)));
+    // Rising RCLK copies the shift registers to the outputs
+    Latch::high();
+    Latch::low();
+  }
+};
@@ -0,0 +1,82 @@
+/**
+ * @brief RtuSerial - interrupt-driven Modbus RTU transport on USART0
+ *
+ *
+ * @notes:
+ * - Replaces HardwareSerial: it owns the USART0 interrupts, so a build
+ * using it must not reference Serial anywhere.
+ *
+ * - Frame delimiting is done by Timer2, not by polling: every received
+ * byte restarts it, its compare match fires after t3.5 of silence and
+ * closes the frame. A byte arriving more than t1.5 after the previous
+ * one marks the frame broken (Modbus over serial line, 2.5.1.1).
+ * Above 19200 baud t1.5/t3.5 are the fixed 750/1750 us of the spec.
+ * Below RTU_SERIAL_MIN_BAUD (2360 at 16 MHz) t3.5 no longer fits
+ * Timer2 at its largest prescaler: begin() refuses those rates.
+ *
+ * - Two receive buffers: a frame can be received while the loop still
+ * works on the previous one, so requests sent back to back are not lost.
+ * A third frame arriving before the loop released the first is dropped
+ * and counted in overruns(), whole: also when the buffer is released
+ * while that frame is still coming in.
+ *
+ * - Transmission runs from the UDRE interrupt out of its own buffer.
+ * tx_busy() stays true until the TX-complete interrupt: the last stop
+ * bit has left the shift register, not just the data register.
+ *
+ * - RS-485 (half duplex, multidrop): define RTU_SERIAL_DE_PIN (build
+ * flag) as the pin wired to the transceiver's DE and /RE. It goes high
+ * when a frame is queued and drops in the TX-complete interrupt, a few
+ * cycles after the stop bit, so the bus is released well inside the t3.5
+ * the master waits before its next request. The receiver is off while
+ * transmitting: the own echo is not taken as a request.
+ *
+ * - Stamps for time sync (lib/EstufaCore/TimeSync.h): micros() taken
+ * in the RX interrupt at the first byte of each frame and in the UDRE
+ * interrupt at the first byte sent, the clock HalAvr::clock() reads.
+ *
+ * - Usage:
+ *   RtuSerial::begin(115200);
+ *   uint16_t len; const uint8_t *req = RtuSerial::frame(len);
+ *   if (req) { ...; RtuSerial::release(); RtuSerial::send(resp, n); }
+ *   (send() is false while the previous frame is going out: keep the
+ *   response and try again on a later pass)
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifndef RTU_SERIAL_BUFFER
+  #define RTU_SERIAL_BUFFER 64   // Bytes per frame buffer (Modbus allows 256)
+#endif
+
+// Slowest rate whose t3.5 (38.5e6 / baud us) is 255 Timer2 ticks at /1024
+#define RTU_SERIAL_MIN_BAUD \
+  uint32_t((38500000ULL * (F_CPU / 1000000UL) + 255UL * 1024 - 1) / (255UL * 1024))
+
+class RtuSerial
+{
+public:
+  // False, USART0 left alone, below RTU_SERIAL_MIN_BAUD or above F_CPU / 8
+  static bool begin(uint32_t baud);
+
+  // Oldest complete frame, or nullptr. Valid until release().
+  static const uint8_t *frame(uint16_t &len);
+  static void release();
+  // micros() at the first byte of the frame returned by frame()
+  static uint32_t rx_stamp();
+  // micros() at the first byte of the last frame sent
+  static uint32_t tx_stamp();
+
+  // Queue a frame for transmission; false while the previous one is going
+  // out, or for an empty or oversized frame
+  static bool send(const uint8_t *data, uint16_t len);
+  // Until the last bit is on the wire (and DE released)
+  static bool tx_busy();
+
+  // Frames dropped: no free buffer, or longer than RTU_SERIAL_BUFFER
+  static uint16_t overruns();
+  // Frames dropped: UART framing/overrun error or t1.5 gap inside
+  static uint16_t broken();
+};
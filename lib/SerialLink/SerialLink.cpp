@@ -0,0 +1,191 @@
+#include "SerialLink.h"
+
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include <LinkFrame.h>
+
+#if defined(USART_RX_vect)
+  #define LINK_RX_vect   USART_RX_vect
+  #define LINK_UDRE_vect USART_UDRE_vect
+#else
+  #define LINK_RX_vect   USART0_RX_vect
+  #define LINK_UDRE_vect USART0_UDRE_vect
+#endif
+
+static TxQueues<SERIAL_LINK_QUEUE> tx;
+static FrameRing<SERIAL_LINK_RX> rx;
+static uint16_t bad_frame_count = 0;
+static bool tx_started = false;
+
+static uint16_t now_us()
+{
+  return uint16_t(micros());
+}
+
+static void tx_kick()
+{
+  IsrGuard guard;
+  UCSR0B |= _BV(UDRIE0);
+  tx_started = true;
+}
+
+
+// Line-framed text: one frame per line, or per max_frame bytes
+class LinkWriter : public Print
+{
+public:
+  size_t write(uint8_t c) override
+  {
+    buf_[len_++] = c;
+    if (c == '\n' || len_ == sizeof(buf_))
+      flush();
+    return 1;
+  }
+  using Print::write;
+
+  void flush()
+  {
+    if (len_)
+      SerialLink::send(prio_, buf_, len_, true);
+    len_ = 0;
+  }
+
+  void select(uint8_t prio)
+  {
+    if (prio != prio_)
+      flush();
+    prio_ = prio;
+  }
+
+private:
+  uint8_t buf_[SerialLink::max_frame];
+  uint8_t len_ = 0;
+  uint8_t prio_ = SerialLink::TELEMETRY;
+};
+
+static LinkWriter writer;
+
+
+// UBRR0 takes 12 bits: baud_ok() refuses rates that need more
+static uint32_t ubrr(uint32_t baud)
+{
+  return (F_CPU / 8 + baud / 2) / baud - 1;
+}
+
+void SerialLink::begin(uint32_t baud)
+{
+  // 8N1, double speed (115200 is 2.1% off at 16 MHz, 3.5% without)
+  UCSR0A = _BV(U2X0);
+  UBRR0 = uint16_t(ubrr(baud));
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  // Each subsystem on the link calls begin(): keep what is queued going
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0) | (UCSR0B & _BV(UDRIE0));
+}
+
+bool SerialLink::baud_ok(uint32_t baud)
+{
+  if (baud == 0 || baud > F_CPU / 8 || ubrr(baud) > 4095)
+    return false;
+  const uint32_t actual = F_CPU / 8 / (ubrr(baud) + 1);
+  const uint32_t diff = actual > baud ? actual - baud : baud - actual;
+  return diff <= baud / 50 + baud / 400;     // 2.25%: 115200 passes at 16 MHz
+}
+
+bool SerialLink::set_baud(uint32_t baud)
+{
+  if (!baud_ok(baud))
+    return false;
+  UBRR0 = uint16_t(ubrr(baud));
+  return true;
+}
+
+bool SerialLink::send(uint8_t prio, const void *data, uint8_t len, bool wait)
+{
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  while (!tx.push(prio, p, len, now_us())) {
+    if (!wait || len == 0 || len > max_frame) {
+      tx.drop(prio);
+      return false;
+    }
+    tx_kick();
+  }
+  tx_kick();
+  return true;
+}
+
+Print &SerialLink::out(uint8_t prio)
+{
+  writer.select(prio);
+  return writer;
+}
+
+uint8_t SerialLink::space(uint8_t prio)
+{
+  return tx.space(prio);
+}
+
+void SerialLink::flush_line()
+{
+  writer.flush();
+}
+
+bool SerialLink::frame(RingSpan &payload)
+{
+  while (rx.frame(payload)) {
+    const int16_t len = link_decode(payload, payload.len);
+    if (len >= 0) {
+      payload.len = uint8_t(len);
+      return true;
+    }
+    bad_frame_count++;
+  }
+  return false;
+}
+
+void SerialLink::release()
+{
+  rx.release();
+}
+
+bool SerialLink::idle()
+{
+  // TXC is cleared with every byte loaded: set once the last stop bit left
+  return tx.empty() && (!tx_started || (UCSR0A & _BV(TXC0)));
+}
+
+void SerialLink::stats(uint8_t prio, TxStats &s)
+{
+  IsrGuard guard;
+  tx.stats(prio, s);
+}
+
+uint16_t SerialLink::rx_overruns()
+{
+  IsrGuard guard;
+  return rx.overruns();
+}
+
+uint16_t SerialLink::bad_frames()
+{
+  return bad_frame_count;
+}
+
+
+ISR(LINK_RX_vect)
+{
+  rx.put(UDR0);
+}
+
+ISR(LINK_UDRE_vect)
+{
+  int16_t c = tx.next(now_us);
+  if (c < 0)
+    UCSR0B &= uint8_t(~_BV(UDRIE0));
+  else {
+    // Clear TX complete (U2X0 written back as read, error flags as 0)
+    UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+    UDR0 = uint8_t(c);
+  }
+}
@@ -0,0 +1,98 @@
+/**
+ * @brief SerialLink - interrupt-driven USART0 with prioritized transmit
+ *
+ *
+ * @notes:
+ * - Replaces HardwareSerial for the status build (RtuSerial does the same
+ * for Modbus): it owns the USART0 interrupts, so a build using it must
+ * not reference Serial anywhere.
+ *
+ * - Four transmit queues (lib/SerialLink/TxQueues.h), most urgent first:
+ *   RESPONSE   answers to host commands
+ *   ALARM      faults the operator must see
+ *   TELEMETRY  status lines, periodic snapshots
+ *   BULK       log dumps
+ * The UDRE interrupt picks the most urgent waiting frame each time one
+ * ends, so heavy logging delays a response by one bulk frame at most
+ * (SERIAL_LINK_QUEUE - 3 bytes, 5.3 ms at 115200).
+ *
+ * - send() queues a whole binary frame, or nothing; out() is a Print for
+ * text, one frame per line. Both are for the main loop (one producer per
+ * queue); out() waits for room, send() waits only when asked to.
+ *
+ * - The host only sends LinkFrames (COBS with a CRC,
+ * lib/EstufaCore/LinkFrame.h). They stay in the receive ring
+ * (lib/IsrSafe/FrameRing.h) until handled: frame() decodes the next one
+ * where it lies and hands out a RingSpan over its payload, release()
+ * frees the bytes. Frames failing their check are dropped and counted
+ * in bad_frames(); bytes arriving while the ring is full, in
+ * rx_overruns().
+ *
+ * - set_baud() changes the rate on the fly, for LinkSession's negotiated
+ * upgrade (lib/EstufaCore/LinkSession.h): always in double speed mode,
+ * so at 16 MHz 250k, 500k and 1M are exact (UBRR 7, 3, 1) where 115200
+ * is 2.1% off. Rates further off than that are refused (baud_ok()), as
+ * are rates too slow for the 12-bit UBRR (below about 490 at 16 MHz).
+ *
+ * - RAM: 4 x SERIAL_LINK_QUEUE + SERIAL_LINK_RX + one line buffer.
+ *
+ * - Usage:
+ *   SerialLink::begin(SERIAL_LINK_BAUD);
+ *   SerialLink::out(SerialLink::TELEMETRY).println(F("hello"));
+ *   SerialLink::send(SerialLink::BULK, chunk, len);
+ *
+ */
+#pragma once
+
+#include <Print.h>
+#include <stdint.h>
+
+#include <FrameRing.h>
+
+#include "TxQueues.h"
+
+#ifndef SERIAL_LINK_BAUD
+  #define SERIAL_LINK_BAUD 115200   // Base rate, monitor_speed in platformio.ini
+#endif
+#ifndef SERIAL_LINK_QUEUE
+  #define SERIAL_LINK_QUEUE 64      // Bytes per priority, power of two
+#endif
+#ifndef SERIAL_LINK_RX
+  #define SERIAL_LINK_RX 64         // Power of two, 8..128
+#endif
+
+class SerialLink
+{
+public:
+  enum Priority { RESPONSE, ALARM, TELEMETRY, BULK };
+  typedef RingSpan Span;
+
+  static constexpr uint8_t max_frame = SERIAL_LINK_QUEUE - 3;
+
+  static void begin(uint32_t baud);
+
+  // The rate is within 2.25% at F_CPU and fits UBRR0
+  static bool baud_ok(uint32_t baud);
+  // Switch rates; call once idle() or bytes in flight are garbled
+  static bool set_baud(uint32_t baud);
+
+  // Queue one frame (1..max_frame bytes); false if it does not fit
+  static bool send(uint8_t prio, const void *data, uint8_t len, bool wait = false);
+  // Text on `prio`, framed per line (or per max_frame bytes)
+  static Print &out(uint8_t prio);
+  // Largest frame send() takes on `prio` right now
+  static uint8_t space(uint8_t prio);
+  // Queue the pending partial line, if any
+  static void flush_line();
+
+  // Next valid received frame, decoded in the ring; valid until release()
+  static bool frame(RingSpan &payload);
+  static void release();
+
+  // Everything queued is on the wire, last stop bit included
+  static bool idle();
+
+  static void stats(uint8_t prio, TxStats &s);
+  static uint16_t rx_overruns();
+  static uint16_t bad_frames();
+};
@@ -0,0 +1,142 @@
+/**
+ * @brief TxQueues - prioritized frame queues for one transmitter
+ *
+ *
+ * @notes:
+ * - One byte queue per priority, 0 the most urgent. The producer (main
+ * loop) queues whole frames; the transmit interrupt takes them out a byte
+ * at a time with next().
+ *
+ * - The queue is chosen at frame boundaries only: the frame going out
+ * always finishes, then the most urgent waiting frame starts. A response
+ * queued behind a bulk dump waits for at most the rest of one bulk frame
+ * (N - 3 bytes), plus the responses ahead of it, whatever the backlog
+ * of lower priorities.
+ *
+ * - Each frame is stored as [len][stamp lo][stamp hi][len bytes]. The head
+ * only moves once the whole frame is in, so the interrupt never starts a
+ * partial one. The stamp (a 16-bit microsecond clock) gives each
+ * priority's worst queueing delay, up to 65 ms.
+ *
+ * - Portable: AVR (lib/SerialLink) and host builds share it.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <IsrAtomic.h>
+
+#define TX_QUEUE_PRIORITIES 4
+
+struct TxStats
+{
+  uint16_t frames;        // Sent
+  uint16_t dropped;       // Did not fit when queued
+  uint16_t preempted;     // Started ahead of a less urgent waiting frame
+  uint16_t max_wait_us;   // Worst queued-to-first-byte delay
+};
+
+template <uint8_t N>
+class TxQueues
+{
+  static_assert(N >= 8 && N <= 128 && (N & (N - 1)) == 0, "TxQueues size must be a power of two, 8..128");
+
+public:
+  static constexpr uint8_t priorities = TX_QUEUE_PRIORITIES;
+  static constexpr uint8_t max_frame = N - 3;
+
+  // Producer: the whole frame or nothing
+  bool push(uint8_t prio, const uint8_t *data, uint8_t len, uint16_t stamp)
+  {
+    Queue &q = q_[prio];
+    const uint8_t h = q.head;
+    if (len == 0 || len > max_frame || uint8_t(N - uint8_t(h - isr_load(q.tail))) < len + 3)
+      return false;
+    q.buf[h & MASK] = len;
+    q.buf[uint8_t(h + 1) & MASK] = uint8_t(stamp);
+    q.buf[uint8_t(h + 2) & MASK] = uint8_t(stamp >> 8);
+    for (uint8_t i = 0; i < len; i++)
+      q.buf[uint8_t(h + 3 + i) & MASK] = data[i];
+    isr_store(q.head, uint8_t(h + 3 + len));
+    return true;
+  }
+
+  // Producer: count a frame the caller gave up on
+  void drop(uint8_t prio) { stats_[prio].dropped++; }
+
+  // Producer: bytes a frame may have right now
+  uint8_t space(uint8_t prio) const
+  {
+    const uint8_t free = uint8_t(N - uint8_t(q_[prio].head - isr_load(q_[prio].tail)));
+    return free > 3 ? free - 3 : 0;
+  }
+
+  /**
+   * @brief Consumer (transmit interrupt): next byte on the wire
+   *
+   * @param now returns the 16-bit microsecond clock, called once per frame
+   * @return the byte, or -1 when every queue is empty
+   */
+  template <class Now>
+  int16_t next(Now now)
+  {
+    if (!left_) {
+      uint8_t p = 0;
+      while (p < priorities && isr_load(q_[p].head) == q_[p].tail)
+        p++;
+      if (p == priorities)
+        return -1;
+      Queue &q = q_[p];
+      const uint8_t t = q.tail;
+      left_ = q.buf[t & MASK];
+      const uint16_t stamp = q.buf[uint8_t(t + 1) & MASK] | uint16_t(q.buf[uint8_t(t + 2) & MASK]) << 8;
+      isr_store(q.tail, uint8_t(t + 3));
+      cur_ = p;
+
+      TxStats &s = stats_[p];
+      s.frames++;
+      const uint16_t wait = uint16_t(now() - stamp);
+      if (wait > s.max_wait_us)
+        s.max_wait_us = wait;
+      for (uint8_t lower = p + 1; lower < priorities; lower++)
+        if (isr_load(q_[lower].head) != q_[lower].tail) {
+          s.preempted++;
+          break;
+        }
+    }
+    Queue &q = q_[cur_];
+    const uint8_t t = q.tail;
+    const uint8_t c = q.buf[t & MASK];
+    isr_store(q.tail, uint8_t(t + 1));
+    left_--;
+    return c;
+  }
+
+  // Nothing queued and no frame in progress
+  bool empty() const
+  {
+    for (uint8_t p = 0; p < priorities; p++)
+      if (isr_load(q_[p].head) != isr_load(q_[p].tail))
+        return false;
+    return true;
+  }
+
+  // Copy, with the consumer kept out by the caller (the counters are 16-bit)
+  void stats(uint8_t prio, TxStats &s) const { s = stats_[prio]; }
+
+private:
+  static constexpr uint8_t MASK = N - 1;
+
+  struct Queue
+  {
+    uint8_t buf[N];
+    uint8_t head = 0;     // Producer
+    uint8_t tail = 0;     // Consumer
+  };
+
+  Queue q_[TX_QUEUE_PRIORITIES];
+  uint8_t cur_ = 0;       // Queue of the frame going out
+  uint8_t left_ = 0;      // Its bytes still to send
+  TxStats stats_[TX_QUEUE_PRIORITIES] = {};
+};
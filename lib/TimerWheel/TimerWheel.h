@@ -0,0 +1,232 @@
+/**
+ * @brief TimerWheel - hierarchical timing wheel for software timers
+ *
+ *
+ * @notes:
+ * - Any number of timers on one hardware tick. TimerInterrupt's ISR_Timer
+ * stops at 16 slots; here a timer is a SoftTimer the caller owns (static,
+ * or a member of its subsystem), the wheel only links it.
+ *
+ * - LEVELS wheels of 2^BITS slots, each level 2^BITS times coarser than
+ * the one below. A timer goes to the level whose range holds its delay,
+ * in the slot of its expiry tick: arm() and cancel() are O(1) list
+ * operations. When level 0 wraps, the next slot of level 1 is cascaded
+ * (its timers re-filed one level down), and so on up; a timer moves at
+ * most LEVELS times in its life, so expiry is amortized O(1).
+ *
+ * - Defaults (4 bits, 8 levels) cover the whole 32-bit tick range with
+ * 128 list heads (256 bytes on AVR). Delays beyond 2^31 ticks are split
+ * into laps, so with the 1.024 ms AVR tick a timer can run from one tick
+ * to years (arm_s()).
+ *
+ * - tick() is the only interrupt-side call: it counts ticks. Timers are
+ * armed, cancelled, and fire, from poll() in the main loop, so callbacks
+ * may take as long as they need, re-arm themselves or cancel others,
+ * and nothing here masks interrupts. The tick count is one byte: poll()
+ * must run at least every 255 ticks (a quarter second at 1 ms).
+ *
+ * - Usage:
+ *   typedef TimerWheel<> Timers;
+ *   void blink(SoftTimer &t) { ... }
+ *   static SoftTimer led(blink);
+ *   Timers::arm_ms(led, 500, 500);      // every 500 ms from now
+ *   ISR:  Timers::tick();
+ *   loop: Timers::poll();
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifndef TIMER_WHEEL_TICK_US
+  #if defined(__AVR__)
+    #define TIMER_WHEEL_TICK_US 1024    // Timer0 overflow period at 16 MHz
+  #else
+    #define TIMER_WHEEL_TICK_US 1000
+  #endif
+#endif
+
+struct SoftTimer
+{
+  typedef void (*Callback)(SoftTimer &);
+
+  explicit SoftTimer(Callback fn = nullptr, void *ctx = nullptr) : fn(fn), ctx(ctx) {}
+
+  bool active() const { return pprev != nullptr; }
+
+  Callback fn;
+  void *ctx;                // For the callback
+  uint32_t period = 0;      // Ticks, 0: one shot
+
+  // Wheel bookkeeping
+  SoftTimer *next = nullptr;
+  SoftTimer **pprev = nullptr;
+  uint32_t expires = 0;
+  uint16_t laps = 0;        // 2^31-tick laps still to run after expires
+};
+
+template <uint8_t BITS = 4, uint8_t LEVELS = 8>
+class TimerWheel
+{
+  static_assert(BITS >= 2 && BITS <= 8, "TimerWheel slots per level: 4..256");
+  static_assert(BITS * LEVELS >= 32 && BITS * (LEVELS - 1) < 32, "TimerWheel levels must just cover 32-bit delays");
+
+public:
+  static constexpr uint16_t slots = 1 << BITS;
+  static constexpr uint32_t tick_us = TIMER_WHEEL_TICK_US;
+
+  // Interrupt side: one hardware tick
+  static void tick() { ticks_++; }
+
+  // Main loop: run the ticks counted since the last call
+  static void poll()
+  {
+    uint8_t n = uint8_t(ticks_ - seen_);
+    seen_ += n;
+    advance(n);
+  }
+
+  // Process `n` ticks now (poll() without the interrupt; tests, benches)
+  static void advance(uint32_t n)
+  {
+    while (n--)
+      step();
+  }
+
+  /**
+   * @brief Start (or restart) a timer
+   *
+   * @param delay fires on the delay-th tick from now (0 same as 1)
+   * @param period reload in ticks after it fires, 0 for a one shot
+   */
+  static void arm(SoftTimer &t, uint32_t delay, uint32_t period = 0)
+  {
+    arm64_ticks(t, delay, period);
+  }
+
+  static void arm_ms(SoftTimer &t, uint32_t ms, uint32_t period_ms = 0)
+  {
+    arm64(t, uint64_t(ms) * 1000, period_ms);
+  }
+
+  // Months and years: split into laps
+  static void arm_s(SoftTimer &t, uint32_t s)
+  {
+    arm64(t, uint64_t(s) * 1000000, 0);
+  }
+
+  static void cancel(SoftTimer &t)
+  {
+    if (!t.pprev)
+      return;
+    *t.pprev = t.next;
+    if (t.next)
+      t.next->pprev = t.pprev;
+    t.next = nullptr;
+    t.pprev = nullptr;
+    armed_--;
+  }
+
+  // Ticks processed since begin
+  static uint32_t now() { return now_; }
+  static uint16_t armed() { return armed_; }
+
+  static constexpr uint32_t ticks(uint32_t ms)
+  {
+    return uint32_t((uint64_t(ms) * 1000 + tick_us - 1) / tick_us);
+  }
+
+private:
+  static constexpr uint16_t MASK = slots - 1;
+
+  static void arm64(SoftTimer &t, uint64_t us, uint32_t period_ms)
+  {
+    arm64_ticks(t, (us + tick_us - 1) / tick_us, period_ms ? ticks(period_ms) : 0);
+  }
+
+  // Whole laps of 2^31 ticks, the first run takes the rest (1..2^31)
+  static void arm64_ticks(SoftTimer &t, uint64_t n, uint32_t period)
+  {
+    const uint16_t laps = n ? uint16_t((n - 1) >> 31) : 0;
+    arm_laps(t, uint32_t(n - (uint64_t(laps) << 31)), laps, period);
+  }
+
+  static void arm_laps(SoftTimer &t, uint32_t delay, uint16_t laps, uint32_t period)
+  {
+    cancel(t);
+    t.expires = now_ + (delay ? delay - 1 : 0);
+    t.laps = laps;
+    t.period = period;
+    file(t);
+    armed_++;
+  }
+
+  // Link t into the slot for its expiry; now_ is the next tick to run,
+  // a timer fires in the step where now_ == expires
+  static void file(SoftTimer &t)
+  {
+    const uint32_t idx = t.expires - now_;
+    uint8_t level = 0;
+    while (level < LEVELS - 1 && (idx >> (BITS * (level + 1))) != 0)
+      level++;
+    SoftTimer **head = &wheel_[level][(t.expires >> (BITS * level)) & MASK];
+    t.next = *head;
+    if (t.next)
+      t.next->pprev = &t.next;
+    t.pprev = head;
+    *head = &t;
+  }
+
+  // Move every timer of `slot` down (level > 0); returns the slot index
+  static uint8_t cascade(uint8_t level)
+  {
+    const uint8_t slot = (now_ >> (BITS * level)) & MASK;
+    SoftTimer *t = wheel_[level][slot];
+    wheel_[level][slot] = nullptr;
+    while (t) {
+      SoftTimer *next = t->next;
+      file(*t);
+      t = next;
+    }
+    return slot;
+  }
+
+  static void step()
+  {
+    const uint8_t slot = now_ & MASK;
+    if (slot == 0)
+      for (uint8_t level = 1; level < LEVELS && cascade(level) == 0; level++)
+        ;
+    now_++;
+
+    // Detach the slot, so callbacks can arm into it or cancel its timers
+    SoftTimer *due = wheel_[0][slot];
+    wheel_[0][slot] = nullptr;
+    if (due)
+      due->pprev = &due;
+    while (due) {
+      SoftTimer &t = *due;
+      cancel(t);
+      if (t.laps) {
+        arm_laps(t, 1UL << 31, t.laps - 1, t.period);
+      } else {
+        if (t.period)
+          arm_laps(t, t.period, 0, t.period);
+        if (t.fn)
+          t.fn(t);
+      }
+    }
+  }
+
+  static SoftTimer *wheel_[LEVELS][slots];
+  static uint32_t now_;
+  static uint16_t armed_;
+  static volatile uint8_t ticks_;   // Written by tick() only
+  static uint8_t seen_;
+};
+
+template <uint8_t BITS, uint8_t LEVELS> SoftTimer *TimerWheel<BITS, LEVELS>::wheel_[LEVELS][TimerWheel<BITS, LEVELS>::slots];
+template <uint8_t BITS, uint8_t LEVELS> uint32_t TimerWheel<BITS, LEVELS>::now_ = 0;
+template <uint8_t BITS, uint8_t LEVELS> uint16_t TimerWheel<BITS, LEVELS>::armed_ = 0;
+template <uint8_t BITS, uint8_t LEVELS> volatile uint8_t TimerWheel<BITS, LEVELS>::ticks_ = 0;
+template <uint8_t BITS, uint8_t LEVELS> uint8_t TimerWheel<BITS, LEVELS>::seen_ = 0;
@@ -0,0 +1,105 @@
+/**
+ * @brief WheelBench - portable benchmark and check of TimerWheel
+ *
+ *
+ * @notes:
+ * - Same code on every port, timed with the HAL clock, reported like
+ * CoreBench (lib/EstufaCore/CoreBench.h): report(name, ops, clocks).
+ *
+ * - WHEEL_BENCH_TIMERS one-shot timers with delays mixed like the
+ * firmware's: a quarter short (debounce, under 64 ticks), half medium
+ * (ramps, polls, under 4096) and a quarter long (schedule events, up to
+ * 2^20). Each re-arms itself with a new delay when it fires, so the
+ * count stays constant while WHEEL_BENCH_TICKS ticks run.
+ *
+ * - Cases:
+ *   wheel_arm      arm one timer
+ *   wheel_tick     one tick with every timer armed, expiries included
+ *   wheel_cancel   cancel one timer
+ *
+ * - Returns the number of timers that fired on the wrong tick (0).
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "TimerWheel.h"
+
+#ifndef WHEEL_BENCH_TIMERS
+  #if defined(RAMEND) && RAMEND < 0x1000
+    #define WHEEL_BENCH_TIMERS 48       // ATmega328: 2 KB of RAM
+  #else
+    #define WHEEL_BENCH_TIMERS 256
+  #endif
+#endif
+#define WHEEL_BENCH_TICKS 8192
+
+template <class Wheel>
+struct WheelBenchState
+{
+  static SoftTimer timers[WHEEL_BENCH_TIMERS];
+  static uint32_t due[WHEEL_BENCH_TIMERS];
+  static uint32_t seed;
+  static uint16_t errors;
+  static uint32_t fired;
+
+  static uint32_t random_delay()
+  {
+    seed = seed * 1103515245UL + 12345;
+    const uint32_t r = seed >> 8;
+    switch (r & 3) {
+      case 0:  return 1 + (r >> 2) % 64;
+      case 3:  return 1 + (r >> 2) % (1UL << 20);
+      default: return 1 + (r >> 2) % 4096;
+    }
+  }
+
+  static void arm(uint16_t i)
+  {
+    const uint32_t d = random_delay();
+    due[i] = Wheel::now() + d;
+    Wheel::arm(timers[i], d);
+  }
+
+  static void expired(SoftTimer &t)
+  {
+    const uint16_t i = uint16_t(&t - timers);
+    if (Wheel::now() != due[i])
+      errors++;
+    fired++;
+    arm(i);
+  }
+};
+
+template <class Wheel> SoftTimer WheelBenchState<Wheel>::timers[WHEEL_BENCH_TIMERS];
+template <class Wheel> uint32_t WheelBenchState<Wheel>::due[WHEEL_BENCH_TIMERS];
+template <class Wheel> uint32_t WheelBenchState<Wheel>::seed = 1;
+template <class Wheel> uint16_t WheelBenchState<Wheel>::errors = 0;
+template <class Wheel> uint32_t WheelBenchState<Wheel>::fired = 0;
+
+template <class Wheel, class Hal, class Report>
+uint16_t wheel_bench(Report report)
+{
+  typedef WheelBenchState<Wheel> S;
+  for (uint16_t i = 0; i < WHEEL_BENCH_TIMERS; i++)
+    S::timers[i].fn = S::expired;
+
+  uint32_t start = Hal::clock();
+  for (uint16_t i = 0; i < WHEEL_BENCH_TIMERS; i++)
+    S::arm(i);
+  report("wheel_arm", WHEEL_BENCH_TIMERS, Hal::clock() - start);
+
+  start = Hal::clock();
+  Wheel::advance(WHEEL_BENCH_TICKS);
+  report("wheel_tick", WHEEL_BENCH_TICKS, Hal::clock() - start);
+
+  start = Hal::clock();
+  for (uint16_t i = 0; i < WHEEL_BENCH_TIMERS; i++)
+    Wheel::cancel(S::timers[i]);
+  report("wheel_cancel", WHEEL_BENCH_TIMERS, Hal::clock() - start);
+
+  if (Wheel::armed() != 0)
+    S::errors++;
+  return S::errors;
+}
@@ -1,24 +1,21 @@
 
 /**
- * @brief DEBUG MODE
- * For DEBUG, uncomment this line 
+ * @brief FIRMWARE FEATURES
+ * Subsystems to build in (debug LED, status log, Modbus, timers) are 
+ * picked in include/firmware_features.h; the subsystems themselves are 
+ * in include/subsystems.h
  * 
  */
-//#define DEBUG_MODE
+#include <firmware_features.h>
+#include <subsystems.h>
 
 
 /**
  * @brief USER's LIGHT SCHEDULE
- * Define the light patterns you want to use
- * 
- * LIGHT_HOURS: How many hours of light
- * DARK_HOURS: How many hours of dark
+ * Light patterns and zone table live in include/schedule_config.h
  * 
  */
-#define LIGHT_HOURS 18  // Hours with lights on
-#define DARK_HOURS  6   // Hours with lights off
-// If the relay must start activated, uncomment this line
-#define START_RELAY_ON
+#include <schedule_config.h>
 
 
 /**
@@ -27,6 +24,9 @@
  * 
  * @notes:
  * - https://github.com/RoboCore/SerialRelay
+ * - Only its waveform delays are used (lib/RelayBus/RelayTiming.h). 
+ * The SerialRelay object keeps a buffer of at most 10 modules, frames 
+ * are built in a RelayFrame instead.
  * 
  */
 #include <SerialRelay.h>
@@ -35,17 +35,220 @@
 #define RELAY_DATA 7
 #define RELAY_CLK 8
 // Number of Relay board modules connected one in each other
-const int NumModules = 1;    // maximum of 10
-// Create SerialRelay object 
-// (data, clock, number of modules)
-SerialRelay relays(RELAY_DATA, RELAY_CLK, NumModules);
+#ifndef RELAY_MODULES
+  #define RELAY_MODULES 1
+#endif
+const uint16_t NumModules = RELAY_MODULES;    // 1 byte of RAM per module
+
+
+/**
+ * @brief RelayBus library
+ * 
+ * 
+ * @notes:
+ * - Relay output drivers, picked at compile time (lib/RelayBus/RelayDriver.h)
+ * - SerialRelay boards (default): cycle-exact transfer, timing profiles 
+ * are in lib/RelayBus/RelayTiming.h; the conservative one reproduces the 
+ * SerialRelay library delays.
+ * The faster profile (RELAY_TIMING_FAST) is uncalibrated: re-run 
+ * host/relaymodel with your board's measured RC and update 
+ * lib/RelayBus/RelayTimingFast.h before uncommenting it.
+ * - 74HC595 boards: uncomment RELAY_DRIVER_595. Data goes out on the 
+ * hardware SPI pins (D11 MOSI, D13 SCK), RELAY_LATCH drives RCLK.
+ * 
+ */
+//#define RELAY_TIMING_FAST
+//#define RELAY_DRIVER_595
+#define RELAY_LATCH 10
+#include <RelayDriver.h>
+
+#if defined(RELAY_DRIVER_595)
+  #if FEATURE_DEBUG_LED && LED_BUILTIN == 13
+    #error "FEATURE_DEBUG_LED shares D13 with the SPI clock of RELAY_DRIVER_595"
+  #endif
+  typedef ShiftRegisterBus<RELAY_LATCH> RelayOut;
+#elif defined(RELAY_TIMING_FAST)
+  typedef RelayBus<RelayTimingFast, RELAY_DATA, RELAY_CLK> RelayOut;
+#else
+  typedef RelayBus<RelayTimingConservative, RELAY_DATA, RELAY_CLK> RelayOut;
+#endif
+
+
+/**
+ * @brief MEGA hardware timers
+ * 
+ * 
+ * @notes:
+ * - On ATmega2560 each job gets its own timer (lib/HwTimers/HwTimers.h): 
+ * Timer1 schedule, Timer3 fan PWM, Timer4 profiler, Timer5 pulse counter.
+ * - Fan channel 0 follows the share of lit zones; the cost of every relay 
+ * refresh and the pulse count are printed after it.
+ * - FEATURE_HW_TIMERS, on by default on the MEGA.
+ * 
+ */
+typedef MegaTimers<FEATURE_HW_TIMERS> HwTimer;
+
+
+/**
+ * @brief Software timers
+ * 
+ * 
+ * @notes:
+ * - Any number of SoftTimers on one hierarchical timing wheel 
+ * (lib/TimerWheel), from one tick to months, for debounce, ramps, sensor 
+ * polls. Timers fire from loop(), never from the interrupt.
+ * - The tick is Timer0's compare B interrupt: Timer0 already runs for 
+ * millis(), so this costs no timer, one interrupt every 1.024 ms. 
+ * analogWrite() on D5 (OC0B) is lost.
+ * - FEATURE_SOFT_TIMERS; arm timers on Timers::Wheel.
+ * 
+ */
+typedef SoftTimers<FEATURE_SOFT_TIMERS> Timers;
+
+#if FEATURE_SOFT_TIMERS
+  ISR(TIMER0_COMPB_vect)
+  {
+    Timers::tick();
+  }
+#endif
+
+
+/**
+ * @brief State shared with Trigger_relay
+ * 
+ * 
+ * @notes:
+ * - lib/IsrSafe primitives instead of volatile variables (see the ISR 
+ * notes below): for each zone that toggles the ISR fills a RelayEvent, 
+ * hour count and zone included, from a fixed-block pool and queues it for 
+ * loop(), which frees it once handled. loop() never reads the ISR's hour 
+ * count itself.
+ * - Pool occupancy (in use, high-water mark, failed allocations) is 
+ * printed with every event: size RELAY_EVENTS from a long run. It needs 
+ * a block per zone toggling in the same hour (env:mega sets 32).
+ * - Events are only kept when something consumes them (debug LED, 
+ * status log or event log).
+ * - The relay's initial state comes from the schedule (START_RELAY_ON in 
+ * include/schedule_config.h).
+ * 
+ */
+#ifndef RELAY_EVENTS
+  #define RELAY_EVENTS 4
+#endif
+
+typedef DebugLed<FEATURE_DEBUG_LED> Debug;
+typedef StatusLog<FEATURE_STATUS_LOG> Log;
+typedef RelayEvents<FEATURE_DEBUG_LED || FEATURE_STATUS_LOG || FEATURE_EVENT_LOG, RELAY_EVENTS> Events;
+
+
+/**
+ * @brief EstufaCore library
+ * 
+ * 
+ * @notes:
+ * - Zone schedules (LightSchedule, shared with the host fleet simulator), 
+ * schedule image loading and relay framing, hardware independent 
+ * (lib/EstufaCore). This file only wires it to the AVR HAL: EEPROM, 
+ * the relay driver above and ITimer1.
+ * 
+ */
+#include <EstufaCore.h>
+#include <HalAvr.h>
+
+typedef EstufaCore<HalAvr<RelayOut>, NumModules> Core;
+
+
+/**
+ * @brief Modbus RTU slave
+ * 
+ * 
+ * @notes:
+ * - Coils = relay channels, holding registers = zone schedules 
+ * (map in lib/EstufaCore/ModbusSlave.h), on the USB serial port.
+ * - RtuSerial takes over USART0 and Timer2 (t3.5 frame timer), so the 
+ * status prints below are compiled out: the port carries Modbus only.
+ * - RS-485 multidrop: build with -DRTU_SERIAL_DE_PIN=<pin> (env uno_rs485)
+ * and give every controller on the bus its own address. MODBUS_ADDRESS is
+ * only the default; the address stored in EEPROM wins, and is set from the
+ * host with register 0x0400 (modbusmaster set-address).
+ * - Time sync: the host disciplines Modbus::Clock 
+ * (lib/EstufaCore/TimeSync.h) through registers 0x0500/0x0510 
+ * (modbusmaster sync); Modbus::Clock::now_us() is the fleet time.
+ * - FEATURE_MODBUS (include/firmware_features.h)
+ * 
+ */
+#define MODBUS_ADDRESS 1
+#define MODBUS_BAUD 115200
+
+typedef ModbusLink<FEATURE_MODBUS, Core, HalAvr<RelayOut> > Modbus;
 
-#ifdef START_RELAY_ON
-  volatile bool toggle_relay = true;
+
+/**
+ * @brief Telemetry stream
+ * 
+ * 
+ * @notes:
+ * - One binary snapshot every TELEMETRY_INTERVAL_MS (default 5 s) of 
+ * samples taken every 100 ms, min/max/mean per channel, framed between 
+ * the status lines: `estufalink telemetry` (host/estufalink) turns them 
+ * into CSV for charting. With the event log built in, 
+ * `estufalink interval MS` changes the interval at run time (0 stops it).
+ * - Channels: longest loop() pass in us, lit zones, and the analog input 
+ * TELEMETRY_SENSOR_PIN when defined (raw 0..1023).
+ * - FEATURE_TELEMETRY, off by default; not with Modbus.
+ * 
+ */
+#ifdef TELEMETRY_SENSOR_PIN
+  #define TELEMETRY_CHANNELS 3
 #else
-  volatile bool toggle_relay = false;
+  #define TELEMETRY_CHANNELS 2
+#endif
+
+typedef TelemetryStream<FEATURE_TELEMETRY, HalAvr<RelayOut>, TELEMETRY_CHANNELS> Tlm;
+
+void Sample_telemetry(int16_t *v)
+{
+  int16_t lit = 0;
+  for (uint8_t z = 0; z < Core::zones; z++)
+    lit += Core::channel(z);
+  v[0] = lit;
+#ifdef TELEMETRY_SENSOR_PIN
+  v[1] = analogRead(TELEMETRY_SENSOR_PIN);
+#endif
+}
+
+
+/**
+ * @brief Event log
+ * 
+ * 
+ * @notes:
+ * - The last EVENT_LOG_RECORDS relay events, 8 bytes each, kept in RAM 
+ * for `estufalink dump` (host/estufalink). The status link stays at 
+ * SERIAL_LINK_BAUD (115200, monitor_speed); the dump asks for 500k or 1M 
+ * (`--fast 1000000`, exact with U2X at 16 MHz) and both ends fall back 
+ * to 115200 by themselves if that rate does not get through.
+ * - Measured on the pty emulator (estufalink selftest), 4096 records: 
+ * 1212 records/s at 115200, 5266 at 500k, 10337 at 1M; the 256 records 
+ * of a MEGA take 0.21 s at 115200, 25 ms at 1M.
+ * - Downloaded in pages of records, each chunk under its own CRC: a 
+ * damaged chunk is asked for again, from the last record received, and 
+ * an interrupted download resumes (`estufalink dump --from SEQ`). With 
+ * 1 byte in 1000 damaged or lost the 4096 records still come at about 
+ * 7100 records/s at 1M, 75% of a clean line (pages of 64).
+ * - FEATURE_EVENT_LOG, off by default; not with Modbus.
+ * 
+ */
+#ifndef EVENT_LOG_RECORDS
+  #if defined(__AVR_ATmega2560__)
+    #define EVENT_LOG_RECORDS 256   // 2 KB of 8
+  #else
+    #define EVENT_LOG_RECORDS 32    // 256 B of 2
+  #endif
 #endif
 
+typedef EventLogLink<FEATURE_EVENT_LOG, HalAvr<RelayOut>, EVENT_LOG_RECORDS, Tlm::Stream> EvLog;
+
 
 /**
  * @brief TimerInterrupt library
@@ -76,7 +279,9 @@ SerialRelay relays(RELAY_DATA, RELAY_CLK, NumModules);
 
 #include <TimerInterrupt.h>
 
-#define TIMER_TRIGGER_MS    3600000 // How long before trigger ISR
+#ifndef TIMER_TRIGGER_MS
+  #define TIMER_TRIGGER_MS  3600000 // How long before trigger ISR
+#endif
 #define TIMER1_DURATION_MS  0       // Timer1 runs forever
 
 
@@ -99,73 +304,41 @@ SerialRelay relays(RELAY_DATA, RELAY_CLK, NumModules);
  * accesses the data.
  *  
  */
+#include <SimTrace.h>
+
 void Trigger_relay()
 {
-  static uint8_t hours = 0;
-  hours++;
-
-#ifdef START_RELAY_ON
-  static bool toggle_relay_1 = true;
-#else
-  static bool toggle_relay_1 = false;
+#ifdef SIMAVR_TRACE
+  static uint16_t sim_hours = 0;
+  if (++sim_hours > SIM_HOURS)
+    Sim_stop();
 #endif
 
-  if (
-    (toggle_relay_1 == true && hours == LIGHT_HOURS) || 
-    (toggle_relay_1 == false && hours == DARK_HOURS)
-    )
-    {
-      // Reset couting hours
-      hours = 0;
-      // Update toggle_relay
-      toggle_relay_1 = !toggle_relay_1;
-
-      #ifdef DEBUG_MODE
-        digitalWrite(LED_BUILTIN, toggle_relay_1);
-      #endif
-
-      /**
-       * @brief Arduino-Relay communication
-       * Serial communication via I2C protocol
-       * 
-       */
-      byte _data[0];
-      _data[0] = 0;
-      // Define the command to be sent to relay (Turn on or Turn off)
-      if(toggle_relay_1){
-        byte mask = (1 << (0));
-        _data[0] |= mask;
-      } else {
-        byte mask = ~(1 << (0));
-        _data[0] &= mask;
-      }
-      // send I2C pulse
-      byte mask_reset = 0x80; // reset
-      for(int i=1 ; i <= 8 ; i++){
-        // set Data line
-        if(_data[0] & mask_reset)
-          digitalWrite(7, HIGH);
-        else
-          digitalWrite(7, LOW);
-        // delay between Data and Clock signals
-        delayMicroseconds(SERIAL_RELAY_DELAY_DATA);
-        // set Clock line
-        digitalWrite(8, HIGH); // rising edge
-        if(i == 8)
-          // latch timing
-          delayMicroseconds(SERIAL_RELAY_DELAY_LATCH);
-        else
-          // shift timing
-          delayMicroseconds(SERIAL_RELAY_DELAY_CLOCK_HIGH);
-        digitalWrite(8, LOW);
-        // it is acceptable to have 5µs delay after the last bit has been sent
-        delayMicroseconds(SERIAL_RELAY_DELAY_CLOCK_LOW);
-        
-        mask_reset >>= 1; // update mask
-      }
-      // Reset to maintain LOW level when not in use
-      digitalWrite(7, LOW);
-    }
+  static uint32_t hours = 0;
+  ++hours;
+
+  // The frame is shifted out from loop(): a long chain takes 
+  // milliseconds, too long to hold this ISR
+  Core::tick([](uint8_t zone, bool on) {
+    Events::record(hours, zone, on);
+  });
+}
+
+
+/**
+ * @brief Send the zone states to the whole relay chain
+ * 
+ * 
+ * @notes:
+ * - Zone z drives relay channel z (relay z%4+1 of module z/4+1 on 
+ * SerialRelay boards, z%8+1 of board z/8+1 on 74HC595 boards).
+ * - Only the zone snapshot runs with interrupts off; RelayBus masks 
+ * them one clock pulse at a time while streaming the chain.
+ * 
+ */
+void Send_relays()
+{
+  HwTimer::send<Core, Log>();
 }
 
 
@@ -190,54 +363,53 @@ void setup()
    * https://arduino.stackexchange.com/questions/439/why-does-starting-the-serial-monitor-restart-the-sketch]
    * 
    */
-  Serial.begin(115200);
-  while (!Serial);
-  Serial.println("#WARNING: ARDUINO HAS BEEN RESET");
-  Serial.print(F("\nStarting ESTUFA on "));
-  Serial.println(BOARD_TYPE);
-  Serial.print(F("CPU Frequency = ")); 
-  Serial.print(F_CPU / 1000000); 
-  Serial.println(F(" MHz"));
-
-// DEBUG ONLY
-#ifdef DEBUG_MODE
-  // Config Arduino LED
-  pinMode(LED_BUILTIN, OUTPUT);
-  #ifdef START_RELAY_ON
-    digitalWrite(LED_BUILTIN, HIGH);
-  #else
-    digitalWrite(LED_BUILTIN, LOW);
-  #endif
-#endif
+  Modbus::begin(MODBUS_ADDRESS, MODBUS_BAUD);
+  Log::begin(BOARD_TYPE);
+  Tlm::begin();
+  EvLog::begin();
+
+  // Zone schedules must be ready before Timer1 starts ticking them
+  Log::schedules(Core::load_schedules());
+
+  Debug::begin(Core::schedule(0).is_on());
+  Timers::begin();
+  HwTimer::begin();
+
+  // Initialize all relays OFF, then start lit zones on
+  Core::begin();
 
   // Initialize the TimerInterrupt object
+  // Started last, so Trigger_relay never requests a frame while the 
+  // initialization above is still talking to the board
   ITimer1.init();
-  if (ITimer1.attachInterruptInterval(
+  bool timer_ok = ITimer1.attachInterruptInterval(
     TIMER_TRIGGER_MS,
     Trigger_relay,
     TIMER1_DURATION_MS
-  ))
-  {
-    Serial.print(F("Starting  ITimer1 OK, millis() = ")); 
-    Serial.println(millis());
-  }
-  else
-    Serial.println(F("Can't set ITimer1"));
-
-  // Initialize all relays OFF
-  for(int i=1 ; i <= NumModules ; i++){
-    for(int j=1 ; j <= 4 ; j++){
-      relays.SetRelay(j, SERIAL_RELAY_OFF, i);
-      delay(1000);
-    }
-  }
-
-#ifdef START_RELAY_ON
-  relays.SetRelay(1, SERIAL_RELAY_ON, 1); // Start with relay on
-#endif
-
+  );
+  Log::timer(timer_ok);
 }
 
 void loop()
 {
-}
\ No newline at end of file
+  Modbus::poll();
+
+  // Zone changes reach the EEPROM from here, in the background
+  Core::Config::poll();
+
+  Timers::poll();
+
+  Tlm::poll(Sample_telemetry);
+
+  Events::poll([](const RelayEvent &e, const PoolStats &pool) {
+    if (e.zone == 0)
+      Debug::set(e.on);
+    Log::event(e, pool);
+    EvLog::record(e, pool);
+  });
+
+  EvLog::poll();
+
+  if (Core::refresh_pending())
+    Send_relays();
+}
@@ -0,0 +1,79 @@
+/**
+ * @brief ESTUFA core on STM32 (Cortex-M4), benchmark and scheduler run
+ *
+ *
+ * @notes:
+ * - pio run -e stm32_qemu -t qemu
+ *   Runs on QEMU's netduinoplus2 (STM32F405): prints the CoreBench
+ *   results, then runs the scheduler from SysTick for SIM_HOURS hours of
+ *   TIMER_TRIGGER_MS each and exits QEMU.
+ *
+ * - Under QEMU the clock counts emulated cycles (-icount): numbers compare
+ * code paths and ports, they are not silicon timings.
+ *
+ */
+#include <CoreBench.h>
+#include <EstufaCore.h>
+#include <HalStm32.h>
+
+#ifndef RELAY_MODULES
+  #define RELAY_MODULES 1
+#endif
+#ifndef TIMER_TRIGGER_MS
+  #define TIMER_TRIGGER_MS 10
+#endif
+#ifndef SIM_HOURS
+  #define SIM_HOURS (24 * 60)
+#endif
+
+typedef EstufaCore<HalStm32, RELAY_MODULES> Core;
+
+static volatile uint32_t hours = 0;
+
+static void Trigger_relay()
+{
+  hours++;
+  Core::tick();
+}
+
+static void report(const char *name, uint32_t ops, uint32_t clocks)
+{
+  uint32_t per_op = (clocks + ops / 2) / ops;
+  HalStm32::print("BENCH ");
+  HalStm32::print(name);
+  HalStm32::print(" cycles=");
+  HalStm32::print(per_op);
+  HalStm32::print(" ns=");
+  HalStm32::print(uint32_t((uint64_t)per_op * 1000000000ULL / HalStm32::clock_hz()));
+  HalStm32::print("\n");
+}
+
+int main()
+{
+  HalStm32::begin();
+  HalStm32::print("#BENCH ESTUFA core on STM32F4, SystemCoreClock = ");
+  HalStm32::print(uint32_t(SystemCoreClock));
+  HalStm32::print(", modules = ");
+  HalStm32::print(uint32_t(RELAY_MODULES));
+  HalStm32::print("\n");
+
+  core_bench<Core, HalStm32>(report);
+
+  // Scheduler run: the same path as the AVR firmware, ticked by SysTick
+  Core::load_schedules();
+  Core::begin();
+  uint32_t frames = 0;
+  HalStm32::start_ticks(TIMER_TRIGGER_MS, Trigger_relay);
+  while (hours < SIM_HOURS) {
+    if (Core::refresh_pending()) {
+      Core::send_relays();
+      frames++;
+    }
+  }
+  HalStm32::print("#STATS hours=");
+  HalStm32::print(uint32_t(SIM_HOURS));
+  HalStm32::print(" frames=");
+  HalStm32::print(frames);
+  HalStm32::print("\n#BENCH done\n");
+  HalStm32::exit();
+}